@@ -0,0 +1,356 @@
+#pragma once
+
+#include "arrayutils.hpp"
+
+#include <cstddef>
+#include <initializer_list>
+#include <type_traits>
+
+/**
+  * Opt-in expression templates for MathArray. The arithmetic operators in
+  * arrayutils.hpp return a fresh MathArray each time, so something like
+  * a + b * c - d makes three temporaries and loops over the data three times.
+  * If the operands are LazyArrays instead, the same expression builds a little
+  * tree of expression objects and nothing is computed until it is assigned to
+  * a MathArray or LazyArray, at which point it runs as a single fused loop.
+  *
+  * LazyArray inherits from MathArray, so it can be passed to anything that
+  * takes a MathArray. Mixing LazyArrays, plain MathArrays and scalars in one
+  * expression is fine; as long as one operand of an operator is lazy, the
+  * result is lazy.
+  *
+  * Expressions hold references to the arrays they were built from, so don't
+  * keep one around in an `auto` variable past the lifetime of its operands.
+  */
+namespace dav {
+    template <class T, size_t N> class LazyArray;
+
+    template <class Op, class L, class R> class ArrayBinaryExpression;
+    template <class Op, class E> class ArrayUnaryExpression;
+
+    template <class T>
+    struct is_array_expression : std::false_type {};
+
+    template <class Op, class L, class R>
+    struct is_array_expression<ArrayBinaryExpression<Op, L, R>> : std::true_type {};
+
+    template <class Op, class E>
+    struct is_array_expression<ArrayUnaryExpression<Op, E>> : std::true_type {};
+
+    // "Lazy" operands are the ones that make an operator build an expression
+    // rather than going through the eager operators in arrayutils.hpp.
+    template <class T>
+    struct is_lazy_operand : is_array_expression<T> {};
+
+    template <class T, size_t N>
+    struct is_lazy_operand<LazyArray<T, N>> : std::true_type {};
+
+    template <class T>
+    struct is_array_operand : is_lazy_operand<T> {};
+
+    template <class T, size_t N>
+    struct is_array_operand<MathArray<T, N>> : std::true_type {};
+
+    /**
+      * How an operand is stored inside an expression. Arrays are stored by
+      * reference, expressions (which are tiny) and scalars by value.
+      */
+    template <class X, class Enable = void>
+    struct ExpressionOperand {
+        using value_type = X;
+        using stored_type = const X;
+
+        static constexpr value_type get(const X& x, const size_t) noexcept {
+            return x;
+        }
+    };
+
+    template <class X>
+    struct ExpressionOperand<X, std::enable_if_t<is_array_expression<X>::value>> {
+        using value_type = typename X::value_type;
+        using stored_type = const X;
+        static constexpr size_t size = X::static_size;
+
+        static constexpr value_type get(const X& x, const size_t i) noexcept {
+            return x[i];
+        }
+    };
+
+    template <class T, size_t N>
+    struct ExpressionOperand<MathArray<T, N>> {
+        using value_type = T;
+        using stored_type = const MathArray<T, N>&;
+        static constexpr size_t size = N;
+
+        static constexpr value_type get(const MathArray<T, N>& x, const size_t i) noexcept {
+            return x[i];
+        }
+    };
+
+    template <class T, size_t N>
+    struct ExpressionOperand<LazyArray<T, N>> : ExpressionOperand<MathArray<T, N>> {};
+
+    /**
+      * Element type and length of a binary expression, taken from whichever
+      * operand is an array (or both, in which case they had better agree).
+      */
+    template <class L, class R, class Enable = void>
+    struct BinaryExpressionTraits;
+
+    template <class L, class R>
+    struct BinaryExpressionTraits<L, R, std::enable_if_t<is_array_operand<L>::value && is_array_operand<R>::value>> {
+        static_assert(std::is_same<typename ExpressionOperand<L>::value_type, typename ExpressionOperand<R>::value_type>::value, "Array expression operands have different element types");
+        static_assert(ExpressionOperand<L>::size == ExpressionOperand<R>::size, "Array expression operands have different lengths");
+
+        using value_type = typename ExpressionOperand<L>::value_type;
+        static constexpr size_t size = ExpressionOperand<L>::size;
+    };
+
+    template <class L, class R>
+    struct BinaryExpressionTraits<L, R, std::enable_if_t<is_array_operand<L>::value && std::is_arithmetic<R>::value>> {
+        using value_type = typename ExpressionOperand<L>::value_type;
+        static constexpr size_t size = ExpressionOperand<L>::size;
+    };
+
+    template <class L, class R>
+    struct BinaryExpressionTraits<L, R, std::enable_if_t<std::is_arithmetic<L>::value && is_array_operand<R>::value>> {
+        using value_type = typename ExpressionOperand<R>::value_type;
+        static constexpr size_t size = ExpressionOperand<R>::size;
+    };
+
+    template <class L, class R>
+    constexpr bool is_lazy_binary_v = (is_lazy_operand<L>::value && (is_array_operand<R>::value || std::is_arithmetic<R>::value))
+                                   || (is_lazy_operand<R>::value && (is_array_operand<L>::value || std::is_arithmetic<L>::value));
+
+    namespace expression_ops {
+        struct plus {
+            template <class T>
+            static constexpr T apply(const T& a, const T& b) noexcept { return a + b; }
+        };
+
+        struct minus {
+            template <class T>
+            static constexpr T apply(const T& a, const T& b) noexcept { return a - b; }
+        };
+
+        struct multiplies {
+            template <class T>
+            static constexpr T apply(const T& a, const T& b) noexcept { return a * b; }
+        };
+
+        struct divides {
+            template <class T>
+            static constexpr T apply(const T& a, const T& b) noexcept { return a / b; }
+        };
+
+        struct negate {
+            template <class T>
+            static constexpr T apply(const T& a) noexcept { return -a; }
+        };
+    }
+
+    /**
+      * Shared bits of every expression node: evaluating into a MathArray,
+      * either explicitly or by implicit conversion.
+      */
+    template <class Derived, class T, size_t N>
+    class ArrayExpressionBase {
+
+    public:
+        using value_type = T;
+        static constexpr size_t static_size = N;
+
+        constexpr size_t size() const noexcept {
+            return N;
+        }
+
+        constexpr MathArray<T, N> eval() const noexcept {
+            MathArray<T, N> output{};
+
+            for (size_t i = 0; i < N; ++i) {
+                output[i] = static_cast<const Derived&>(*this)[i];
+            }
+
+            return output;
+        }
+
+        constexpr operator MathArray<T, N>() const noexcept {
+            return this->eval();
+        }
+
+        constexpr T sum() const noexcept {
+            T output = 0;
+            for (size_t i = 0; i < N; ++i) {
+                output += static_cast<const Derived&>(*this)[i];
+            }
+
+            return output;
+        }
+    };
+
+    template <class Op, class L, class R>
+    class ArrayBinaryExpression : public ArrayExpressionBase<ArrayBinaryExpression<Op, L, R>,
+                                                             typename BinaryExpressionTraits<L, R>::value_type,
+                                                             BinaryExpressionTraits<L, R>::size> {
+
+    public:
+        using value_type = typename BinaryExpressionTraits<L, R>::value_type;
+
+        constexpr ArrayBinaryExpression(const L& lhs, const R& rhs) noexcept
+        : lhs(lhs)
+        , rhs(rhs) {}
+
+        constexpr value_type operator[](const size_t i) const noexcept {
+            return Op::apply(
+                static_cast<value_type>(ExpressionOperand<L>::get(this->lhs, i)),
+                static_cast<value_type>(ExpressionOperand<R>::get(this->rhs, i))
+            );
+        }
+
+    private:
+        typename ExpressionOperand<L>::stored_type lhs;
+        typename ExpressionOperand<R>::stored_type rhs;
+    };
+
+    template <class Op, class E>
+    class ArrayUnaryExpression : public ArrayExpressionBase<ArrayUnaryExpression<Op, E>,
+                                                            typename ExpressionOperand<E>::value_type,
+                                                            ExpressionOperand<E>::size> {
+
+    public:
+        using value_type = typename ExpressionOperand<E>::value_type;
+
+        constexpr explicit ArrayUnaryExpression(const E& operand) noexcept
+        : operand(operand) {}
+
+        constexpr value_type operator[](const size_t i) const noexcept {
+            return Op::apply(ExpressionOperand<E>::get(this->operand, i));
+        }
+
+    private:
+        typename ExpressionOperand<E>::stored_type operand;
+    };
+
+
+    template <class T, size_t N>
+    class LazyArray : public MathArray<T, N> {
+
+    public:
+        LazyArray() = default;
+
+        LazyArray(const MathArray<T, N>& other) noexcept
+        : MathArray<T, N>(other) {}
+
+        LazyArray(std::initializer_list<T> values) noexcept
+        : MathArray<T, N>{} {
+            std::copy(values.begin(), values.begin() + std::min(values.size(), N), this->begin());
+        }
+
+        template <class E, class = std::enable_if_t<is_array_expression<E>::value>>
+        LazyArray(const E& expression) noexcept {
+            this->assign(expression);
+        }
+
+        template <class E, class = std::enable_if_t<is_array_expression<E>::value>>
+        LazyArray<T, N>& operator=(const E& expression) noexcept {
+            return this->assign(expression);
+        }
+
+        /**
+          * Evaluate the expression straight into this array, in one loop.
+          * Every operator is elementwise, so it's fine for this array to
+          * appear in the expression too (e.g. a = a * b + c).
+          */
+        template <class E>
+        LazyArray<T, N>& assign(const E& expression) noexcept {
+            static_assert(E::static_size == N, "Can't assign an expression of a different length");
+
+            for (size_t i = 0; i < N; ++i) {
+                this->data[i] = expression[i];
+            }
+
+            return *this;
+        }
+    };
+
+
+    /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+     * LAZY OPERATORS  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+     * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+    // These are exact matches for LazyArrays and expressions, so they win over
+    // the eager MathArray operators, which would need a derived-to-base
+    // conversion.
+    template <class L, class R, class = std::enable_if_t<is_lazy_binary_v<L, R>>>
+    inline constexpr ArrayBinaryExpression<expression_ops::plus, L, R> operator+ (const L& a1, const R& a2) noexcept {
+        return ArrayBinaryExpression<expression_ops::plus, L, R>(a1, a2);
+    }
+
+    template <class L, class R, class = std::enable_if_t<is_lazy_binary_v<L, R>>>
+    inline constexpr ArrayBinaryExpression<expression_ops::minus, L, R> operator- (const L& a1, const R& a2) noexcept {
+        return ArrayBinaryExpression<expression_ops::minus, L, R>(a1, a2);
+    }
+
+    template <class L, class R, class = std::enable_if_t<is_lazy_binary_v<L, R>>>
+    inline constexpr ArrayBinaryExpression<expression_ops::multiplies, L, R> operator* (const L& a1, const R& a2) noexcept {
+        return ArrayBinaryExpression<expression_ops::multiplies, L, R>(a1, a2);
+    }
+
+    template <class L, class R, class = std::enable_if_t<is_lazy_binary_v<L, R>>>
+    inline constexpr ArrayBinaryExpression<expression_ops::divides, L, R> operator/ (const L& a1, const R& a2) noexcept {
+        return ArrayBinaryExpression<expression_ops::divides, L, R>(a1, a2);
+    }
+
+    template <class E, class = std::enable_if_t<is_lazy_operand<E>::value>>
+    inline constexpr ArrayUnaryExpression<expression_ops::negate, E> operator- (const E& a1) noexcept {
+        return ArrayUnaryExpression<expression_ops::negate, E>(a1);
+    }
+
+    template <class T, size_t N, class E, class = std::enable_if_t<is_array_expression<E>::value>>
+    inline constexpr MathArray<T, N>& operator+= (MathArray<T, N>& a1, const E& a2) noexcept {
+        static_assert(E::static_size == N, "Can't add an expression of a different length");
+
+        for (size_t i = 0; i < N; ++i) {
+            a1[i] += a2[i];
+        }
+
+        return a1;
+    }
+
+    template <class T, size_t N, class E, class = std::enable_if_t<is_array_expression<E>::value>>
+    inline constexpr MathArray<T, N>& operator-= (MathArray<T, N>& a1, const E& a2) noexcept {
+        static_assert(E::static_size == N, "Can't subtract an expression of a different length");
+
+        for (size_t i = 0; i < N; ++i) {
+            a1[i] -= a2[i];
+        }
+
+        return a1;
+    }
+
+    template <class T, size_t N, class E, class = std::enable_if_t<is_array_expression<E>::value>>
+    inline constexpr MathArray<T, N>& operator*= (MathArray<T, N>& a1, const E& a2) noexcept {
+        static_assert(E::static_size == N, "Can't multiply by an expression of a different length");
+
+        for (size_t i = 0; i < N; ++i) {
+            a1[i] *= a2[i];
+        }
+
+        return a1;
+    }
+
+    template <class T, size_t N, class E, class = std::enable_if_t<is_array_expression<E>::value>>
+    inline constexpr MathArray<T, N>& operator/= (MathArray<T, N>& a1, const E& a2) noexcept {
+        static_assert(E::static_size == N, "Can't divide by an expression of a different length");
+
+        for (size_t i = 0; i < N; ++i) {
+            a1[i] /= a2[i];
+        }
+
+        return a1;
+    }
+
+    template <class E, class = std::enable_if_t<is_array_expression<E>::value>>
+    inline constexpr MathArray<typename E::value_type, E::static_size> evaluate(const E& expression) noexcept {
+        return expression.eval();
+    }
+}
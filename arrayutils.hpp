@@ -7,9 +7,122 @@
 #include <stdexcept>
 #include <iterator>
 #include <algorithm>
+#include <type_traits>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 namespace dav {
 
+    /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+     * SIMD KERNELS  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+     * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+    // Hand-written kernels for the 3- and 4-vectors of doubles that all the
+    // hydrodynamics code runs on. The path is picked at compile time: AVX if
+    // the compiler is allowed to use it (e.g. -mavx or -march=native), SSE2
+    // otherwise (always there on x86-64), and plain loops on anything else.
+    // The data isn't padded to 4 lanes because that would change the layout of
+    // MathArray<double, 3>, so the third lane is loaded on its own.
+    namespace simd {
+        // True while the compiler is working out a constant expression,
+        // where the intrinsics can't run, so the kernels take their plain
+        // arithmetic instead. That gives the same result bit for bit.
+        constexpr bool constant_evaluated() noexcept {
+            #if defined(__GNUC__) || defined(__clang__)
+            return __builtin_is_constant_evaluated();
+            #else
+            return true;
+            #endif
+        }
+
+        constexpr double dot3(const double* a, const double* b) noexcept {
+            #if defined(__SSE2__)
+            if (!constant_evaluated()) {
+                const __m128d products = _mm_mul_pd(_mm_loadu_pd(a), _mm_loadu_pd(b));
+                const __m128d total = _mm_add_sd(products, _mm_unpackhi_pd(products, products));
+
+                return _mm_cvtsd_f64(_mm_add_sd(total, _mm_mul_sd(_mm_load_sd(a + 2), _mm_load_sd(b + 2))));
+            }
+            #endif
+
+            return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+        }
+
+        constexpr double distance_sq3(const double* a, const double* b) noexcept {
+            #if defined(__SSE2__)
+            if (!constant_evaluated()) {
+                const __m128d diff = _mm_sub_pd(_mm_loadu_pd(a), _mm_loadu_pd(b));
+                const __m128d diff_2 = _mm_sub_sd(_mm_load_sd(a + 2), _mm_load_sd(b + 2));
+                const __m128d squares = _mm_mul_pd(diff, diff);
+                const __m128d total = _mm_add_sd(squares, _mm_unpackhi_pd(squares, squares));
+
+                return _mm_cvtsd_f64(_mm_add_sd(total, _mm_mul_sd(diff_2, diff_2)));
+            }
+            #endif
+
+            const double dx = a[0] - b[0];
+            const double dy = a[1] - b[1];
+            const double dz = a[2] - b[2];
+
+            return dx * dx + dy * dy + dz * dz;
+        }
+
+        // The 4-vector reductions add the lanes pairwise rather than left to
+        // right, so they can differ from the generic loop in the last bit.
+        constexpr double dot4(const double* a, const double* b) noexcept {
+            #if defined(__AVX__)
+            if (!constant_evaluated()) {
+                const __m256d products = _mm256_mul_pd(_mm256_loadu_pd(a), _mm256_loadu_pd(b));
+                const __m128d halves = _mm_add_pd(_mm256_castpd256_pd128(products), _mm256_extractf128_pd(products, 1));
+
+                return _mm_cvtsd_f64(_mm_add_sd(halves, _mm_unpackhi_pd(halves, halves)));
+            }
+            #elif defined(__SSE2__)
+            if (!constant_evaluated()) {
+                const __m128d halves = _mm_add_pd(
+                    _mm_mul_pd(_mm_loadu_pd(a), _mm_loadu_pd(b)),
+                    _mm_mul_pd(_mm_loadu_pd(a + 2), _mm_loadu_pd(b + 2))
+                );
+
+                return _mm_cvtsd_f64(_mm_add_sd(halves, _mm_unpackhi_pd(halves, halves)));
+            }
+            #endif
+
+            return (a[0] * b[0] + a[2] * b[2]) + (a[1] * b[1] + a[3] * b[3]);
+        }
+
+        constexpr double distance_sq4(const double* a, const double* b) noexcept {
+            #if defined(__AVX__)
+            if (!constant_evaluated()) {
+                const __m256d diff = _mm256_sub_pd(_mm256_loadu_pd(a), _mm256_loadu_pd(b));
+                const __m256d squares = _mm256_mul_pd(diff, diff);
+                const __m128d halves = _mm_add_pd(_mm256_castpd256_pd128(squares), _mm256_extractf128_pd(squares, 1));
+
+                return _mm_cvtsd_f64(_mm_add_sd(halves, _mm_unpackhi_pd(halves, halves)));
+            }
+            #elif defined(__SSE2__)
+            if (!constant_evaluated()) {
+                const __m128d diff_01 = _mm_sub_pd(_mm_loadu_pd(a), _mm_loadu_pd(b));
+                const __m128d diff_23 = _mm_sub_pd(_mm_loadu_pd(a + 2), _mm_loadu_pd(b + 2));
+                const __m128d halves = _mm_add_pd(_mm_mul_pd(diff_01, diff_01), _mm_mul_pd(diff_23, diff_23));
+
+                return _mm_cvtsd_f64(_mm_add_sd(halves, _mm_unpackhi_pd(halves, halves)));
+            }
+            #endif
+
+            const double d0 = a[0] - b[0];
+            const double d1 = a[1] - b[1];
+            const double d2 = a[2] - b[2];
+            const double d3 = a[3] - b[3];
+
+            return (d0 * d0 + d2 * d2) + (d1 * d1 + d3 * d3);
+        }
+    }
+
+
     template<class T, size_t N>
     class MathArray {
 
@@ -189,23 +302,30 @@ namespace dav {
         }
 
         constexpr T dot(const MathArray<T, N>& other) const noexcept {
-            return ((*this) * other).sum();
+            if constexpr (std::is_same<T, double>::value && N == 3) {
+                return simd::dot3(this->data, other.data);
+            } else if constexpr (std::is_same<T, double>::value && N == 4) {
+                return simd::dot4(this->data, other.data);
+            } else {
+                T output = 0;
+                for (size_t i = 0; i < N; ++i) {
+                    output += (*this)[i] * other[i];
+                }
+
+                return output;
+            }
         }
 
+        // Written out rather than summed over levicevita(i, j, k), which wastes
+        // 21 of its 27 terms on zeros.
         constexpr MathArray<T, N> cross(const MathArray<T, N>& other) const noexcept {
             static_assert(N == 3, "Can only cross 3-vectors");
 
-            MathArray<T, N> output{};
-
-            for (size_t i = 0; i < N; ++i) {
-                for (size_t j = 0; j < N; ++j) {
-                    for (size_t k = 0; k < N; ++k) {
-                        output[i] += levicevita(i, j, k) * (*this)[j] * other[k];
-                    }
-                }
-            }
-
-            return output;
+            return MathArray<T, N>{
+                (*this)[1] * other[2] - (*this)[2] * other[1],
+                (*this)[2] * other[0] - (*this)[0] * other[2],
+                (*this)[0] * other[1] - (*this)[1] * other[0]
+            };
         }
 
         template <class U>
@@ -561,6 +681,42 @@ namespace dav {
         return magnitude(a1 - a2);
     }
 
+    // Non-template overloads for the hot 3- and 4-vectors, which win overload
+    // resolution over the templates above. Call e.g. magnitude_sq<double, 3>
+    // explicitly if you want the generic version. Still constexpr: the
+    // kernels drop back to plain arithmetic in constant expressions.
+    inline constexpr double magnitude_sq(const MathArray<double, 3>& v) noexcept {
+        return simd::dot3(v.data, v.data);
+    }
+
+    inline constexpr double magnitude_sq(const MathArray<double, 4>& v) noexcept {
+        return simd::dot4(v.data, v.data);
+    }
+
+    inline constexpr double magnitude(const MathArray<double, 3>& v) noexcept {
+        return std::sqrt(simd::dot3(v.data, v.data));
+    }
+
+    inline constexpr double magnitude(const MathArray<double, 4>& v) noexcept {
+        return std::sqrt(simd::dot4(v.data, v.data));
+    }
+
+    inline constexpr double distance_between_sq(const MathArray<double, 3>& a1, const MathArray<double, 3>& a2) noexcept {
+        return simd::distance_sq3(a1.data, a2.data);
+    }
+
+    inline constexpr double distance_between_sq(const MathArray<double, 4>& a1, const MathArray<double, 4>& a2) noexcept {
+        return simd::distance_sq4(a1.data, a2.data);
+    }
+
+    inline constexpr double distance_between(const MathArray<double, 3>& a1, const MathArray<double, 3>& a2) noexcept {
+        return std::sqrt(simd::distance_sq3(a1.data, a2.data));
+    }
+
+    inline constexpr double distance_between(const MathArray<double, 4>& a1, const MathArray<double, 4>& a2) noexcept {
+        return std::sqrt(simd::distance_sq4(a1.data, a2.data));
+    }
+
 
     /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
      * COMPARISON OPERATIONS * * * * * * * * * * * * * * * * * * * * * * * * * * *
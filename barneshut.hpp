@@ -0,0 +1,427 @@
+#pragma once
+
+#include "arrayutils.hpp"
+#include "boundingbox.hpp"
+#include "fluidutils.hpp"
+#include "particleset.hpp"
+#include "threadutils.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace dav {
+    /**
+      * Pair flows the tree can sum. accumulate adds the flow at one target
+      * due to point forces [begin, end) of some structure-of-arrays buffers,
+      * without the 1/(8 pi eta) prefactor.
+      */
+    struct StokesletFlow {
+        static void accumulate(const double tx, const double ty, const double tz,
+                               const double* x, const double* y, const double* z,
+                               const double* fx, const double* fy, const double* fz,
+                               const size_t begin, const size_t end,
+                               double& ux, double& uy, double& uz) noexcept {
+
+            stokeslet_flow_accumulate(tx, ty, tz, x, y, z, fx, fy, fz, begin, end, ux, uy, uz);
+        }
+    };
+
+    /**
+      * Blake's image system for a no-slip wall at z = 0. All the forces must
+      * be above the wall.
+      */
+    struct BlakeFlow {
+        static void accumulate(const double tx, const double ty, const double tz,
+                               const double* x, const double* y, const double* z,
+                               const double* fx, const double* fy, const double* fz,
+                               const size_t begin, const size_t end,
+                               double& ux, double& uy, double& uz) noexcept {
+
+            blake_flow_accumulate(tx, ty, tz, x, y, z, fx, fy, fz, begin, end, ux, uy, uz);
+        }
+    };
+
+
+    /**
+      * Barnes-Hut octree for summing the flow due to N point forces in
+      * O(N log N) rather than O(N^2). The root cell is the bounding box, and
+      * cells are split into octants until they hold at most leaf_size
+      * particles. Particles outside the box go in the edge cells, which makes
+      * those cells bigger and slower but not wrong.
+      *
+      * A cell that is far enough from a target is replaced by a two term
+      * expansion about its centre: the total force (monopole) and the first
+      * moment sum (y_j - c) f_j^T (force dipole, which covers both the
+      * stresslet and the rotlet). The dipole term is a derivative of the
+      * kernel, and rather than work that out for every kernel, each cell
+      * carries seven point forces that have the same monopole and dipole:
+      * the total force at the centre, and a +-D_k / 2 eps pair at
+      * c +- eps e_k for each axis k. Those go through the same vectorised
+      * accumulate as the direct sum, so the Blake image system comes for free.
+      *
+      * theta is the accuracy knob. A cell is expanded when the distance from
+      * the target to its centre is more than 1 / theta times the distance
+      * from its centre to its furthest particle. theta = 0 is the exact
+      * direct sum; the error of what's left out goes as theta^2. With the
+      * Blake flow that's theta^2 of a free Stokeslet's flow: far from the
+      * forces, or close to the wall, the wall screens the flow itself down
+      * to much less than that, so the relative error there is bigger. A cell
+      * is never expanded for a target inside that radius, so any theta above
+      * 1 behaves like theta = 1.
+      */
+    template <class Flow>
+    class BarnesHutTree {
+
+    public:
+        static constexpr size_t none = std::numeric_limits<size_t>::max();
+
+        BarnesHutTree(const BoundingBox& box, const double theta = 0.5, const size_t leaf_size = 16, const size_t n_threads = 0)
+        : box(box)
+        , theta(theta)
+        , leaf_size(leaf_size)
+        , n_threads(n_threads) {
+
+            if (!(theta >= 0)) {
+                throw std::invalid_argument("Barnes-Hut theta must be non-negative");
+            }
+
+            if (leaf_size == 0) {
+                throw std::invalid_argument("Barnes-Hut leaf size must be positive");
+            }
+        }
+
+        /**
+          * Build the tree for n point forces. The positions are copied, so
+          * the buffers can change afterwards.
+          */
+        void build(const double* x, const double* y, const double* z,
+                   const double* fx, const double* fy, const double* fz,
+                   const size_t n) {
+
+            this->order.resize(n);
+            for (size_t i = 0; i < n; ++i) {
+                this->order[i] = i;
+            }
+
+            this->nodes.clear();
+            this->nodes.push_back(Node{
+                (this->box.get_lower_bounds() + this->box.get_upper_bounds()) / 2.0,
+                (this->box.get_upper_bounds() - this->box.get_lower_bounds()) / 2.0,
+                0, 0, n, none, 0
+            });
+
+            std::vector<size_t> scratch(n);
+            this->split(0, x, y, z, scratch, 0);
+
+            this->sorted_positions.resize(n);
+            for (size_t i = 0; i < n; ++i) {
+                this->sorted_positions[i] = MathArray<double, 3>{x[this->order[i]], y[this->order[i]], z[this->order[i]]};
+            }
+
+            this->set_forces(fx, fy, fz, n);
+        }
+
+        void build(const VectorField& positions, const VectorField& forces) {
+            if (forces.size() != positions.size()) {
+                throw std::invalid_argument("Number of forces doesn't match the number of positions");
+            }
+
+            this->build(positions.x().data(), positions.y().data(), positions.z().data(),
+                        forces.x().data(), forces.y().data(), forces.z().data(),
+                        positions.size());
+        }
+
+        void build(const std::vector<MathArray<double, 3>>& positions, const std::vector<MathArray<double, 3>>& forces) {
+            this->build(VectorField(positions), VectorField(forces));
+        }
+
+        /**
+          * Change the forces but keep the particles where they are, which
+          * skips rebuilding the tree.
+          */
+        void set_forces(const double* fx, const double* fy, const double* fz, const size_t n) {
+            if (n != this->size()) {
+                throw std::invalid_argument("Number of forces doesn't match the tree");
+            }
+
+            this->sorted_forces.resize(n);
+            for (size_t i = 0; i < n; ++i) {
+                this->sorted_forces[i] = MathArray<double, 3>{fx[this->order[i]], fy[this->order[i]], fz[this->order[i]]};
+            }
+
+            this->build_expansions();
+        }
+
+        void set_forces(const VectorField& forces) {
+            this->set_forces(forces.x().data(), forces.y().data(), forces.z().data(), forces.size());
+        }
+
+        size_t size() const noexcept {
+            return this->order.size();
+        }
+
+        size_t node_count() const noexcept {
+            return this->nodes.size();
+        }
+
+        double get_theta() const noexcept {
+            return this->theta;
+        }
+
+        /**
+          * Flow at every source due to all the others, the tree version of
+          * blake_flow_batch. The outputs are in the order the particles were
+          * given to build() and are overwritten.
+          */
+        void flow_at_sources(const double shear_viscosity, double* ux, double* uy, double* uz) const {
+            const double prefactor = 1.0 / (8 * M_PI * shear_viscosity);
+
+            parallel_for(0, this->size(), [&](const size_t begin, const size_t end) {
+                std::vector<size_t> stack;
+
+                for (size_t i = begin; i < end; ++i) {
+                    const MathArray<double, 3> u = this->evaluate(this->sorted_positions[i], i, stack);
+                    const size_t original = this->order[i];
+
+                    ux[original] = prefactor * u[0];
+                    uy[original] = prefactor * u[1];
+                    uz[original] = prefactor * u[2];
+                }
+            }, this->n_threads);
+        }
+
+        void flow_at_sources(const double shear_viscosity, VectorField& velocities) const {
+            velocities.resize(this->size());
+            this->flow_at_sources(shear_viscosity, velocities.x().data(), velocities.y().data(), velocities.z().data());
+        }
+
+        /**
+          * Flow at n field points that aren't sources, e.g. on a grid.
+          */
+        void flow_at(const double* tx, const double* ty, const double* tz, const size_t n,
+                     const double shear_viscosity, double* ux, double* uy, double* uz) const {
+
+            const double prefactor = 1.0 / (8 * M_PI * shear_viscosity);
+
+            parallel_for(0, n, [&](const size_t begin, const size_t end) {
+                std::vector<size_t> stack;
+
+                for (size_t i = begin; i < end; ++i) {
+                    const MathArray<double, 3> u = this->evaluate(MathArray<double, 3>{tx[i], ty[i], tz[i]}, none, stack);
+
+                    ux[i] = prefactor * u[0];
+                    uy[i] = prefactor * u[1];
+                    uz[i] = prefactor * u[2];
+                }
+            }, this->n_threads);
+        }
+
+        MathArray<double, 3> flow_at(const MathArray<double, 3>& position, const double shear_viscosity) const {
+            std::vector<size_t> stack;
+
+            return this->evaluate(position, none, stack) / (8 * M_PI * shear_viscosity);
+        }
+
+    private:
+        // Children are stored next to each other, so a node only needs the
+        // index of its first one. Particles [begin, end) of the sorted
+        // buffers are the ones inside.
+        struct Node {
+            MathArray<double, 3> centre;
+            MathArray<double, 3> half_size;
+            double extent;
+            size_t begin;
+            size_t end;
+            size_t first_child;
+            size_t child_count;
+        };
+
+        static constexpr size_t max_depth = 32;
+        static constexpr size_t expansion_size = 7;
+
+        const BoundingBox box;
+        const double theta;
+        const size_t leaf_size;
+        const size_t n_threads;
+
+        std::vector<Node> nodes;
+        std::vector<size_t> order; // sorted index -> original index
+
+        // Everything below is in tree order. Positions and forces are kept as
+        // structure-of-arrays for the accumulate kernels.
+        VectorField sorted_positions;
+        VectorField sorted_forces;
+        VectorField expansion_positions;
+        VectorField expansion_forces;
+
+        void split(const size_t node_index, const double* x, const double* y, const double* z,
+                   std::vector<size_t>& scratch, const size_t depth) {
+
+            const size_t begin = this->nodes[node_index].begin;
+            const size_t end = this->nodes[node_index].end;
+            const MathArray<double, 3> centre = this->nodes[node_index].centre;
+            const MathArray<double, 3> half_size = this->nodes[node_index].half_size;
+
+            double extent_sq = 0;
+            for (size_t i = begin; i < end; ++i) {
+                const size_t p = this->order[i];
+                extent_sq = std::max(extent_sq, magnitude_sq(MathArray<double, 3>{x[p], y[p], z[p]} - centre));
+            }
+            this->nodes[node_index].extent = std::sqrt(extent_sq);
+
+            // Lots of particles on top of each other would split forever.
+            if (end - begin <= this->leaf_size || depth >= max_depth) {
+                return;
+            }
+
+            // Counting sort into octants, bit k set for the upper half along k.
+            const auto octant = [&](const size_t p) {
+                return size_t(x[p] >= centre[0]) | size_t(y[p] >= centre[1]) << 1 | size_t(z[p] >= centre[2]) << 2;
+            };
+
+            size_t counts[8] = {};
+            for (size_t i = begin; i < end; ++i) {
+                ++counts[octant(this->order[i])];
+            }
+
+            size_t offsets[8];
+            size_t running = begin;
+            for (size_t o = 0; o < 8; ++o) {
+                offsets[o] = running;
+                running += counts[o];
+            }
+
+            for (size_t i = begin; i < end; ++i) {
+                const size_t p = this->order[i];
+                scratch[offsets[octant(p)]++] = p;
+            }
+            std::copy(scratch.begin() + begin, scratch.begin() + end, this->order.begin() + begin);
+
+            const size_t first_child = this->nodes.size();
+            size_t child_begin = begin;
+
+            for (size_t o = 0; o < 8; ++o) {
+                if (counts[o] == 0) {
+                    continue;
+                }
+
+                MathArray<double, 3> child_centre{};
+                for (size_t k = 0; k < 3; ++k) {
+                    child_centre[k] = centre[k] + ((o >> k) & 1 ? 0.5 : -0.5) * half_size[k];
+                }
+
+                this->nodes.push_back(Node{child_centre, half_size / 2.0, 0, child_begin, child_begin + counts[o], none, 0});
+                child_begin += counts[o];
+            }
+
+            const size_t child_count = this->nodes.size() - first_child;
+            this->nodes[node_index].first_child = first_child;
+            this->nodes[node_index].child_count = child_count;
+
+            for (size_t c = first_child; c < first_child + child_count; ++c) {
+                this->split(c, x, y, z, scratch, depth + 1);
+            }
+        }
+
+        void build_expansions() {
+            this->expansion_positions.resize(expansion_size * this->nodes.size());
+            this->expansion_forces.resize(expansion_size * this->nodes.size());
+
+            for (size_t n = 0; n < this->nodes.size(); ++n) {
+                const Node& node = this->nodes[n];
+
+                MathArray<double, 3> total{};
+                MathArray<double, 3> moments[3] = {};
+
+                for (size_t i = node.begin; i < node.end; ++i) {
+                    const MathArray<double, 3> offset = this->sorted_positions[i].get() - node.centre;
+                    const MathArray<double, 3> force = this->sorted_forces[i].get();
+
+                    total += force;
+                    for (size_t k = 0; k < 3; ++k) {
+                        moments[k] += offset[k] * force;
+                    }
+                }
+
+                // Small enough that the central difference is as good as the
+                // exact derivative, big enough not to lose digits cancelling.
+                const double eps = node.extent > 0 ? 1e-3 * node.extent : 1.0;
+                const size_t first = expansion_size * n;
+
+                this->expansion_positions[first] = node.centre;
+                this->expansion_forces[first] = total;
+
+                for (size_t k = 0; k < 3; ++k) {
+                    MathArray<double, 3> step{};
+                    step[k] = eps;
+
+                    this->expansion_positions[first + 1 + 2 * k] = node.centre + step;
+                    this->expansion_forces[first + 1 + 2 * k] = moments[k] / (2 * eps);
+                    this->expansion_positions[first + 2 + 2 * k] = node.centre - step;
+                    this->expansion_forces[first + 2 + 2 * k] = moments[k] / (-2 * eps);
+                }
+            }
+        }
+
+        // Sum over the tree for one target, leaving out sorted source `self`
+        // (none if the target isn't a source). No prefactor.
+        MathArray<double, 3> evaluate(const MathArray<double, 3>& target, const size_t self, std::vector<size_t>& stack) const {
+            double ux = 0;
+            double uy = 0;
+            double uz = 0;
+
+            if (this->nodes.empty() || this->size() == 0) {
+                return MathArray<double, 3>{};
+            }
+
+            const double* x = this->sorted_positions.x().data();
+            const double* y = this->sorted_positions.y().data();
+            const double* z = this->sorted_positions.z().data();
+            const double* fx = this->sorted_forces.x().data();
+            const double* fy = this->sorted_forces.y().data();
+            const double* fz = this->sorted_forces.z().data();
+
+            stack.clear();
+            stack.push_back(0);
+
+            while (!stack.empty()) {
+                const Node& node = this->nodes[stack.back()];
+                const size_t node_index = stack.back();
+                stack.pop_back();
+
+                const size_t count = node.end - node.begin;
+                const double distance = magnitude(target - node.centre);
+
+                // Never expand a cell with the target within its extent:
+                // that would count the target's own force and put the
+                // expansion's point forces right next to it. For theta <= 1
+                // the theta test already rules that out, but not above 1.
+                if (count > expansion_size && distance > node.extent && this->theta * distance > node.extent) {
+                    const size_t first = expansion_size * node_index;
+
+                    Flow::accumulate(target[0], target[1], target[2],
+                                     this->expansion_positions.x().data(), this->expansion_positions.y().data(), this->expansion_positions.z().data(),
+                                     this->expansion_forces.x().data(), this->expansion_forces.y().data(), this->expansion_forces.z().data(),
+                                     first, first + expansion_size, ux, uy, uz);
+                } else if (node.first_child == none || count <= expansion_size) {
+                    // Split the range around the target, if it's in there.
+                    const size_t skip_begin = std::min(std::max(self, node.begin), node.end);
+                    const size_t skip_end = self == none ? node.end : std::min(std::max(self + 1, node.begin), node.end);
+
+                    Flow::accumulate(target[0], target[1], target[2], x, y, z, fx, fy, fz, node.begin, skip_begin, ux, uy, uz);
+                    Flow::accumulate(target[0], target[1], target[2], x, y, z, fx, fy, fz, skip_end, node.end, ux, uy, uz);
+                } else {
+                    for (size_t c = node.first_child; c < node.first_child + node.child_count; ++c) {
+                        stack.push_back(c);
+                    }
+                }
+            }
+
+            return MathArray<double, 3>{ux, uy, uz};
+        }
+    };
+}
@@ -0,0 +1,55 @@
+#include "arrayexpr.hpp"
+#include "benchutils.hpp"
+
+#include <memory>
+#include <random>
+
+using namespace dav;
+
+// About the size of the histograms we keep, and too big for the stack many
+// times over, so everything lives on the heap.
+constexpr size_t N = 1 << 16;
+
+template <class A>
+std::unique_ptr<A> random_array(std::mt19937& engine) {
+    std::uniform_real_distribution<double> dist(-1, 1);
+
+    auto output = std::make_unique<A>();
+    for (double& v : *output) {
+        v = dist(engine);
+    }
+
+    return output;
+}
+
+int main() {
+    std::mt19937 engine(42);
+
+    const auto a = random_array<LazyArray<double, N>>(engine);
+    const auto b = random_array<LazyArray<double, N>>(engine);
+    const auto c = random_array<LazyArray<double, N>>(engine);
+    const auto d = random_array<LazyArray<double, N>>(engine);
+    auto result = std::make_unique<LazyArray<double, N>>();
+
+    const MathArray<double, N>& a_eager = *a;
+    const MathArray<double, N>& b_eager = *b;
+    const MathArray<double, N>& c_eager = *c;
+    const MathArray<double, N>& d_eager = *d;
+    MathArray<double, N>& result_eager = *result;
+
+    const size_t repeats = 200;
+
+    const double eager = time_per_call([&]() {
+        result_eager = a_eager + b_eager * c_eager - d_eager;
+        do_not_optimise(result_eager);
+    }, repeats);
+
+    const double lazy = time_per_call([&]() {
+        *result = *a + *b * *c - *d;
+        do_not_optimise(*result);
+    }, repeats);
+
+    report_timing("eager a + b * c - d (N=65536)", eager);
+    report_timing("lazy a + b * c - d (N=65536)", lazy);
+    report_speedup("lazy speedup", eager, lazy);
+}
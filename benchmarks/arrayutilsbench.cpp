@@ -0,0 +1,98 @@
+#include "arrayutils.hpp"
+#include "benchutils.hpp"
+
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace dav;
+
+constexpr size_t count = 4096;
+constexpr size_t repeats = 2000;
+
+// The cross product as it was before it was written out by hand.
+MathArray<double, 3> levicevita_cross(const MathArray<double, 3>& a, const MathArray<double, 3>& b) {
+    MathArray<double, 3> output{};
+
+    for (size_t i = 0; i < 3; ++i) {
+        for (size_t j = 0; j < 3; ++j) {
+            for (size_t k = 0; k < 3; ++k) {
+                output[i] += levicevita(i, j, k) * a[j] * b[k];
+            }
+        }
+    }
+
+    return output;
+}
+
+template <size_t N>
+std::vector<MathArray<double, N>> random_vectors(std::mt19937& engine) {
+    std::uniform_real_distribution<double> dist(-1, 1);
+
+    std::vector<MathArray<double, N>> output(count);
+    for (auto& v : output) {
+        for (double& x : v) {
+            x = dist(engine);
+        }
+    }
+
+    return output;
+}
+
+template <size_t N, class Generic, class Specialised>
+void compare(const std::string& name, const std::vector<MathArray<double, N>>& a, const std::vector<MathArray<double, N>>& b, Generic generic, Specialised specialised) {
+    const double generic_time = time_per_call([&]() {
+        double total = 0;
+        for (size_t i = 0; i < count; ++i) {
+            total += generic(a[i], b[i]);
+        }
+        do_not_optimise(total);
+    }, repeats);
+
+    const double specialised_time = time_per_call([&]() {
+        double total = 0;
+        for (size_t i = 0; i < count; ++i) {
+            total += specialised(a[i], b[i]);
+        }
+        do_not_optimise(total);
+    }, repeats);
+
+    report_timing(name + " generic", generic_time / count);
+    report_timing(name + " specialised", specialised_time / count);
+    report_speedup(name + " speedup", generic_time, specialised_time);
+}
+
+int main() {
+    std::mt19937 engine(42);
+
+    const auto a3 = random_vectors<3>(engine);
+    const auto b3 = random_vectors<3>(engine);
+    const auto a4 = random_vectors<4>(engine);
+    const auto b4 = random_vectors<4>(engine);
+
+    using V3 = MathArray<double, 3>;
+    using V4 = MathArray<double, 4>;
+
+    compare<3>("dot<double, 3>", a3, b3,
+        [](const V3& a, const V3& b) { return (a * b).sum(); },
+        [](const V3& a, const V3& b) { return a.dot(b); });
+    compare<3>("magnitude<double, 3>", a3, b3,
+        [](const V3& a, const V3&) { return magnitude<double, 3>(a); },
+        [](const V3& a, const V3&) { return magnitude(a); });
+    compare<3>("distance_between<double, 3>", a3, b3,
+        [](const V3& a, const V3& b) { return distance_between<double, 3>(a, b); },
+        [](const V3& a, const V3& b) { return distance_between(a, b); });
+    compare<3>("cross<double, 3>", a3, b3,
+        [](const V3& a, const V3& b) { return levicevita_cross(a, b)[2]; },
+        [](const V3& a, const V3& b) { return a.cross(b)[2]; });
+
+    compare<4>("dot<double, 4>", a4, b4,
+        [](const V4& a, const V4& b) { return (a * b).sum(); },
+        [](const V4& a, const V4& b) { return a.dot(b); });
+    compare<4>("magnitude<double, 4>", a4, b4,
+        [](const V4& a, const V4&) { return magnitude<double, 4>(a); },
+        [](const V4& a, const V4&) { return magnitude(a); });
+    compare<4>("distance_between<double, 4>", a4, b4,
+        [](const V4& a, const V4& b) { return distance_between<double, 4>(a, b); },
+        [](const V4& a, const V4& b) { return distance_between(a, b); });
+}
@@ -0,0 +1,77 @@
+#include "barneshut.hpp"
+#include "benchutils.hpp"
+
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+
+using namespace dav;
+
+// Roughly a dilute suspension sedimenting onto a wall.
+constexpr double density = 0.05;
+
+void bench_barnes_hut(const size_t n, const bool compare_direct) {
+    std::mt19937 engine(42);
+    std::normal_distribution<double> component(0, 1);
+
+    const double side = std::cbrt(n / density);
+    const BoundingBox bb(0, side, 0, side, 1, side + 1);
+
+    VectorField positions;
+    VectorField forces;
+    for (size_t i = 0; i < n; ++i) {
+        positions.push_back(bb.random_point_in_bounds(engine));
+        forces.push_back(MathArray<double, 3>{component(engine), component(engine), component(engine) - 1});
+    }
+
+    const std::string suffix = " (N=" + std::to_string(n) + ")";
+    VectorField exact(n);
+
+    double direct = 0;
+    if (compare_direct) {
+        direct = time_per_call([&]() {
+            blake_flow_batch(positions.x().data(), positions.y().data(), positions.z().data(),
+                             forces.x().data(), forces.y().data(), forces.z().data(),
+                             n, 1.0, exact.x().data(), exact.y().data(), exact.z().data());
+            do_not_optimise(exact);
+        }, 1);
+        report_timing("blake_flow_batch" + suffix, direct);
+    }
+
+    for (const double theta : {0.3, 0.6}) {
+        BarnesHutTree<BlakeFlow> tree(bb, theta);
+        VectorField velocities;
+
+        const double build = time_per_call([&]() {
+            tree.build(positions, forces);
+        }, 3);
+
+        const double flow = time_per_call([&]() {
+            tree.flow_at_sources(1.0, velocities);
+            do_not_optimise(velocities);
+        }, 3);
+
+        const std::string label = "Barnes-Hut theta=" + std::to_string(theta).substr(0, 3);
+        report_timing(label + " build" + suffix, build);
+        report_timing(label + " flow" + suffix, flow);
+
+        if (compare_direct) {
+            double error = 0;
+            double norm = 0;
+            for (size_t i = 0; i < n; ++i) {
+                error += magnitude_sq(velocities[i].get() - exact[i].get());
+                norm += magnitude_sq(exact[i].get());
+            }
+
+            std::cout << label << " relative rms error" << suffix << ": " << std::sqrt(error / norm) << std::endl;
+            report_speedup(label + " vs direct" + suffix, direct, build + flow);
+        }
+    }
+}
+
+int main() {
+    bench_barnes_hut(2'000, true);
+    bench_barnes_hut(20'000, true);
+    bench_barnes_hut(100'000, false);
+}
@@ -0,0 +1,101 @@
+#include "celllist.hpp"
+#include "benchutils.hpp"
+
+#include <cmath>
+#include <random>
+#include <string>
+
+using namespace dav;
+
+// Number density and cutoff roughly like a dilute Brownian suspension with a
+// short-ranged pair interaction.
+constexpr double density = 0.5;
+constexpr double cutoff = 2.5;
+
+void bench_cell_list(const size_t n, const bool compare_brute_force) {
+    std::mt19937 engine(42);
+
+    const double side = std::cbrt(n / density);
+    const BoundingBox bb(side, side, side);
+
+    VectorField positions;
+    positions.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        positions.push_back(bb.random_point_in_bounds(engine));
+    }
+
+    // A small Brownian step, so update() has a realistic amount to do.
+    VectorField jiggled(positions);
+    std::normal_distribution<double> jiggle(0, 0.05);
+    for (size_t i = 0; i < n; ++i) {
+        jiggled[i] = bb.reflect(jiggled[i].get() + MathArray<double, 3>{jiggle(engine), jiggle(engine), jiggle(engine)});
+    }
+
+    CellList cells(bb, cutoff);
+    const std::string suffix = " (N=" + std::to_string(n) + ")";
+
+    const double build = time_per_call([&]() {
+        cells.build(positions);
+    }, 5);
+    report_timing("build" + suffix, build);
+
+    bool flip = false;
+    size_t moved = 0;
+    const double update = time_per_call([&]() {
+        moved = cells.update(flip ? positions : jiggled);
+        flip = !flip;
+    }, 10);
+    report_timing("update after small step" + suffix, update);
+
+    cells.build(positions);
+    size_t pairs = 0;
+    const double neighbours = time_per_call([&]() {
+        pairs = 0;
+        cells.for_each_neighbour_pair(positions, [&](size_t, size_t, double) {
+            ++pairs;
+        });
+    }, 3);
+    report_timing("for_each_neighbour_pair" + suffix, neighbours);
+
+    const double iterate = time_per_call([&]() {
+        size_t candidates = 0;
+        for (const auto pair : cells.pairs()) {
+            candidates += pair.first ^ pair.second;
+        }
+        do_not_optimise(candidates);
+    }, 3);
+    report_timing("pairs() iteration (candidates only)" + suffix, iterate);
+
+    if (compare_brute_force) {
+        const double cutoff_sq = cutoff * cutoff;
+        const Span<const double> x = static_cast<const VectorField&>(positions).x();
+        const Span<const double> y = static_cast<const VectorField&>(positions).y();
+        const Span<const double> z = static_cast<const VectorField&>(positions).z();
+
+        size_t brute_pairs = 0;
+        const double brute = time_per_call([&]() {
+            brute_pairs = 0;
+            for (size_t i = 0; i < n; ++i) {
+                for (size_t j = i + 1; j < n; ++j) {
+                    const double dx = x[i] - x[j];
+                    const double dy = y[i] - y[j];
+                    const double dz = z[i] - z[j];
+                    brute_pairs += (dx * dx + dy * dy + dz * dz) < cutoff_sq;
+                }
+            }
+        }, 1);
+
+        report_timing("brute force pair search" + suffix, brute);
+        report_speedup("cell list speedup over brute force" + suffix, brute, neighbours);
+
+        if (brute_pairs != pairs) {
+            std::cout << "Pair counts differ! " << brute_pairs << " vs " << pairs << std::endl;
+        }
+    }
+}
+
+int main() {
+    bench_cell_list(10'000, true);
+    bench_cell_list(100'000, false);
+    bench_cell_list(1'000'000, false);
+}
@@ -0,0 +1,171 @@
+#include "ewald.hpp"
+#include "benchutils.hpp"
+
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace dav;
+
+// Largest difference relative to the largest velocity. Spherically
+// truncated lattice sums converge to the Ewald sum plus a uniform flow and a
+// uniform strain (the conditionally convergent part, which depends on the
+// shape of the summation region), so the best-fit affine difference is
+// taken out first.
+double relative_difference(const VectorField& positions, const VectorField& lattice, const VectorField& ewald) {
+    const size_t n = ewald.size();
+
+    // Least squares fit of each component of the difference to c + g . x,
+    // through the normal equations.
+    double normal[4][7] = {};
+    for (size_t i = 0; i < n; ++i) {
+        const double basis[4] = {1, positions[i][0], positions[i][1], positions[i][2]};
+        const MathArray<double, 3> difference = lattice[i].get() - ewald[i].get();
+
+        for (size_t a = 0; a < 4; ++a) {
+            for (size_t b = 0; b < 4; ++b) {
+                normal[a][b] += basis[a] * basis[b];
+            }
+            for (size_t c = 0; c < 3; ++c) {
+                normal[a][4 + c] += basis[a] * difference[c];
+            }
+        }
+    }
+
+    // Gauss-Jordan; the matrix is symmetric positive definite.
+    for (size_t a = 0; a < 4; ++a) {
+        const double pivot = normal[a][a];
+        for (size_t b = 0; b < 7; ++b) {
+            normal[a][b] /= pivot;
+        }
+
+        for (size_t row = 0; row < 4; ++row) {
+            if (row == a) {
+                continue;
+            }
+
+            const double factor = normal[row][a];
+            for (size_t b = 0; b < 7; ++b) {
+                normal[row][b] -= factor * normal[a][b];
+            }
+        }
+    }
+
+    double difference = 0;
+    double scale = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const double basis[4] = {1, positions[i][0], positions[i][1], positions[i][2]};
+        MathArray<double, 3> affine{};
+
+        for (size_t c = 0; c < 3; ++c) {
+            for (size_t a = 0; a < 4; ++a) {
+                affine[c] += normal[a][4 + c] * basis[a];
+            }
+        }
+
+        difference = std::max(difference, magnitude(lattice[i].get() - ewald[i].get() - affine));
+        scale = std::max(scale, magnitude(ewald[i].get()));
+    }
+
+    return difference / scale;
+}
+
+void bench_ewald(const size_t n) {
+    std::mt19937 engine(42);
+    std::normal_distribution<double> component(0, 1);
+
+    const double side = std::cbrt(n / 0.1);
+    const BoundingBox bb(side, side, side);
+
+    VectorField positions;
+    VectorField forces;
+    MathArray<double, 3> total{};
+    for (size_t i = 0; i < n; ++i) {
+        positions.push_back(bb.random_point_in_bounds(engine));
+        forces.push_back(MathArray<double, 3>{component(engine), component(engine), component(engine)});
+        total += forces[i].get();
+    }
+
+    // No net force, or the lattice sums don't converge at all.
+    for (size_t i = 0; i < n; ++i) {
+        forces[i] = forces[i].get() - total / double(n);
+    }
+
+    const std::string suffix = " (N=" + std::to_string(n) + ")";
+
+    VectorField reference;
+    for (const double tolerance : {1e-4, 1e-8}) {
+        const EwaldParameters parameters = EwaldParameters::for_tolerance(bb, n, tolerance);
+        const SpectralEwald ewald(bb, parameters, 1.0, 0, 1);
+
+        std::vector<double> ux(n), uy(n), uz(n);
+        const double real = time_per_call([&]() {
+            ewald.real_space(positions.x().data(), positions.y().data(), positions.z().data(),
+                             forces.x().data(), forces.y().data(), forces.z().data(),
+                             n, ux.data(), uy.data(), uz.data());
+            do_not_optimise(ux);
+        }, 3);
+
+        const double k = time_per_call([&]() {
+            ewald.k_space(positions.x().data(), positions.y().data(), positions.z().data(),
+                          forces.x().data(), forces.y().data(), forces.z().data(),
+                          n, ux.data(), uy.data(), uz.data());
+            do_not_optimise(ux);
+        }, 3);
+
+        std::ostringstream label;
+        label << "spectral Ewald tol=" << tolerance << " grid=" << parameters.grid[0] << "^3";
+        report_timing(label.str() + " real space" + suffix, real);
+        report_timing(label.str() + " k space" + suffix, k);
+
+        ewald.apply(positions, forces, reference);
+    }
+
+    // Stokeslets over all images within `shells` box lengths, summed in
+    // spherical shells.
+    for (const int shells : {1, 2, 3}) {
+        VectorField velocities(n);
+
+        const double direct = time_per_call([&]() {
+            for (size_t i = 0; i < n; ++i) {
+                double ux = 0, uy = 0, uz = 0;
+
+                for (int a = -shells; a <= shells; ++a) {
+                    for (int b = -shells; b <= shells; ++b) {
+                        for (int c = -shells; c <= shells; ++c) {
+                            if (a * a + b * b + c * c > shells * shells) {
+                                continue;
+                            }
+
+                            const double tx = positions[i][0] - a * side;
+                            const double ty = positions[i][1] - b * side;
+                            const double tz = positions[i][2] - c * side;
+                            const bool self_image = a == 0 && b == 0 && c == 0;
+
+                            stokeslet_flow_accumulate(tx, ty, tz, positions.x().data(), positions.y().data(), positions.z().data(),
+                                                      forces.x().data(), forces.y().data(), forces.z().data(), 0, self_image ? i : n, ux, uy, uz);
+                            if (self_image) {
+                                stokeslet_flow_accumulate(tx, ty, tz, positions.x().data(), positions.y().data(), positions.z().data(),
+                                                          forces.x().data(), forces.y().data(), forces.z().data(), i + 1, n, ux, uy, uz);
+                            }
+                        }
+                    }
+                }
+
+                velocities[i] = MathArray<double, 3>{ux, uy, uz} / (8 * M_PI);
+            }
+            do_not_optimise(velocities);
+        }, 1);
+
+        report_timing("lattice sum, " + std::to_string(shells) + " shells" + suffix, direct);
+        std::cout << "lattice sum, " << shells << " shells, relative error" << suffix << ": " << relative_difference(positions, velocities, reference) << std::endl;
+    }
+}
+
+int main() {
+    bench_ewald(1'000);
+    bench_ewald(4'000);
+}
@@ -0,0 +1,388 @@
+#include "fluidutils.hpp"
+#include "benchutils.hpp"
+
+#include <random>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace dav;
+
+// shear_flow_at and translating_flow_at as they were before being written
+// out in closed form, to compare the new ones against.
+MathArray<double, 3> legacy_translating_flow_at(const MathArray<double, 3>& position,
+                                                const MathArray<double, 3>& sphere_position,
+                                                const MathArray<double, 3>& translation_velocity,
+                                                const double sphere_radius) {
+
+    const MathArray<double, 3> new_coords = position - sphere_position;
+    const double distance = magnitude(new_coords);
+
+    MathArray<double, 3> flow_speed{};
+
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            flow_speed[i] -= 0.75 * sphere_radius * translation_velocity[j] * delta(i, j) / distance;
+            flow_speed[i] -= 0.75 * sphere_radius * translation_velocity[j] * new_coords[i] * new_coords[j] / std::pow(distance, 3);
+
+            flow_speed[i] -= 0.75 * std::pow(sphere_radius, 3) * translation_velocity[j] * delta(i, j) / (3.0 * std::pow(distance, 3));
+            flow_speed[i] += 0.75 * std::pow(sphere_radius, 3) * translation_velocity[j] * new_coords[i] * new_coords[j] / std::pow(distance, 5);
+        }
+    }
+
+    return flow_speed + translation_velocity;
+}
+
+MathArray<double, 3> legacy_shear_flow_at(const MathArray<double, 3>& position,
+                                          const MathArray<double, 3>& sphere_position,
+                                          const double sphere_radius,
+                                          const double shear_rate) {
+
+    const MathArray<double, 3> x = position - sphere_position;
+    const double r = magnitude(x);
+    const double a = sphere_radius;
+
+    if (r < a) {
+        return MathArray<double, 3>{0, 0, 0};
+    }
+
+    const auto strain = [shear_rate](const int i, const int j) {
+        return ((i == 0 && j == 2) || (i == 2 && j == 0)) ? shear_rate * 0.5 : 0.0;
+    };
+
+    MathArray<double, 3> flow_speed{0, 0, 0};
+
+    for (int i = 0; i < 3; ++i) {
+        double term_1 = 0;
+        double term_2 = 0;
+        double term_3 = 0;
+
+        for (int j = 0; j < 3; ++j) {
+            for (int k = 0; k < 3; ++k) {
+                const double strain_tensor_value = strain(j, k);
+
+                if (strain_tensor_value != 0) {
+                    term_1 -= 2.5 * std::pow(a, 3) / std::pow(r, 5) * x[i] * x[j] * x[k] * strain_tensor_value;
+
+                    const double factor = 0.5 * std::pow(a / r, 5) * strain_tensor_value;
+                    term_2 -= factor * (delta(i, j) * x[k] + delta(i, k) * x[j]);
+                    term_3 += factor * 5 * x[i] * x[j] * x[k] / std::pow(r, 2);
+                }
+            }
+        }
+
+        flow_speed[i] += term_1 + term_2 + term_3;
+    }
+
+    const MathArray<double, 3> rotation_vector{0, 0.5 * shear_rate, 0};
+    flow_speed -= rotation_vector.cross(x) * std::pow(a / r, 3);
+
+    flow_speed += legacy_translating_flow_at(position, sphere_position, MathArray<double, 3>{shear_rate * position[2]}, a);
+
+    return flow_speed;
+}
+
+void bench_blake_batch(const size_t n, const bool compare_scalar) {
+    std::mt19937 engine(42);
+    std::uniform_real_distribution<double> horizontal(-100, 100);
+    std::uniform_real_distribution<double> height(1, 50);
+    std::uniform_real_distribution<double> force(-1, 1);
+
+    std::vector<double> x(n), y(n), z(n), fx(n), fy(n), fz(n), ux(n), uy(n), uz(n);
+    std::vector<MathArray<double, 3>> positions(n), forces(n), velocities(n);
+
+    for (size_t i = 0; i < n; ++i) {
+        positions[i] = MathArray<double, 3>{horizontal(engine), horizontal(engine), height(engine)};
+        forces[i] = MathArray<double, 3>{force(engine), force(engine), force(engine)};
+
+        x[i] = positions[i][0];
+        y[i] = positions[i][1];
+        z[i] = positions[i][2];
+        fx[i] = forces[i][0];
+        fy[i] = forces[i][1];
+        fz[i] = forces[i][2];
+    }
+
+    const std::string suffix = " (N=" + std::to_string(n) + ")";
+
+    const double batch = time_per_call([&]() {
+        blake_flow_batch(x.data(), y.data(), z.data(), fx.data(), fy.data(), fz.data(), n, 1.0, ux.data(), uy.data(), uz.data());
+        do_not_optimise(ux);
+    }, 3);
+    report_timing("blake_flow_batch" + suffix, batch);
+
+    // The scalar version is far too slow to run at the larger sizes.
+    if (!compare_scalar) {
+        return;
+    }
+
+    const double scalar = time_per_call([&]() {
+        for (size_t i = 0; i < n; ++i) {
+            velocities[i] = MathArray<double, 3>{};
+            for (size_t j = 0; j < n; ++j) {
+                if (i != j) {
+                    velocities[i] += blake_flow_at(positions[i], positions[j], forces[j], 1.0);
+                }
+            }
+        }
+        do_not_optimise(velocities);
+    }, 1);
+
+    report_timing("blake_flow_at pair loop" + suffix, scalar);
+    report_speedup("blake_flow_batch speedup" + suffix, scalar, batch);
+}
+
+void bench_mobility_assembly(const size_t n) {
+    std::mt19937 engine(42);
+    std::uniform_real_distribution<double> coordinate(1, 100);
+
+    VectorField positions(n);
+    for (size_t i = 0; i < n; ++i) {
+        positions[i] = MathArray<double, 3>{coordinate(engine), coordinate(engine), coordinate(engine)};
+    }
+
+    const RPYWallMobility kernel{1.0, 1.0};
+    const size_t stride = 3 * n;
+    std::vector<double> matrix(stride * stride);
+
+    const std::string suffix = " (N=" + std::to_string(n) + ")";
+
+    // Every block evaluated, straight through in row order.
+    const double naive = time_per_call([&]() {
+        for (size_t i = 0; i < n; ++i) {
+            for (size_t j = 0; j < n; ++j) {
+                const Tensor<double, 3, 3> block = kernel(positions[i].get(), positions[j].get());
+
+                for (size_t a = 0; a < 3; ++a) {
+                    for (size_t b = 0; b < 3; ++b) {
+                        matrix[(3 * i + a) * stride + 3 * j + b] = block[{a, b}];
+                    }
+                }
+            }
+        }
+        do_not_optimise(matrix);
+    }, 3);
+
+    // One triangle, with the mirror copied down afterwards.
+    const double triangle = time_per_call([&]() {
+        for (size_t i = 0; i < n; ++i) {
+            for (size_t j = i; j < n; ++j) {
+                const Tensor<double, 3, 3> block = kernel(positions[i].get(), positions[j].get());
+
+                for (size_t a = 0; a < 3; ++a) {
+                    for (size_t b = 0; b < 3; ++b) {
+                        matrix[(3 * i + a) * stride + 3 * j + b] = block[{a, b}];
+                    }
+                }
+            }
+        }
+
+        for (size_t row = 0; row < stride; ++row) {
+            for (size_t column = 0; column < row; ++column) {
+                matrix[row * stride + column] = matrix[column * stride + row];
+            }
+        }
+        do_not_optimise(matrix);
+    }, 3);
+
+    const double blocked = time_per_call([&]() {
+        assemble_mobility_matrix(kernel, positions.x().data(), positions.y().data(), positions.z().data(), n, matrix.data());
+        do_not_optimise(matrix);
+    }, 3);
+
+    report_timing("RPY wall matrix, all blocks" + suffix, naive);
+    report_timing("RPY wall matrix, triangle then copy" + suffix, triangle);
+    report_timing("assemble_mobility_matrix" + suffix, blocked);
+    report_speedup("assemble_mobility_matrix vs all blocks" + suffix, naive, blocked);
+    report_speedup("assemble_mobility_matrix vs triangle then copy" + suffix, triangle, blocked);
+}
+
+void bench_mobility_operator(const size_t n, const bool compare_dense) {
+    std::mt19937 engine(42);
+    std::uniform_real_distribution<double> coordinate(1, 100);
+    std::normal_distribution<double> component(0, 1);
+
+    VectorField positions(n);
+    VectorField forces(n);
+    for (size_t i = 0; i < n; ++i) {
+        positions[i] = MathArray<double, 3>{coordinate(engine), coordinate(engine), coordinate(engine)};
+        forces[i] = MathArray<double, 3>{component(engine), component(engine), component(engine)};
+    }
+
+    const BlakeMobility kernel{1.0, 1.0};
+    const std::string suffix = " (N=" + std::to_string(n) + ")";
+
+    VectorField velocities(n);
+    const MobilityOperator<BlakeMobility> serial(kernel, positions, 1);
+    const double matrix_free = time_per_call([&]() {
+        serial.apply(forces, velocities);
+        do_not_optimise(velocities);
+    }, 3);
+
+    const MobilityOperator<BlakeMobility> threaded(kernel, positions);
+    const double matrix_free_threaded = time_per_call([&]() {
+        threaded.apply(forces, velocities);
+        do_not_optimise(velocities);
+    }, 3);
+
+    report_timing("Blake M F, matrix-free, 1 thread" + suffix, matrix_free);
+    report_timing("Blake M F, matrix-free, all " + std::to_string(default_thread_count()) + " hardware threads" + suffix, matrix_free_threaded);
+    report_speedup("matrix-free threading" + suffix, matrix_free, matrix_free_threaded);
+
+    if (!compare_dense) {
+        std::cout << "dense matrix would need " << 72.0 * n * n / 1e9 << " GB" << std::endl;
+        return;
+    }
+
+    std::vector<double> force(3 * n);
+    std::vector<double> velocity(3 * n);
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t k = 0; k < 3; ++k) {
+            force[3 * i + k] = forces[i][k];
+        }
+    }
+
+    std::vector<double> matrix;
+    const double assemble = time_per_call([&]() {
+        matrix = assemble_mobility_matrix(kernel, positions);
+        do_not_optimise(matrix);
+    }, 3);
+
+    const double dense = time_per_call([&]() {
+        for (size_t row = 0; row < 3 * n; ++row) {
+            double sum = 0;
+            for (size_t column = 0; column < 3 * n; ++column) {
+                sum += matrix[row * 3 * n + column] * force[column];
+            }
+            velocity[row] = sum;
+        }
+        do_not_optimise(velocity);
+    }, 3);
+
+    report_timing("Blake dense assembly" + suffix, assemble);
+    report_timing("Blake dense M F" + suffix, dense);
+    report_speedup("matrix-free vs assemble then multiply" + suffix, assemble + dense, matrix_free);
+}
+
+void bench_shear_flow(const size_t n) {
+    std::mt19937 engine(42);
+    std::uniform_real_distribution<double> coordinate(-20, 20);
+
+    const MathArray<double, 3> sphere_position{0, 0, 10};
+    const double radius = 1.0;
+    const double shear_rate = 1.0;
+
+    VectorField positions(n);
+    for (size_t i = 0; i < n; ++i) {
+        positions[i] = sphere_position + MathArray<double, 3>{coordinate(engine), coordinate(engine), coordinate(engine)};
+    }
+
+    std::vector<MathArray<double, 3>> points(n);
+    std::vector<MathArray<double, 3>> flow(n);
+    for (size_t i = 0; i < n; ++i) {
+        points[i] = positions[i].get();
+    }
+
+    VectorField batch(n);
+    const std::string suffix = " (N=" + std::to_string(n) + ")";
+
+    const double legacy = time_per_call([&]() {
+        for (size_t i = 0; i < n; ++i) {
+            flow[i] = legacy_shear_flow_at(points[i], sphere_position, radius, shear_rate);
+        }
+        do_not_optimise(flow);
+    }, 3);
+
+    const double scalar = time_per_call([&]() {
+        for (size_t i = 0; i < n; ++i) {
+            flow[i] = shear_flow_at(points[i], sphere_position, radius, shear_rate);
+        }
+        do_not_optimise(flow);
+    }, 3);
+
+    const double batched = time_per_call([&]() {
+        shear_flow_batch(positions, sphere_position, radius, shear_rate, batch);
+        do_not_optimise(batch);
+    }, 3);
+
+    const ShearFlow shear{shear_rate};
+    const GeneralLinearFlow general{shear.strain_tensor(), shear.rotation_vector()};
+    const double generic = time_per_call([&]() {
+        linear_flow_batch(general, positions, sphere_position, radius, batch);
+        do_not_optimise(batch);
+    }, 3);
+
+    report_timing("shear flow, std::pow loops" + suffix, legacy);
+    report_timing("shear_flow_at" + suffix, scalar);
+    report_timing("shear_flow_batch" + suffix, batched);
+    report_speedup("shear_flow_at vs std::pow loops" + suffix, legacy, scalar);
+    report_speedup("shear_flow_batch vs std::pow loops" + suffix, legacy, batched);
+    report_timing("linear_flow_batch, general strain tensor" + suffix, generic);
+    report_speedup("ShearFlow vs general strain tensor" + suffix, generic, batched);
+}
+
+void bench_translating_flow(const size_t grid) {
+    const MathArray<double, 3> sphere_position{0.5, 0.5, 0.5};
+    const MathArray<double, 3> velocity{1, 0.5, -0.25};
+    const double radius = 0.1;
+
+    // Nodes of a grid x grid x grid lattice over the unit cube.
+    const size_t n = grid * grid * grid;
+    VectorField positions(n);
+    std::vector<MathArray<double, 3>> points(n);
+    for (size_t i = 0; i < grid; ++i) {
+        for (size_t j = 0; j < grid; ++j) {
+            for (size_t k = 0; k < grid; ++k) {
+                const size_t index = (i * grid + j) * grid + k;
+                points[index] = MathArray<double, 3>{double(i), double(j), double(k)} / double(grid - 1);
+                positions[index] = points[index];
+            }
+        }
+    }
+
+    std::vector<MathArray<double, 3>> flow(n);
+    VectorField velocities(n);
+    const std::string suffix = " (" + std::to_string(grid) + "^3 grid)";
+
+    const double legacy = time_per_call([&]() {
+        for (size_t i = 0; i < n; ++i) {
+            flow[i] = legacy_translating_flow_at(points[i], sphere_position, velocity, radius);
+        }
+        do_not_optimise(flow);
+    }, 3);
+
+    const double scalar = time_per_call([&]() {
+        for (size_t i = 0; i < n; ++i) {
+            flow[i] = translating_flow_at(points[i], sphere_position, velocity, radius);
+        }
+        do_not_optimise(flow);
+    }, 3);
+
+    const double batched = time_per_call([&]() {
+        translating_flow_batch(positions, sphere_position, velocity, radius, velocities, 1);
+        do_not_optimise(velocities);
+    }, 3);
+
+    const double threaded = time_per_call([&]() {
+        translating_flow_batch(positions, sphere_position, velocity, radius, velocities);
+        do_not_optimise(velocities);
+    }, 3);
+
+    report_timing("translating flow, std::pow loops" + suffix, legacy);
+    report_timing("translating_flow_at" + suffix, scalar);
+    report_timing("translating_flow_batch, 1 thread" + suffix, batched);
+    report_timing("translating_flow_batch, all " + std::to_string(default_thread_count()) + " hardware threads" + suffix, threaded);
+    report_speedup("translating_flow_batch vs std::pow loops" + suffix, legacy, batched);
+    report_speedup("translating_flow_batch threading" + suffix, batched, threaded);
+}
+
+int main() {
+    bench_blake_batch(1'000, true);
+    bench_blake_batch(10'000, false);
+    bench_mobility_assembly(1'000);
+    bench_mobility_assembly(3'000);
+    bench_mobility_operator(1'000, true);
+    bench_mobility_operator(10'000, false);
+    bench_shear_flow(100'000);
+    bench_translating_flow(64);
+}
@@ -0,0 +1,158 @@
+#include "lanczos.hpp"
+#include "fluidutils.hpp"
+#include "benchutils.hpp"
+
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace dav;
+
+// Every heap allocation in the program goes through here, so the bench can
+// check that a step's worth of sampling doesn't allocate.
+std::atomic<size_t> allocations{0};
+
+void* operator new(const size_t size) {
+    ++allocations;
+
+    if (void* const pointer = std::malloc(size == 0 ? 1 : size)) {
+        return pointer;
+    }
+
+    throw std::bad_alloc();
+}
+
+void* operator new(const size_t size, const std::align_val_t alignment) {
+    ++allocations;
+
+    // aligned_alloc wants a whole number of alignments.
+    const size_t align = static_cast<size_t>(alignment);
+    const size_t rounded = (size + align - 1) / align * align;
+
+    if (void* const pointer = std::aligned_alloc(align, rounded == 0 ? align : rounded)) {
+        return pointer;
+    }
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept {
+    std::free(pointer);
+}
+
+// In-place lower Cholesky factor of a row-major n x n matrix, the O(n^3)
+// way of getting correlated noise.
+void cholesky(std::vector<double>& matrix, const size_t n) {
+    for (size_t j = 0; j < n; ++j) {
+        double* const row_j = matrix.data() + j * n;
+
+        double diagonal = row_j[j];
+        for (size_t k = 0; k < j; ++k) {
+            diagonal -= row_j[k] * row_j[k];
+        }
+        row_j[j] = std::sqrt(diagonal);
+
+        for (size_t i = j + 1; i < n; ++i) {
+            double* const row_i = matrix.data() + i * n;
+
+            double sum = row_i[j];
+            for (size_t k = 0; k < j; ++k) {
+                sum -= row_i[k] * row_j[k];
+            }
+            row_i[j] = sum / row_j[j];
+        }
+    }
+}
+
+void bench_correlated_noise(const size_t particles) {
+    std::mt19937 engine(42);
+
+    // Volume fraction around 5%.
+    const double side = std::cbrt(particles * 4.19 / 0.05);
+    std::uniform_real_distribution<double> coordinate(0, side);
+
+    VectorField positions(particles);
+    for (size_t i = 0; i < particles; ++i) {
+        positions[i] = MathArray<double, 3>{coordinate(engine), coordinate(engine), coordinate(engine)};
+    }
+
+    const RPYMobility kernel{1.0, 1.0};
+    const MobilityOperator<RPYMobility> mobility(kernel, positions);
+    const auto multiply = [&mobility](const double* in, double* out) {
+        mobility.apply(in, out);
+    };
+
+    const size_t n = mobility.dimension();
+    std::vector<double> w(n), out(n);
+    for (double& value : w) {
+        value = std::normal_distribution<double>(0, 1)(engine);
+    }
+
+    const std::string suffix = " (N=" + std::to_string(particles) + ")";
+
+    LanczosSqrt lanczos(n, 100, 1e-6);
+    const double krylov = time_per_call([&]() {
+        lanczos.apply(multiply, w.data(), out.data());
+        do_not_optimise(out);
+    }, 3);
+
+    report_timing("Lanczos sqrt(M) W, tolerance 1e-6" + suffix, krylov);
+    std::cout << "    " << lanczos.iterations() << " mobility products" << std::endl;
+
+    // With one thread the operator starts no threads, so once its scratch
+    // is sized a whole sample should allocate nothing.
+    const MobilityOperator<RPYMobility> serial(kernel, positions, 1);
+    const auto serial_multiply = [&serial](const double* in, double* out) {
+        serial.apply(in, out);
+    };
+    lanczos.sample(serial_multiply, engine, out.data());
+
+    const size_t before = allocations;
+    const size_t steps = 5;
+    for (size_t step = 0; step < steps; ++step) {
+        lanczos.sample(serial_multiply, engine, out.data());
+    }
+    do_not_optimise(out);
+
+    std::cout << "    " << (allocations - before) << " heap allocations in " << steps << " samples with n_threads = 1" << std::endl;
+
+    std::vector<double> matrix;
+    const double factorise = time_per_call([&]() {
+        matrix = assemble_mobility_matrix(kernel, positions);
+        cholesky(matrix, n);
+
+        for (size_t row = 0; row < n; ++row) {
+            double sum = 0;
+            for (size_t column = 0; column <= row; ++column) {
+                sum += matrix[row * n + column] * w[column];
+            }
+            out[row] = sum;
+        }
+        do_not_optimise(out);
+    }, 1);
+
+    report_timing("assemble, Cholesky, L W" + suffix, factorise);
+    report_speedup("Lanczos vs Cholesky" + suffix, factorise, krylov);
+}
+
+int main() {
+    bench_correlated_noise(300);
+    bench_correlated_noise(1'000);
+}
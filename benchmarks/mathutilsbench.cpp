@@ -0,0 +1,163 @@
+#include "mathutils.hpp"
+#include "benchutils.hpp"
+
+#include <cstdlib>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace dav;
+
+// The strtol/strtod and stringstream conversions that convert and
+// Config::convert_numeric used to use, kept here to measure against.
+long legacy_convert_long(const std::string& s) {
+    char* leftovers;
+    const long value = std::strtol(s.c_str(), &leftovers, 10);
+
+    if (value == 0 && leftovers == s.c_str()) {
+        throw number_format_exception("Couldn't convert string to long");
+    }
+
+    return value;
+}
+
+double legacy_convert_double(const std::string& s) {
+    char* leftovers;
+    const double value = std::strtod(s.c_str(), &leftovers);
+
+    if (value == 0 && leftovers == s.c_str()) {
+        throw number_format_exception("Couldn't convert string to double");
+    }
+
+    return value;
+}
+
+template <class T>
+T stringstream_convert(const std::string& s) {
+    T value;
+
+    std::stringstream ss;
+    ss << s;
+    ss >> value;
+
+    if (ss.fail()) {
+        throw std::runtime_error("Could not convert string to desired numeric");
+    }
+
+    return value;
+}
+
+void bench_milstein(const size_t n) {
+    std::mt19937 engine(42);
+    std::normal_distribution<double> normal(0, 1);
+
+    std::vector<double> x(n), x_prev(n), u(n), u_prev(n), w(n), w_prev(n), x_next(n);
+
+    for (size_t i = 0; i < n; ++i) {
+        x[i] = normal(engine);
+        x_prev[i] = normal(engine);
+        u[i] = normal(engine);
+        u_prev[i] = normal(engine);
+        w[i] = normal(engine);
+        w_prev[i] = normal(engine);
+    }
+
+    const double delta = 1e-3;
+    const std::string suffix = " (3N=" + std::to_string(n) + ")";
+
+    const double scalar = time_per_call([&]() {
+        for (size_t i = 0; i < n; ++i) {
+            x_next[i] = adams_bashforth_milstein(x[i], x_prev[i], u[i], u_prev[i], w[i], w_prev[i], delta);
+        }
+        do_not_optimise(x_next);
+    }, 200);
+
+    const double batch = time_per_call([&]() {
+        adams_bashforth_milstein_batch(x_next.data(), x.data(), x_prev.data(), u.data(), u_prev.data(), w.data(), w_prev.data(), delta, n);
+        do_not_optimise(x_next);
+    }, 200);
+
+    report_timing("adams_bashforth_milstein loop" + suffix, scalar);
+    report_timing("adams_bashforth_milstein_batch" + suffix, batch);
+    report_speedup("adams_bashforth_milstein_batch speedup" + suffix, scalar, batch);
+
+    const double euler_scalar = time_per_call([&]() {
+        for (size_t i = 0; i < n; ++i) {
+            x_next[i] = euler_maruyama(x[i], u[i], w[i], delta);
+        }
+        do_not_optimise(x_next);
+    }, 200);
+
+    const double euler_batch = time_per_call([&]() {
+        euler_maruyama_batch(x.data(), u.data(), w.data(), delta, n);
+        do_not_optimise(x);
+    }, 200);
+
+    report_timing("euler_maruyama loop" + suffix, euler_scalar);
+    report_timing("euler_maruyama_batch" + suffix, euler_batch);
+    report_speedup("euler_maruyama_batch speedup" + suffix, euler_scalar, euler_batch);
+}
+
+void bench_convert(const size_t n) {
+    std::mt19937 engine(42);
+    std::uniform_int_distribution<long> integer(-1'000'000'000, 1'000'000'000);
+    std::normal_distribution<double> normal(0, 1e3);
+
+    std::vector<std::string> integers(n), doubles(n);
+    for (size_t i = 0; i < n; ++i) {
+        integers[i] = std::to_string(integer(engine));
+
+        std::ostringstream ss;
+        ss.precision(17);
+        ss << normal(engine);
+        doubles[i] = ss.str();
+    }
+
+    const std::string suffix = " (N=" + std::to_string(n) + ")";
+
+    const auto bench_long = [&](auto&& f) {
+        return time_per_call([&]() {
+            long total = 0;
+            for (const std::string& s : integers) {
+                total += f(s);
+            }
+            do_not_optimise(total);
+        }, 10);
+    };
+
+    const auto bench_double = [&](auto&& f) {
+        return time_per_call([&]() {
+            double total = 0;
+            for (const std::string& s : doubles) {
+                total += f(s);
+            }
+            do_not_optimise(total);
+        }, 10);
+    };
+
+    const double long_new = bench_long([](const std::string& s) { return convert<long>(s); });
+    const double long_strtol = bench_long(legacy_convert_long);
+    const double long_stream = bench_long(stringstream_convert<long>);
+
+    report_timing("convert<long>" + suffix, long_new);
+    report_timing("strtol" + suffix, long_strtol);
+    report_timing("stringstream long" + suffix, long_stream);
+    report_speedup("convert<long> vs strtol" + suffix, long_strtol, long_new);
+    report_speedup("convert<long> vs stringstream" + suffix, long_stream, long_new);
+
+    const double double_new = bench_double([](const std::string& s) { return convert<double>(s); });
+    const double double_strtod = bench_double(legacy_convert_double);
+    const double double_stream = bench_double(stringstream_convert<double>);
+
+    report_timing("convert<double>" + suffix, double_new);
+    report_timing("strtod" + suffix, double_strtod);
+    report_timing("stringstream double" + suffix, double_stream);
+    report_speedup("convert<double> vs strtod" + suffix, double_strtod, double_new);
+    report_speedup("convert<double> vs stringstream" + suffix, double_stream, double_new);
+}
+
+int main() {
+    bench_milstein(3 * 100'000);
+    bench_convert(100'000);
+}
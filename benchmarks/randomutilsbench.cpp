@@ -0,0 +1,186 @@
+#include "randomutils.hpp"
+#include "boundingbox.hpp"
+#include "benchutils.hpp"
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace dav;
+
+void bench_weighted_sampling(const size_t bins, const size_t draws) {
+    std::mt19937 engine(42);
+    std::uniform_real_distribution<double> weight(0, 1);
+
+    std::vector<double> weights(bins);
+    for (double& w : weights) {
+        w = weight(engine);
+    }
+
+    const std::string suffix = " (bins=" + std::to_string(bins) + ", draws=" + std::to_string(draws) + ")";
+
+    const double linear = time_per_call([&]() {
+        size_t total = 0;
+        for (size_t i = 0; i < draws; ++i) {
+            total += weighted_index(weights, engine);
+        }
+        do_not_optimise(total);
+    }, 5);
+
+    const AliasSampler<double> sampler(weights);
+    const double alias = time_per_call([&]() {
+        size_t total = 0;
+        for (size_t i = 0; i < draws; ++i) {
+            total += sampler(engine);
+        }
+        do_not_optimise(total);
+    }, 5);
+
+    report_timing("weighted_index" + suffix, linear);
+    report_timing("AliasSampler" + suffix, alias);
+    report_speedup("AliasSampler speedup" + suffix, linear, alias);
+}
+
+void bench_cdf_sampling(const size_t bins, const size_t draws) {
+    std::mt19937 engine(42);
+    std::uniform_real_distribution<double> weight(0, 1);
+
+    std::vector<double> weights(bins);
+    for (double& w : weights) {
+        w = weight(engine);
+    }
+
+    const std::vector<double> cdf = cumsum(weights);
+    const GuideTableSampler<double> guide(weights);
+    std::uniform_real_distribution<double> u(0, cdf.back());
+
+    const std::string suffix = " (bins=" + std::to_string(bins) + ", draws=" + std::to_string(draws) + ")";
+
+    const double linear = time_per_call([&]() {
+        size_t total = 0;
+        for (size_t i = 0; i < draws; ++i) {
+            total += find_first_element_greater_than(cdf, u(engine));
+        }
+        do_not_optimise(total);
+    }, 3);
+
+    const double binary = time_per_call([&]() {
+        size_t total = 0;
+        for (size_t i = 0; i < draws; ++i) {
+            total += weighted_index_cdf(cdf, engine);
+        }
+        do_not_optimise(total);
+    }, 3);
+
+    const double guided = time_per_call([&]() {
+        size_t total = 0;
+        for (size_t i = 0; i < draws; ++i) {
+            total += guide(engine);
+        }
+        do_not_optimise(total);
+    }, 3);
+
+    report_timing("linear cdf search" + suffix, linear);
+    report_timing("weighted_index_cdf" + suffix, binary);
+    report_timing("GuideTableSampler" + suffix, guided);
+    report_speedup("weighted_index_cdf vs linear" + suffix, linear, binary);
+    report_speedup("GuideTableSampler vs weighted_index_cdf" + suffix, binary, guided);
+}
+
+void bench_engines(const size_t draws) {
+    std::mt19937 mersenne(42);
+    Philox4x32 philox(42);
+
+    const std::string suffix = " (draws=" + std::to_string(draws) + ")";
+
+    const double mersenne_time = time_per_call([&]() {
+        uint32_t total = 0;
+        for (size_t i = 0; i < draws; ++i) {
+            total += mersenne();
+        }
+        do_not_optimise(total);
+    }, 5);
+
+    const double philox_time = time_per_call([&]() {
+        uint32_t total = 0;
+        for (size_t i = 0; i < draws; ++i) {
+            total += philox();
+        }
+        do_not_optimise(total);
+    }, 5);
+
+    // Setting up a fresh stream per particle, as a parallel loop would.
+    const double philox_streams_time = time_per_call([&]() {
+        uint32_t total = 0;
+        for (size_t i = 0; i < draws / 4; ++i) {
+            Philox4x32 engine(42, i);
+            for (size_t k = 0; k < 4; ++k) {
+                total += engine();
+            }
+        }
+        do_not_optimise(total);
+    }, 5);
+
+    report_timing("std::mt19937" + suffix, mersenne_time);
+    report_timing("Philox4x32" + suffix, philox_time);
+    report_timing("Philox4x32, stream per 4 draws" + suffix, philox_streams_time);
+    report_speedup("Philox4x32 vs std::mt19937" + suffix, mersenne_time, philox_time);
+}
+
+void bench_normals(const size_t n) {
+    std::vector<double> samples(n);
+    const std::string suffix = " (N=" + std::to_string(n) + ")";
+
+    std::mt19937 mersenne(42);
+    const double standard = time_per_call([&]() {
+        std::normal_distribution<double> normal(0, 1);
+        for (double& x : samples) {
+            x = normal(mersenne);
+        }
+        do_not_optimise(samples);
+    }, 10);
+
+    const double bulk_mersenne = time_per_call([&]() {
+        fill_normal(samples, 1.0, mersenne);
+        do_not_optimise(samples);
+    }, 10);
+
+    Philox4x32 philox(42);
+    const double bulk_philox = time_per_call([&]() {
+        fill_normal(samples, 1.0, philox);
+        do_not_optimise(samples);
+    }, 10);
+
+    report_timing("std::normal_distribution, mt19937" + suffix, standard);
+    report_timing("fill_normal, mt19937" + suffix, bulk_mersenne);
+    report_timing("fill_normal, Philox4x32" + suffix, bulk_philox);
+    report_speedup("fill_normal mt19937 speedup" + suffix, standard, bulk_mersenne);
+    report_speedup("fill_normal Philox4x32 speedup" + suffix, standard, bulk_philox);
+}
+
+void bench_surface_points(const size_t draws) {
+    std::mt19937 engine(42);
+    const BoundingBox box(1000, 10, 10);
+
+    const double surface = time_per_call([&]() {
+        MathArray<double, 3> total{};
+        for (size_t i = 0; i < draws; ++i) {
+            total += box.random_point_on_surface(engine);
+        }
+        do_not_optimise(total);
+    }, 5);
+
+    report_timing("random_point_on_surface (draws=" + std::to_string(draws) + ")", surface);
+}
+
+int main() {
+    bench_weighted_sampling(6, 1'000'000);
+    bench_weighted_sampling(1'000, 100'000);
+    bench_weighted_sampling(10'000, 10'000);
+    bench_cdf_sampling(10'000, 100'000);
+    bench_cdf_sampling(50'000, 100'000);
+    bench_engines(10'000'000);
+    bench_normals(3 * 100'000);
+    bench_surface_points(1'000'000);
+}
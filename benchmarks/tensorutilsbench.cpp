@@ -0,0 +1,181 @@
+#include "tensorutils.hpp"
+#include "benchutils.hpp"
+
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace dav;
+
+// Tensor * Tensor as it was before the unrolled and blocked kernels.
+template <class T, size_t I, size_t J, size_t K>
+Tensor<T, I, J> triple_loop_product(const Tensor<T, I, K>& t1, const Tensor<T, K, J>& t2) noexcept {
+    Tensor<T, I, J> output{};
+
+    for (size_t i = 0; i < I; ++i) {
+        for (size_t j = 0; j < J; ++j) {
+            for (size_t k = 0; k < K; ++k) {
+                output[{i, j}] += t1[{i, k}] * t2[{k, j}];
+            }
+        }
+    }
+
+    return output;
+}
+
+template <size_t N>
+std::vector<Tensor<double, N, N>> random_tensors(const size_t count, std::mt19937& engine) {
+    std::uniform_real_distribution<double> element(-1, 1);
+
+    std::vector<Tensor<double, N, N>> output(count);
+    for (auto& t : output) {
+        for (double& x : t.data) {
+            x = element(engine);
+        }
+    }
+
+    return output;
+}
+
+// Many independent small products, like one per particle pair.
+template <size_t N>
+void bench_small(const size_t count) {
+    std::mt19937 engine(42);
+    const auto a = random_tensors<N>(count, engine);
+    const auto b = random_tensors<N>(count, engine);
+    std::vector<Tensor<double, N, N>> c(count);
+
+    const std::string suffix = " (" + std::to_string(N) + "x" + std::to_string(N) + ", " + std::to_string(count) + " products)";
+
+    const double naive = time_per_call([&]() {
+        for (size_t i = 0; i < count; ++i) {
+            c[i] = triple_loop_product(a[i], b[i]);
+        }
+        do_not_optimise(c);
+    }, 20);
+
+    const double kernel = time_per_call([&]() {
+        for (size_t i = 0; i < count; ++i) {
+            c[i] = a[i] * b[i];
+        }
+        do_not_optimise(c);
+    }, 20);
+
+    report_timing("triple loop" + suffix, naive);
+    report_timing("operator*" + suffix, kernel);
+    report_speedup("operator* speedup" + suffix, naive, kernel);
+}
+
+// One big product, e.g. 3N x 3N mobility blocks.
+template <size_t N>
+void bench_large(const size_t repeats) {
+    std::mt19937 engine(42);
+    std::uniform_real_distribution<double> element(-1, 1);
+
+    const auto a = std::make_unique<Tensor<double, N, N>>();
+    const auto b = std::make_unique<Tensor<double, N, N>>();
+    const auto c = std::make_unique<Tensor<double, N, N>>();
+
+    for (size_t i = 0; i < N * N; ++i) {
+        a->data[i] = element(engine);
+        b->data[i] = element(engine);
+    }
+
+    const std::string suffix = " (" + std::to_string(N) + "x" + std::to_string(N) + ")";
+
+    const double naive = time_per_call([&]() {
+        *c = triple_loop_product(*a, *b);
+        do_not_optimise(*c);
+    }, repeats);
+
+    const double kernel = time_per_call([&]() {
+        *c = *a * *b;
+        do_not_optimise(*c);
+    }, repeats);
+
+    report_timing("triple loop" + suffix, naive);
+    report_timing("operator*" + suffix, kernel);
+    report_speedup("operator* speedup" + suffix, naive, kernel);
+}
+
+// Inverting a mobility block per pair: closed form against generic LU.
+void bench_inverse_3x3(const size_t count) {
+    std::mt19937 engine(42);
+    const auto tensors = random_tensors<3>(count, engine);
+    std::vector<Tensor<double, 3, 3>> inverses(count);
+
+    const std::string suffix = " (" + std::to_string(count) + " tensors)";
+
+    const double lu = time_per_call([&]() {
+        for (size_t i = 0; i < count; ++i) {
+            inverses[i] = lu_decompose(tensors[i]).inverse();
+        }
+        do_not_optimise(inverses);
+    }, 20);
+
+    const double closed_form = time_per_call([&]() {
+        inverse_batch(tensors.data(), inverses.data(), count);
+        do_not_optimise(inverses);
+    }, 20);
+
+    report_timing("3x3 inverse, LU" + suffix, lu);
+    report_timing("3x3 inverse_batch, closed form" + suffix, closed_form);
+    report_speedup("closed form vs LU" + suffix, lu, closed_form);
+}
+
+// Streaming through stored per-pair 3x3 mobilities, applying each to a
+// force. Memory bound, so the packed storage should show up directly.
+void bench_symmetric_storage(const size_t pairs) {
+    std::mt19937 engine(42);
+    std::uniform_real_distribution<double> element(-1, 1);
+
+    std::vector<Tensor<double, 3, 3>> dense(pairs);
+    std::vector<SymmetricTensor<double, 3>> packed(pairs);
+    std::vector<MathArray<double, 3>> forces(pairs);
+
+    for (size_t p = 0; p < pairs; ++p) {
+        for (size_t i = 0; i < 3; ++i) {
+            for (size_t j = i; j < 3; ++j) {
+                dense[p][{i, j}] = dense[p][{j, i}] = element(engine);
+            }
+            forces[p][i] = element(engine);
+        }
+        packed[p] = SymmetricTensor<double, 3>::from_tensor(dense[p]);
+    }
+
+    const std::string suffix = " (" + std::to_string(pairs) + " pairs)";
+    MathArray<double, 3> total{};
+
+    const double full = time_per_call([&]() {
+        total = MathArray<double, 3>{};
+        for (size_t p = 0; p < pairs; ++p) {
+            total += dense[p] * forces[p];
+        }
+        do_not_optimise(total);
+    }, 10);
+
+    const double symmetric = time_per_call([&]() {
+        total = MathArray<double, 3>{};
+        for (size_t p = 0; p < pairs; ++p) {
+            total += packed[p] * forces[p];
+        }
+        do_not_optimise(total);
+    }, 10);
+
+    report_timing("sum of M f, Tensor" + suffix, full);
+    report_timing("sum of M f, SymmetricTensor" + suffix, symmetric);
+    report_speedup("SymmetricTensor vs Tensor" + suffix, full, symmetric);
+}
+
+int main() {
+    bench_small<3>(100'000);
+    bench_small<4>(100'000);
+    bench_large<12>(10'000);
+    bench_large<24>(10'000);
+    bench_large<48>(1'000);
+    bench_large<96>(100);
+    bench_large<300>(5);
+    bench_inverse_3x3(100'000);
+    bench_symmetric_storage(1'000'000);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <string>
+
+namespace dav {
+    /**
+      * Stops the optimiser from throwing away a result we only computed to time
+      * it. Works by pretending to read the value from inline assembly.
+      */
+    template <class T>
+    inline void do_not_optimise(const T& value) {
+        asm volatile("" : : "g"(&value) : "memory");
+    }
+
+    /**
+      * Average wall-clock time in seconds of one call to f, over the given
+      * number of repeats. f is called once beforehand to warm the cache up.
+      */
+    template <class F>
+    inline double time_per_call(F&& f, const size_t repeats) {
+        f();
+
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < repeats; ++i) {
+            f();
+        }
+        const auto end = std::chrono::steady_clock::now();
+
+        return std::chrono::duration<double>(end - start).count() / repeats;
+    }
+
+    inline void report_timing(const std::string& name, const double seconds) {
+        std::cout << std::left << std::setw(48) << name << std::right << std::setw(14) << std::scientific << std::setprecision(3) << seconds << " s" << std::endl;
+    }
+
+    inline void report_speedup(const std::string& name, const double baseline_seconds, const double seconds) {
+        std::cout << std::left << std::setw(48) << name << std::right << std::setw(14) << std::fixed << std::setprecision(2) << baseline_seconds / seconds << " x" << std::endl;
+    }
+}
@@ -3,7 +3,10 @@
 #include "arrayutils.hpp"
 #include "randomutils.hpp"
 
+#include <algorithm>
+#include <cmath>
 #include <random>
+#include <vector>
 
 namespace dav {
     template <class T, size_t N>
@@ -34,19 +37,23 @@ namespace dav {
     public:
         BoundingBox(const double x_min, const double x_max, const double y_min, const double y_max, const double z_min, const double z_max)
         : lower_bounds{x_min, y_min, z_min}
-        , upper_bounds{x_max, y_max, z_max} {}
+        , upper_bounds{x_max, y_max, z_max}
+        , surface_sampler(this->build_surface_sampler()) {}
 
         BoundingBox(const double x_dim, const double y_dim, const double z_dim)
         : lower_bounds{-x_dim / 2.0, -y_dim / 2.0, -z_dim / 2.0}
-        , upper_bounds{+x_dim / 2.0, +y_dim / 2.0, +z_dim / 2.0} {}
+        , upper_bounds{+x_dim / 2.0, +y_dim / 2.0, +z_dim / 2.0}
+        , surface_sampler(this->build_surface_sampler()) {}
 
         BoundingBox(const MathArray<double, 3>& corner_1, const MathArray<double, 3>& corner_2)
         : lower_bounds(elementwise_min(corner_1, corner_2))
-        , upper_bounds(elementwise_max(corner_1, corner_2)) {}
+        , upper_bounds(elementwise_max(corner_1, corner_2))
+        , surface_sampler(this->build_surface_sampler()) {}
 
         BoundingBox(const BoundingBox& other)
         : lower_bounds(other.get_lower_bounds())
-        , upper_bounds(other.get_upper_bounds()) {}
+        , upper_bounds(other.get_upper_bounds())
+        , surface_sampler(other.surface_sampler) {}
 
         template <class T>
         inline bool in_bounds(const MathArray<T, 3>& position) const {
@@ -94,7 +101,8 @@ namespace dav {
             return arr;
         }
 
-        inline MathArray<double, 3> random_point_in_bounds(std::mt19937& engine) const {
+        template <class Engine>
+        inline MathArray<double, 3> random_point_in_bounds(Engine& engine) const {
             MathArray<double, 3> output{};
 
             for (size_t i = 0; i < 3; ++i) {
@@ -121,16 +129,16 @@ namespace dav {
           * see most of the points picked on the long faces and very few on the
           * small end faces.
           */
-        inline MathArray<double, 3> random_point_on_surface(std::mt19937& engine) const {
-            // Surface areas...
-            const std::vector<double> surface_areas{
-                this->get_xsurface(), this->get_xsurface(), // surfaces with x normal
-                this->get_ysurface(), this->get_ysurface(), // surfaces with y normal
-                this->get_zsurface(), this->get_zsurface()  // surfaces with z normal
-            };
-            const size_t surface_index = weighted_index(surface_areas, engine);
-            const bool basis_index = surface_index / 2; // x=0, y=1, z=2.
-            const bool upper = (surface_index % 3) == 1; // 0 if lower, 1 if upper.
+        template <class Engine>
+        inline MathArray<double, 3> random_point_on_surface(Engine& engine) const {
+            // A box with no surface area is all surface.
+            if (this->surface_sampler.empty()) {
+                return this->random_point_in_bounds(engine);
+            }
+
+            const size_t surface_index = this->surface_sampler(engine);
+            const size_t basis_index = surface_index / 2; // x=0, y=1, z=2.
+            const bool upper = (surface_index % 2) == 1; // 0 if lower, 1 if upper.
 
             // Find a random point P in the box, then project it onto the chosen
             // surface. This means setting P[basis_index] to be on the appropriate
@@ -159,6 +167,24 @@ namespace dav {
         const MathArray<double, 3> lower_bounds;
         const MathArray<double, 3> upper_bounds;
 
+        // Picks one of the six faces weighted by area, in the order lower x,
+        // upper x, lower y, upper y, lower z, upper z.
+        const AliasSampler<double> surface_sampler;
+
+        AliasSampler<double> build_surface_sampler() const {
+            const MathArray<double, 6> surface_areas{
+                std::abs(this->get_xsurface()), std::abs(this->get_xsurface()), // surfaces with x normal
+                std::abs(this->get_ysurface()), std::abs(this->get_ysurface()), // surfaces with y normal
+                std::abs(this->get_zsurface()), std::abs(this->get_zsurface())  // surfaces with z normal
+            };
+
+            if (!(surface_areas.sum() > 0)) {
+                return AliasSampler<double>();
+            }
+
+            return AliasSampler<double>(surface_areas);
+        }
+
         template <class T>
         T reflect_through(const T& coordinate, const double bound) const {
             return 2 * bound - coordinate;
@@ -176,4 +202,122 @@ namespace dav {
         }
 
     };
+
+
+    /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+     * BOUNDARY POLICIES * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+     * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+    // Each policy says what happens to a coordinate that has left [lower, upper]
+    // along one axis, and how to measure the separation of two particles along
+    // that axis. Neither has any branches, so applying them over a whole array
+    // of particles vectorises.
+
+    /**
+      * Hard wall: a coordinate that has gone past a bound is reflected back
+      * through it, same as BoundingBox::reflect. Assumes it hasn't gone so far
+      * that it comes out through the other side.
+      */
+    struct Reflecting {
+        static double apply(const double coordinate, const double lower, const double upper) noexcept {
+            return std::min(std::max(coordinate, 2 * lower - coordinate), 2 * upper - coordinate);
+        }
+
+        static double displacement(const double separation, const double) noexcept {
+            return separation;
+        }
+    };
+
+    /**
+      * Periodic: a coordinate that has left through one side comes back in
+      * through the other, however many box lengths away it was. Separations
+      * are minimum-image.
+      */
+    struct Periodic {
+        static double apply(const double coordinate, const double lower, const double upper) noexcept {
+            const double length = upper - lower;
+
+            return coordinate - length * std::floor((coordinate - lower) / length);
+        }
+
+        static double displacement(const double separation, const double length) noexcept {
+            return separation - length * std::nearbyint(separation / length);
+        }
+    };
+
+    /**
+      * Boundary conditions for a BoundingBox, picked per axis at compile time,
+      * e.g. BoundaryConditions<Periodic, Periodic, Reflecting> for a wall at
+      * the bottom of a box that is periodic in x and y.
+      */
+    template <class X, class Y, class Z>
+    struct BoundaryConditions {
+        template <class T>
+        static MathArray<T, 3>& apply_situ(const BoundingBox& box, MathArray<T, 3>& position) noexcept {
+            position[0] = X::apply(position[0], box.get_xmin(), box.get_xmax());
+            position[1] = Y::apply(position[1], box.get_ymin(), box.get_ymax());
+            position[2] = Z::apply(position[2], box.get_zmin(), box.get_zmax());
+
+            return position;
+        }
+
+        template <class T>
+        static MathArray<T, 3> apply(const BoundingBox& box, const MathArray<T, 3>& position) noexcept {
+            MathArray<T, 3> output(position);
+
+            return apply_situ(box, output);
+        }
+
+        /**
+          * Apply the boundary conditions to n particles stored as
+          * structure-of-arrays, one tight loop per axis.
+          */
+        static void apply(const BoundingBox& box, double* x, double* y, double* z, const size_t n) noexcept {
+            apply_axis<X>(x, n, box.get_xmin(), box.get_xmax());
+            apply_axis<Y>(y, n, box.get_ymin(), box.get_ymax());
+            apply_axis<Z>(z, n, box.get_zmin(), box.get_zmax());
+        }
+
+        static void apply(const BoundingBox& box, std::vector<MathArray<double, 3>>& positions) noexcept {
+            for (MathArray<double, 3>& position : positions) {
+                apply_situ(box, position);
+            }
+        }
+
+        /**
+          * Separation a - b, using the minimum image along periodic axes.
+          */
+        template <class T>
+        static MathArray<T, 3> displacement(const BoundingBox& box, const MathArray<T, 3>& a, const MathArray<T, 3>& b) noexcept {
+            return MathArray<T, 3>{
+                X::displacement(a[0] - b[0], box.get_xsize()),
+                Y::displacement(a[1] - b[1], box.get_ysize()),
+                Z::displacement(a[2] - b[2], box.get_zsize())
+            };
+        }
+
+        template <class T>
+        static double distance_between_sq(const BoundingBox& box, const MathArray<T, 3>& a, const MathArray<T, 3>& b) noexcept {
+            return magnitude_sq(displacement(box, a, b));
+        }
+
+        template <class T>
+        static double distance_between(const BoundingBox& box, const MathArray<T, 3>& a, const MathArray<T, 3>& b) noexcept {
+            return magnitude(displacement(box, a, b));
+        }
+
+    private:
+        template <class Policy>
+        static void apply_axis(double* coordinates, const size_t n, const double lower, const double upper) noexcept {
+            for (size_t i = 0; i < n; ++i) {
+                coordinates[i] = Policy::apply(coordinates[i], lower, upper);
+            }
+        }
+    };
+
+    using ReflectingBoundaries = BoundaryConditions<Reflecting, Reflecting, Reflecting>;
+    using PeriodicBoundaries = BoundaryConditions<Periodic, Periodic, Periodic>;
+
+    // Periodic in x and y with a no-slip wall in the z = const planes, which is
+    // the geometry blake_tensor_at is for.
+    using BlakeBoundaries = BoundaryConditions<Periodic, Periodic, Reflecting>;
 }
@@ -0,0 +1,417 @@
+#pragma once
+
+#include "arrayutils.hpp"
+#include "boundingbox.hpp"
+#include "particleset.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace dav {
+    /**
+      * Linked-cell neighbour finder. The bounding box is chopped into cells at
+      * least as big as the cutoff in every direction, so any two particles
+      * closer than the cutoff are in the same or adjacent cells and only those
+      * need to be checked, which makes finding all close pairs O(N).
+      *
+      * Each cell keeps a doubly-linked list of the particles in it. That lets
+      * update() move only the particles that have changed cell since the last
+      * call, which after a small timestep is very few of them.
+      *
+      * Particles outside the box are put in the nearest edge cell, so they are
+      * never lost, but pairs separated by more than a cell across the edge
+      * won't be found. No periodic images are considered.
+      */
+    class CellList {
+
+    public:
+        static constexpr size_t none = std::numeric_limits<size_t>::max();
+
+        CellList(const BoundingBox& box, const double cutoff)
+        : lower_bounds(box.get_lower_bounds())
+        , cutoff(cutoff) {
+
+            if (!(cutoff > 0)) {
+                throw std::invalid_argument("Cell list cutoff must be positive");
+            }
+
+            for (size_t i = 0; i < 3; ++i) {
+                const double size = box.get_ith_size(i);
+
+                this->cells_per_axis[i] = std::max<size_t>(1, size_t(size / cutoff));
+                this->inverse_cell_size[i] = this->cells_per_axis[i] / size;
+            }
+
+            this->heads.assign(this->cells_per_axis.prod(), none);
+            this->build_stencil();
+        }
+
+        /**
+          * Bin n particles from scratch, throwing away whatever was there.
+          */
+        void build(const double* x, const double* y, const double* z, const size_t n) {
+            std::fill(this->heads.begin(), this->heads.end(), none);
+            this->next.assign(n, none);
+            this->previous.assign(n, none);
+            this->particle_cells.resize(n);
+
+            // Insert backwards so that each cell's list ends up in index order.
+            for (size_t i = n; i-- > 0;) {
+                const size_t cell = this->cell_index(x[i], y[i], z[i]);
+                this->particle_cells[i] = cell;
+                this->link(i, cell);
+            }
+        }
+
+        /**
+          * Move particles that have changed cell since the last build or update.
+          * If the number of particles has changed this falls back to a full
+          * build. Returns the number of particles that moved cell.
+          */
+        size_t update(const double* x, const double* y, const double* z, const size_t n) {
+            if (n != this->size()) {
+                this->build(x, y, z, n);
+                return n;
+            }
+
+            size_t moved = 0;
+
+            for (size_t i = 0; i < n; ++i) {
+                const size_t cell = this->cell_index(x[i], y[i], z[i]);
+
+                if (cell != this->particle_cells[i]) {
+                    this->unlink(i, this->particle_cells[i]);
+                    this->link(i, cell);
+                    this->particle_cells[i] = cell;
+                    ++moved;
+                }
+            }
+
+            return moved;
+        }
+
+        void build(const VectorField& positions) {
+            this->build(positions.x().data(), positions.y().data(), positions.z().data(), positions.size());
+        }
+
+        size_t update(const VectorField& positions) {
+            return this->update(positions.x().data(), positions.y().data(), positions.z().data(), positions.size());
+        }
+
+        void build(const std::vector<MathArray<double, 3>>& positions) {
+            this->build(VectorField(positions));
+        }
+
+        size_t update(const std::vector<MathArray<double, 3>>& positions) {
+            return this->update(VectorField(positions));
+        }
+
+        size_t size() const noexcept {
+            return this->particle_cells.size();
+        }
+
+        size_t cell_count() const noexcept {
+            return this->heads.size();
+        }
+
+        const MathArray<size_t, 3>& get_cells_per_axis() const noexcept {
+            return this->cells_per_axis;
+        }
+
+        double get_cutoff() const noexcept {
+            return this->cutoff;
+        }
+
+        size_t cell_of(const size_t particle) const noexcept {
+            return this->particle_cells[particle];
+        }
+
+        /**
+          * Calls f(i, j) once for every pair of particles in the same or
+          * adjacent cells. These are candidates only: some will be further
+          * apart than the cutoff.
+          */
+        template <class F>
+        void for_each_pair(F&& f) const {
+            for (size_t cell = 0; cell < this->cell_count(); ++cell) {
+                if (this->heads[cell] == none) {
+                    continue;
+                }
+
+                for (size_t i = this->heads[cell]; i != none; i = this->next[i]) {
+                    for (size_t j = this->next[i]; j != none; j = this->next[j]) {
+                        f(i, j);
+                    }
+                }
+
+                for (size_t s = 0; s < stencil_size; ++s) {
+                    const size_t neighbour = this->neighbour_cell(cell, s);
+                    if (neighbour == none) {
+                        continue;
+                    }
+
+                    for (size_t i = this->heads[cell]; i != none; i = this->next[i]) {
+                        for (size_t j = this->heads[neighbour]; j != none; j = this->next[j]) {
+                            f(i, j);
+                        }
+                    }
+                }
+            }
+        }
+
+        /**
+          * Calls f(i, j, r_sq) for every pair of particles closer than the
+          * cutoff, where r_sq is their squared separation. The positions must
+          * be the ones the list was last built or updated with.
+          */
+        template <class F>
+        void for_each_neighbour_pair(const double* x, const double* y, const double* z, F&& f) const {
+            const double cutoff_sq = this->cutoff * this->cutoff;
+
+            this->for_each_pair([&](const size_t i, const size_t j) {
+                const double dx = x[i] - x[j];
+                const double dy = y[i] - y[j];
+                const double dz = z[i] - z[j];
+                const double r_sq = dx * dx + dy * dy + dz * dz;
+
+                if (r_sq < cutoff_sq) {
+                    f(i, j, r_sq);
+                }
+            });
+        }
+
+        template <class F>
+        void for_each_neighbour_pair(const VectorField& positions, F&& f) const {
+            this->for_each_neighbour_pair(positions.x().data(), positions.y().data(), positions.z().data(), std::forward<F>(f));
+        }
+
+        /**
+          * Forward iterator over the same candidate pairs as for_each_pair, in
+          * the same order, for when a callback doesn't fit. Invalidated by
+          * build() and update().
+          */
+        class PairIterator {
+
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = std::pair<size_t, size_t>;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const value_type*;
+            using reference = value_type;
+
+            PairIterator(const CellList* list, const size_t cell)
+            : list(list)
+            , cell(cell) {
+                this->settle();
+            }
+
+            value_type operator*() const noexcept {
+                return value_type(this->i, this->j);
+            }
+
+            PairIterator& operator++() noexcept {
+                this->j = this->list->next[this->j];
+                this->settle();
+
+                return *this;
+            }
+
+            PairIterator operator++(int) noexcept {
+                PairIterator output(*this);
+                ++(*this);
+
+                return output;
+            }
+
+            bool operator==(const PairIterator& other) const noexcept {
+                return this->cell == other.cell && this->stencil == other.stencil && this->i == other.i && this->j == other.j;
+            }
+
+            bool operator!=(const PairIterator& other) const noexcept {
+                return !(*this == other);
+            }
+
+        private:
+            const CellList* list;
+            size_t cell;
+            size_t stencil = 0; // 0 is the cell itself, s + 1 is stencil entry s.
+            size_t i = none;
+            size_t j = none;
+
+            size_t first_partner() const noexcept {
+                if (this->stencil == 0) {
+                    return this->list->next[this->i];
+                }
+
+                return this->list->heads[this->list->neighbour_cell(this->cell, this->stencil - 1)];
+            }
+
+            // Walk forward until (i, j) is a real pair, or we run off the end.
+            void settle() noexcept {
+                while (this->cell < this->list->cell_count()) {
+                    if (this->i == none) {
+                        this->i = this->list->heads[this->cell];
+
+                        if (this->i == none) {
+                            this->next_cell();
+                            continue;
+                        }
+
+                        this->j = this->first_partner();
+                    }
+
+                    if (this->j != none) {
+                        return;
+                    }
+
+                    this->i = this->list->next[this->i];
+                    if (this->i != none) {
+                        this->j = this->first_partner();
+                        continue;
+                    }
+
+                    // Done with this neighbour, find the next one that exists.
+                    do {
+                        ++this->stencil;
+                    } while (this->stencil <= stencil_size && this->list->neighbour_cell(this->cell, this->stencil - 1) == none);
+
+                    if (this->stencil > stencil_size) {
+                        this->next_cell();
+                    }
+                }
+
+                this->stencil = 0;
+                this->i = none;
+                this->j = none;
+            }
+
+            void next_cell() noexcept {
+                ++this->cell;
+                this->stencil = 0;
+                this->i = none;
+                this->j = none;
+            }
+        };
+
+        class PairRange {
+
+        public:
+            explicit PairRange(const CellList* list)
+            : list(list) {}
+
+            PairIterator begin() const {
+                return PairIterator(this->list, 0);
+            }
+
+            PairIterator end() const {
+                return PairIterator(this->list, this->list->cell_count());
+            }
+
+        private:
+            const CellList* list;
+        };
+
+        PairRange pairs() const {
+            return PairRange(this);
+        }
+
+    private:
+        // Half of the 26 neighbouring cells, so each pair of cells is visited
+        // from one side only.
+        static constexpr size_t stencil_size = 13;
+
+        const MathArray<double, 3> lower_bounds;
+        const double cutoff;
+        MathArray<size_t, 3> cells_per_axis;
+        MathArray<double, 3> inverse_cell_size;
+        MathArray<int, 3> stencil[stencil_size];
+
+        std::vector<size_t> heads;
+        std::vector<size_t> next;
+        std::vector<size_t> previous;
+        std::vector<size_t> particle_cells;
+
+        void build_stencil() noexcept {
+            size_t s = 0;
+
+            for (int dz = -1; dz <= 1; ++dz) {
+                for (int dy = -1; dy <= 1; ++dy) {
+                    for (int dx = -1; dx <= 1; ++dx) {
+                        const bool forward = dz > 0 || (dz == 0 && dy > 0) || (dz == 0 && dy == 0 && dx > 0);
+
+                        if (forward) {
+                            this->stencil[s++] = MathArray<int, 3>{dx, dy, dz};
+                        }
+                    }
+                }
+            }
+        }
+
+        size_t axis_index(const double coordinate, const size_t axis) const noexcept {
+            const double scaled = (coordinate - this->lower_bounds[axis]) * this->inverse_cell_size[axis];
+
+            if (!(scaled > 0)) {
+                return 0;
+            }
+
+            return std::min(size_t(scaled), this->cells_per_axis[axis] - 1);
+        }
+
+        size_t cell_index(const double x, const double y, const double z) const noexcept {
+            const size_t ix = this->axis_index(x, 0);
+            const size_t iy = this->axis_index(y, 1);
+            const size_t iz = this->axis_index(z, 2);
+
+            return (iz * this->cells_per_axis[1] + iy) * this->cells_per_axis[0] + ix;
+        }
+
+        size_t neighbour_cell(const size_t cell, const size_t s) const noexcept {
+            const size_t nx = this->cells_per_axis[0];
+            const size_t ny = this->cells_per_axis[1];
+
+            const long ix = long(cell % nx) + this->stencil[s][0];
+            const long iy = long((cell / nx) % ny) + this->stencil[s][1];
+            const long iz = long(cell / (nx * ny)) + this->stencil[s][2];
+
+            if (ix < 0 || iy < 0 || iz < 0 || ix >= long(nx) || iy >= long(ny) || iz >= long(this->cells_per_axis[2])) {
+                return none;
+            }
+
+            return (size_t(iz) * ny + size_t(iy)) * nx + size_t(ix);
+        }
+
+        void link(const size_t particle, const size_t cell) noexcept {
+            const size_t old_head = this->heads[cell];
+
+            this->next[particle] = old_head;
+            this->previous[particle] = none;
+
+            if (old_head != none) {
+                this->previous[old_head] = particle;
+            }
+
+            this->heads[cell] = particle;
+        }
+
+        void unlink(const size_t particle, const size_t cell) noexcept {
+            const size_t before = this->previous[particle];
+            const size_t after = this->next[particle];
+
+            if (before != none) {
+                this->next[before] = after;
+            } else {
+                this->heads[cell] = after;
+            }
+
+            if (after != none) {
+                this->previous[after] = before;
+            }
+        }
+    };
+}
@@ -1,39 +1,85 @@
 #pragma once
 
+#include "mathutils.hpp"
+
+#include <cctype>
+#include <cstddef>
+#include <limits>
 #include <string>
+#include <string_view>
 #include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 #include <sys/stat.h>
 #include <SimpleIni.h>
 #include <sstream>
 
+/**
+  * Read-only view of an ini file. Every value is read and parsed once when
+  * the file is loaded and kept in a flat list, with a hash index on the
+  * section and key, so a lookup is one hash and no parsing or allocation.
+  * Sections and keys are case-insensitive, as they are in SimpleIni.
+  *
+  * For values read in a hot loop, resolve a Handle once up front and read
+  * that instead; it holds the already-converted value.
+  */
 class Config {
 
 public:
     template <class T>
-    T get(const std::string& section, const std::string& key) const {
-        const char* c_string_value = this->ini.GetValue(section.c_str(), key.c_str(), NULL);
+    class Handle {
 
-        if (c_string_value == NULL) {
-            std::stringstream error_ss;
-            error_ss << "No such key: '" << section << "/" << key << "'";
-            throw std::invalid_argument(error_ss.str());
+    public:
+        const T& get() const noexcept {
+            return this->value;
         }
 
-        const std::string string_value(c_string_value);
-        const T value = this->convert_numeric<T>(string_value);
+        const T& operator*() const noexcept {
+            return this->value;
+        }
+
+        operator const T&() const noexcept {
+            return this->value;
+        }
+
+    private:
+        friend class Config;
+
+        explicit Handle(const T& value)
+        : value(value) {}
+
+        T value;
+    };
+
+    template <class T>
+    T get(const std::string_view section, const std::string_view key) const {
+        return this->find(section, key).template as<T>();
+    }
+
+    /**
+      * Look up and convert a value once, so that it can be read later for
+      * the cost of a load. Throws the same errors as get.
+      */
+    template <class T>
+    Handle<T> handle(const std::string_view section, const std::string_view key) const {
+        return Handle<T>(this->get<T>(section, key));
+    }
 
-        return value;
+    bool has(const std::string_view section, const std::string_view key) const {
+        return this->index.find(Name{section, key}) != this->index.end();
     }
 
-    int get_int(const std::string& section, const std::string& key) const {
+    int get_int(const std::string_view section, const std::string_view key) const {
         return this->get<int>(section, key);
     }
 
-    double get_double(const std::string& section, const std::string& key) const {
+    double get_double(const std::string_view section, const std::string_view key) const {
         return this->get<double>(section, key);
     }
 
-    std::string get_string(const std::string& section, const std::string& key) const {
+    std::string get_string(const std::string_view section, const std::string_view key) const {
         return this->get<std::string>(section, key);
     }
 
@@ -47,31 +93,185 @@ public:
            throw std::runtime_error("Invalid config file supplied");
        }
 
+       CSimpleIniA ini;
        ini.SetUnicode();
        ini.LoadFile(file_path.c_str());
+
+       this->load(ini);
+    }
+
+    // The index holds views into the entries, so a copy needs its own.
+    Config(const Config& other)
+    : file_path(other.file_path)
+    , entries(other.entries) {
+        this->build_index();
     }
 
+    Config& operator=(const Config&) = delete;
+
 private:
+    struct Entry {
+        std::string section;
+        std::string key;
+        std::string text;
+
+        bool is_integer = false;
+        bool is_real = false;
+        long integer = 0;
+        double real = 0;
+
+        template <class T>
+        T as() const {
+            if constexpr (std::is_same<T, std::string>::value) {
+                return this->text;
+            } else if constexpr (std::is_integral<T>::value && !std::is_same<T, bool>::value) {
+                if (this->is_integer && fits<T>(this->integer)) {
+                    return static_cast<T>(this->integer);
+                }
+
+                // Reports the right error, or handles values too big for a long.
+                return dav::convert<T>(this->text);
+            } else if constexpr (std::is_floating_point<T>::value) {
+                if (this->is_real) {
+                    return static_cast<T>(this->real);
+                }
+
+                return dav::convert<T>(this->text);
+            } else {
+                T value;
+
+                std::stringstream ss;
+                ss << this->text;
+                ss >> value;
+
+                if (ss.fail()) {
+                    throw std::runtime_error("Could not convert string to desired numeric");
+                }
+
+                return value;
+            }
+        }
+
+        template <class T>
+        static bool fits(const long value) noexcept {
+            if constexpr (std::is_signed<T>::value) {
+                return value >= long(std::numeric_limits<T>::min()) && value <= long(std::numeric_limits<T>::max());
+            } else {
+                return value >= 0 && static_cast<unsigned long>(value) <= std::numeric_limits<T>::max();
+            }
+        }
+    };
+
+    // A section and key to look up, viewing either the caller's strings or
+    // an entry's. Hashing and comparing fold ASCII case.
+    struct Name {
+        std::string_view section;
+        std::string_view key;
+    };
+
+    struct NameHash {
+        size_t operator()(const Name& name) const noexcept {
+            // FNV-1a over both parts, with a separator that neither can contain.
+            size_t hash = 14695981039346656037ull;
+
+            const auto add = [&hash](const unsigned char c) {
+                hash = (hash ^ c) * 1099511628211ull;
+            };
+
+            for (const char c : name.section) {
+                add(fold(c));
+            }
+
+            add('\0');
+
+            for (const char c : name.key) {
+                add(fold(c));
+            }
+
+            return hash;
+        }
+    };
+
+    struct NameEqual {
+        bool operator()(const Name& a, const Name& b) const noexcept {
+            return same(a.section, b.section) && same(a.key, b.key);
+        }
+
+        static bool same(const std::string_view a, const std::string_view b) noexcept {
+            if (a.size() != b.size()) {
+                return false;
+            }
+
+            for (size_t i = 0; i < a.size(); ++i) {
+                if (fold(a[i]) != fold(b[i])) {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+    };
+
     const std::string file_path;
-    CSimpleIniA ini;
+    std::vector<Entry> entries;
+    std::unordered_map<Name, size_t, NameHash, NameEqual> index;
 
     inline bool file_exists(const std::string& file_path) const {
         struct stat buffer;
         return (stat (file_path.c_str(), &buffer) == 0);
     }
 
-    template <class T>
-    inline T convert_numeric(const std::string& string_value) const {
-        T value;
+    static unsigned char fold(const char c) noexcept {
+        return static_cast<unsigned char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+
+    void load(const CSimpleIniA& ini) {
+        CSimpleIniA::TNamesDepend sections;
+        ini.GetAllSections(sections);
+
+        for (const CSimpleIniA::Entry& section : sections) {
+            CSimpleIniA::TNamesDepend keys;
+            ini.GetAllKeys(section.pItem, keys);
+
+            for (const CSimpleIniA::Entry& key : keys) {
+                const char* value = ini.GetValue(section.pItem, key.pItem, NULL);
+                if (value == NULL) {
+                    continue;
+                }
 
-        std::stringstream ss;
-        ss << string_value;
-        ss >> value;
+                Entry entry;
+                entry.section = section.pItem;
+                entry.key = key.pItem;
+                entry.text = value;
+                entry.is_integer = dav::try_convert(entry.text, entry.integer) == std::errc();
+                entry.is_real = dav::try_convert(entry.text, entry.real) == std::errc();
+
+                this->entries.push_back(std::move(entry));
+            }
+        }
+
+        this->build_index();
+    }
 
-        if (ss.fail()) {
-            throw std::runtime_error("Could not convert string to desired numeric");
+    // Only called once the entries are final, since the keys are views into them.
+    void build_index() {
+        this->index.clear();
+        this->index.reserve(this->entries.size());
+
+        for (size_t i = 0; i < this->entries.size(); ++i) {
+            this->index.emplace(Name{this->entries[i].section, this->entries[i].key}, i);
+        }
+    }
+
+    const Entry& find(const std::string_view section, const std::string_view key) const {
+        const auto found = this->index.find(Name{section, key});
+
+        if (found == this->index.end()) {
+            std::stringstream error_ss;
+            error_ss << "No such key: '" << section << "/" << key << "'";
+            throw std::invalid_argument(error_ss.str());
         }
 
-        return value;
+        return this->entries[found->second];
     }
 };
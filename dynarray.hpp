@@ -0,0 +1,758 @@
+#pragma once
+
+#include "arrayutils.hpp"
+#include "tensorutils.hpp"
+#include "memoryutils.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <initializer_list>
+#include <iostream>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+namespace dav {
+    /**
+      * Runtime-sized companion to MathArray, for anything with one entry per
+      * particle (or three, or 3N x 3N). The storage is a cache-line aligned
+      * heap buffer, and the arithmetic and reductions mirror MathArray's so
+      * code written against one reads the same against the other. Mixing
+      * the two works too: a DynArray and a MathArray of the same length
+      * combine elementwise into a DynArray.
+      *
+      * Unlike MathArray the sizes are only known at runtime, so operations
+      * on arrays of different lengths throw std::invalid_argument.
+      */
+    template <class T>
+    class DynArray {
+
+    public:
+        using storage_type = std::vector<T, AlignedAllocator<T>>;
+
+        DynArray() = default;
+
+        explicit DynArray(const size_t n, const T& value = T{})
+        : values(n, value) {}
+
+        DynArray(std::initializer_list<T> values)
+        : values(values) {}
+
+        template <size_t N>
+        explicit DynArray(const MathArray<T, N>& array)
+        : values(array.begin(), array.end()) {}
+
+        T& operator[](const size_t i) noexcept {
+            return this->values[i];
+        }
+
+        const T& operator[](const size_t i) const noexcept {
+            return this->values[i];
+        }
+
+        T& at(const size_t i) {
+            if (i >= this->size()) {
+                throw std::range_error("index out of range");
+            }
+
+            return this->values[i];
+        }
+
+        const T& at(const size_t i) const {
+            if (i >= this->size()) {
+                throw std::range_error("index out of range");
+            }
+
+            return this->values[i];
+        }
+
+        T* data() noexcept {
+            return this->values.data();
+        }
+
+        const T* data() const noexcept {
+            return this->values.data();
+        }
+
+        T* begin() noexcept {
+            return this->values.data();
+        }
+
+        T* end() noexcept {
+            return this->values.data() + this->values.size();
+        }
+
+        const T* begin() const noexcept {
+            return this->values.data();
+        }
+
+        const T* end() const noexcept {
+            return this->values.data() + this->values.size();
+        }
+
+        T& front() noexcept {
+            return this->values.front();
+        }
+
+        T& back() noexcept {
+            return this->values.back();
+        }
+
+        const T& front() const noexcept {
+            return this->values.front();
+        }
+
+        const T& back() const noexcept {
+            return this->values.back();
+        }
+
+        size_t size() const noexcept {
+            return this->values.size();
+        }
+
+        bool empty() const noexcept {
+            return this->values.empty();
+        }
+
+        void resize(const size_t n, const T& value = T{}) {
+            this->values.resize(n, value);
+        }
+
+        Span<T> span() noexcept {
+            return Span<T>(this->data(), this->size());
+        }
+
+        Span<const T> span() const noexcept {
+            return Span<const T>(this->data(), this->size());
+        }
+
+        /**
+          * Copy into a MathArray, e.g. to pull one particle's 3 components
+          * out starting from offset. Throws if there aren't N values there.
+          */
+        template <size_t N>
+        MathArray<T, N> to_fixed(const size_t offset = 0) const {
+            if (offset > this->size() || this->size() - offset < N) {
+                throw std::invalid_argument("DynArray is too short for that MathArray");
+            }
+
+            MathArray<T, N> output{};
+            std::copy(this->begin() + offset, this->begin() + offset + N, output.begin());
+
+            return output;
+        }
+
+        template <size_t N>
+        void set_fixed(const size_t offset, const MathArray<T, N>& array) {
+            if (offset > this->size() || this->size() - offset < N) {
+                throw std::invalid_argument("DynArray is too short for that MathArray");
+            }
+
+            std::copy(array.begin(), array.end(), this->begin() + offset);
+        }
+
+        T sum() const noexcept {
+            T output = 0;
+            for (const T& t : *this) {
+                output += t;
+            }
+
+            return output;
+        }
+
+        DynArray<T> cumsum() const {
+            DynArray<T> output(this->size());
+
+            T running_total = 0;
+            for (size_t i = 0; i < this->size(); ++i) {
+                running_total += (*this)[i];
+                output[i] = running_total;
+            }
+
+            return output;
+        }
+
+        T prod() const noexcept {
+            T output = 1;
+            for (const T& t : *this) {
+                output *= t;
+            }
+
+            return output;
+        }
+
+        DynArray<T> cumprod() const {
+            DynArray<T> output(this->size());
+
+            T running_total = 1;
+            for (size_t i = 0; i < this->size(); ++i) {
+                running_total *= (*this)[i];
+                output[i] = running_total;
+            }
+
+            return output;
+        }
+
+        T dot(const DynArray<T>& other) const {
+            return this->dot(other.data(), other.size());
+        }
+
+        template <size_t N>
+        T dot(const MathArray<T, N>& other) const {
+            return this->dot(other.data, N);
+        }
+
+        DynArray<T>& normalise() {
+            const T length = (T) std::sqrt(this->dot(*this));
+            for (T& t : *this) {
+                t /= length;
+            }
+
+            return *this;
+        }
+
+    private:
+        storage_type values;
+
+        T dot(const T* other, const size_t n) const {
+            if (n != this->size()) {
+                throw std::invalid_argument("Array sizes don't match");
+            }
+
+            T output = 0;
+            for (size_t i = 0; i < n; ++i) {
+                output += (*this)[i] * other[i];
+            }
+
+            return output;
+        }
+    };
+
+
+    /**
+      * Runtime-sized companion to Tensor: rows x columns, row-major, in one
+      * aligned buffer. Element access is [{i, j}] as for Tensor. Fixed-size
+      * blocks can be read and written with block and set_block, which is how
+      * pair tensors get into a 3N x 3N mobility matrix.
+      */
+    template <class T>
+    class DynMatrix {
+
+    public:
+        using storage_type = std::vector<T, AlignedAllocator<T>>;
+
+        DynMatrix() = default;
+
+        DynMatrix(const size_t rows, const size_t columns, const T& value = T{})
+        : n_rows(rows)
+        , n_columns(columns)
+        , values(rows * columns, value) {}
+
+        template <size_t N, size_t M>
+        explicit DynMatrix(const Tensor<T, N, M>& tensor)
+        : n_rows(N)
+        , n_columns(M)
+        , values(std::begin(tensor.data), std::end(tensor.data)) {}
+
+        static DynMatrix identity(const size_t n) {
+            DynMatrix output(n, n);
+
+            for (size_t i = 0; i < n; ++i) {
+                output[{i, i}] = T{1};
+            }
+
+            return output;
+        }
+
+        T& operator[](const Index& i) noexcept {
+            return this->values[i.i * this->n_columns + i.j];
+        }
+
+        const T& operator[](const Index& i) const noexcept {
+            return this->values[i.i * this->n_columns + i.j];
+        }
+
+        T& at(const size_t i, const size_t j) {
+            if (i >= this->n_rows || j >= this->n_columns) {
+                throw std::range_error("Indices out of bounds for matrix");
+            }
+
+            return (*this)[{i, j}];
+        }
+
+        const T& at(const size_t i, const size_t j) const {
+            if (i >= this->n_rows || j >= this->n_columns) {
+                throw std::range_error("Indices out of bounds for matrix");
+            }
+
+            return (*this)[{i, j}];
+        }
+
+        Span<T> row(const size_t i) noexcept {
+            return Span<T>(this->data() + i * this->n_columns, this->n_columns);
+        }
+
+        Span<const T> row(const size_t i) const noexcept {
+            return Span<const T>(this->data() + i * this->n_columns, this->n_columns);
+        }
+
+        T* data() noexcept {
+            return this->values.data();
+        }
+
+        const T* data() const noexcept {
+            return this->values.data();
+        }
+
+        size_t rows() const noexcept {
+            return this->n_rows;
+        }
+
+        size_t columns() const noexcept {
+            return this->n_columns;
+        }
+
+        size_t size() const noexcept {
+            return this->values.size();
+        }
+
+        void resize(const size_t rows, const size_t columns, const T& value = T{}) {
+            this->n_rows = rows;
+            this->n_columns = columns;
+            this->values.assign(rows * columns, value);
+        }
+
+        // The N x M block with its top left corner at (row, column).
+        template <size_t N, size_t M>
+        Tensor<T, N, M> block(const size_t row, const size_t column) const {
+            this->check_block(row, column, N, M);
+
+            Tensor<T, N, M> output{};
+            for (size_t i = 0; i < N; ++i) {
+                for (size_t j = 0; j < M; ++j) {
+                    output.data[i * M + j] = (*this)[{row + i, column + j}];
+                }
+            }
+
+            return output;
+        }
+
+        template <size_t N, size_t M>
+        void set_block(const size_t row, const size_t column, const Tensor<T, N, M>& tensor) {
+            this->check_block(row, column, N, M);
+
+            for (size_t i = 0; i < N; ++i) {
+                for (size_t j = 0; j < M; ++j) {
+                    (*this)[{row + i, column + j}] = tensor.data[i * M + j];
+                }
+            }
+        }
+
+        template <size_t N, size_t M>
+        Tensor<T, N, M> to_fixed() const {
+            if (N != this->n_rows || M != this->n_columns) {
+                throw std::invalid_argument("DynMatrix isn't the same shape as that Tensor");
+            }
+
+            return this->block<N, M>(0, 0);
+        }
+
+        DynMatrix<T> transpose() const {
+            DynMatrix<T> output(this->n_columns, this->n_rows);
+
+            for (size_t i = 0; i < this->n_rows; ++i) {
+                for (size_t j = 0; j < this->n_columns; ++j) {
+                    output[{j, i}] = (*this)[{i, j}];
+                }
+            }
+
+            return output;
+        }
+
+        T sum() const noexcept {
+            T output = 0;
+            for (const T& t : this->values) {
+                output += t;
+            }
+
+            return output;
+        }
+
+        T trace() const {
+            if (this->n_rows != this->n_columns) {
+                throw std::invalid_argument("Trace of a non-square matrix");
+            }
+
+            T output = 0;
+            for (size_t i = 0; i < this->n_rows; ++i) {
+                output += (*this)[{i, i}];
+            }
+
+            return output;
+        }
+
+    private:
+        size_t n_rows = 0;
+        size_t n_columns = 0;
+        storage_type values;
+
+        void check_block(const size_t row, const size_t column, const size_t n, const size_t m) const {
+            if (row + n > this->n_rows || column + m > this->n_columns) {
+                throw std::range_error("Block doesn't fit inside the matrix");
+            }
+        }
+    };
+
+
+    /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+     * DYNARRAY ARITHMETIC * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+     * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+    inline void check_same_size(const size_t n1, const size_t n2) {
+        if (n1 != n2) {
+            throw std::invalid_argument("Array sizes don't match");
+        }
+    }
+
+    // out[i] = f(i) for every i < n, the loop behind all the operators below.
+    template <class T, class F>
+    inline DynArray<T> generate_array(const size_t n, F&& f) {
+        DynArray<T> output(n);
+        T* out = output.data();
+
+        for (size_t i = 0; i < n; ++i) {
+            out[i] = f(i);
+        }
+
+        return output;
+    }
+
+    template <class T>
+    inline DynArray<T> operator+ (const DynArray<T>& a1, const DynArray<T>& a2) {
+        check_same_size(a1.size(), a2.size());
+        return generate_array<T>(a1.size(), [&](const size_t i) { return a1[i] + a2[i]; });
+    }
+
+    template <class T>
+    inline DynArray<T> operator+ (const DynArray<T>& a1, const T& a2) {
+        return generate_array<T>(a1.size(), [&](const size_t i) { return a1[i] + a2; });
+    }
+
+    template <class T>
+    inline DynArray<T> operator+ (const T& a1, const DynArray<T>& a2) {
+        return a2 + a1;
+    }
+
+    template <class T, size_t N>
+    inline DynArray<T> operator+ (const DynArray<T>& a1, const MathArray<T, N>& a2) {
+        check_same_size(a1.size(), N);
+        return generate_array<T>(N, [&](const size_t i) { return a1[i] + a2[i]; });
+    }
+
+    template <class T, size_t N>
+    inline DynArray<T> operator+ (const MathArray<T, N>& a1, const DynArray<T>& a2) {
+        return a2 + a1;
+    }
+
+    template <class T>
+    inline DynArray<T> operator- (const DynArray<T>& a1, const DynArray<T>& a2) {
+        check_same_size(a1.size(), a2.size());
+        return generate_array<T>(a1.size(), [&](const size_t i) { return a1[i] - a2[i]; });
+    }
+
+    template <class T>
+    inline DynArray<T> operator- (const DynArray<T>& a1, const T& a2) {
+        return generate_array<T>(a1.size(), [&](const size_t i) { return a1[i] - a2; });
+    }
+
+    template <class T>
+    inline DynArray<T> operator- (const T& a1, const DynArray<T>& a2) {
+        return generate_array<T>(a2.size(), [&](const size_t i) { return a1 - a2[i]; });
+    }
+
+    template <class T, size_t N>
+    inline DynArray<T> operator- (const DynArray<T>& a1, const MathArray<T, N>& a2) {
+        check_same_size(a1.size(), N);
+        return generate_array<T>(N, [&](const size_t i) { return a1[i] - a2[i]; });
+    }
+
+    template <class T, size_t N>
+    inline DynArray<T> operator- (const MathArray<T, N>& a1, const DynArray<T>& a2) {
+        check_same_size(N, a2.size());
+        return generate_array<T>(N, [&](const size_t i) { return a1[i] - a2[i]; });
+    }
+
+    template <class T>
+    inline DynArray<T> operator* (const DynArray<T>& a1, const DynArray<T>& a2) {
+        check_same_size(a1.size(), a2.size());
+        return generate_array<T>(a1.size(), [&](const size_t i) { return a1[i] * a2[i]; });
+    }
+
+    template <class T>
+    inline DynArray<T> operator* (const DynArray<T>& a1, const T& a2) {
+        return generate_array<T>(a1.size(), [&](const size_t i) { return a1[i] * a2; });
+    }
+
+    template <class T>
+    inline DynArray<T> operator* (const T& a1, const DynArray<T>& a2) {
+        return a2 * a1;
+    }
+
+    template <class T, size_t N>
+    inline DynArray<T> operator* (const DynArray<T>& a1, const MathArray<T, N>& a2) {
+        check_same_size(a1.size(), N);
+        return generate_array<T>(N, [&](const size_t i) { return a1[i] * a2[i]; });
+    }
+
+    template <class T, size_t N>
+    inline DynArray<T> operator* (const MathArray<T, N>& a1, const DynArray<T>& a2) {
+        return a2 * a1;
+    }
+
+    template <class T>
+    inline DynArray<T> operator/ (const DynArray<T>& a1, const DynArray<T>& a2) {
+        check_same_size(a1.size(), a2.size());
+        return generate_array<T>(a1.size(), [&](const size_t i) { return a1[i] / a2[i]; });
+    }
+
+    template <class T>
+    inline DynArray<T> operator/ (const DynArray<T>& a1, const T& a2) {
+        return generate_array<T>(a1.size(), [&](const size_t i) { return a1[i] / a2; });
+    }
+
+    template <class T>
+    inline DynArray<T> operator/ (const T& a1, const DynArray<T>& a2) {
+        return generate_array<T>(a2.size(), [&](const size_t i) { return a1 / a2[i]; });
+    }
+
+    template <class T, size_t N>
+    inline DynArray<T> operator/ (const DynArray<T>& a1, const MathArray<T, N>& a2) {
+        check_same_size(a1.size(), N);
+        return generate_array<T>(N, [&](const size_t i) { return a1[i] / a2[i]; });
+    }
+
+    template <class T, size_t N>
+    inline DynArray<T> operator/ (const MathArray<T, N>& a1, const DynArray<T>& a2) {
+        check_same_size(N, a2.size());
+        return generate_array<T>(N, [&](const size_t i) { return a1[i] / a2[i]; });
+    }
+
+    template <class T>
+    inline DynArray<T> operator- (const DynArray<T>& a1) {
+        return generate_array<T>(a1.size(), [&](const size_t i) { return -a1[i]; });
+    }
+
+    // Compound assignment works in place, so no temporaries for the common
+    // x += dt * u pattern beyond the product itself.
+    template <class T, class U>
+    inline DynArray<T>& operator+= (DynArray<T>& a1, const U& a2) {
+        if constexpr (std::is_convertible<U, T>::value) {
+            for (T& t : a1) {
+                t += a2;
+            }
+        } else {
+            check_same_size(a1.size(), a2.size());
+            for (size_t i = 0; i < a1.size(); ++i) {
+                a1[i] += a2[i];
+            }
+        }
+
+        return a1;
+    }
+
+    template <class T, class U>
+    inline DynArray<T>& operator-= (DynArray<T>& a1, const U& a2) {
+        if constexpr (std::is_convertible<U, T>::value) {
+            for (T& t : a1) {
+                t -= a2;
+            }
+        } else {
+            check_same_size(a1.size(), a2.size());
+            for (size_t i = 0; i < a1.size(); ++i) {
+                a1[i] -= a2[i];
+            }
+        }
+
+        return a1;
+    }
+
+    template <class T, class U>
+    inline DynArray<T>& operator*= (DynArray<T>& a1, const U& a2) {
+        if constexpr (std::is_convertible<U, T>::value) {
+            for (T& t : a1) {
+                t *= a2;
+            }
+        } else {
+            check_same_size(a1.size(), a2.size());
+            for (size_t i = 0; i < a1.size(); ++i) {
+                a1[i] *= a2[i];
+            }
+        }
+
+        return a1;
+    }
+
+    template <class T, class U>
+    inline DynArray<T>& operator/= (DynArray<T>& a1, const U& a2) {
+        if constexpr (std::is_convertible<U, T>::value) {
+            for (T& t : a1) {
+                t /= a2;
+            }
+        } else {
+            check_same_size(a1.size(), a2.size());
+            for (size_t i = 0; i < a1.size(); ++i) {
+                a1[i] /= a2[i];
+            }
+        }
+
+        return a1;
+    }
+
+    template <class T>
+    inline T magnitude_sq(const DynArray<T>& v) {
+        return v.dot(v);
+    }
+
+    template <class T>
+    inline T magnitude(const DynArray<T>& v) {
+        return std::sqrt(v.dot(v));
+    }
+
+    template <class T>
+    inline DynArray<T> pow(const DynArray<T>& a1, const T& exponent) {
+        return generate_array<T>(a1.size(), [&](const size_t i) { return std::pow(a1[i], exponent); });
+    }
+
+    template <class T>
+    inline DynArray<T> abs(const DynArray<T>& a1) {
+        return generate_array<T>(a1.size(), [&](const size_t i) { return std::abs(a1[i]); });
+    }
+
+    template <class T>
+    inline std::ostream& operator<< (std::ostream& out, const DynArray<T>& v) {
+        out << "(";
+
+        for (size_t i = 0; i < v.size(); ++i) {
+            out << v[i] << (i + 1 < v.size() ? ", " : "");
+        }
+
+        return out << ")";
+    }
+
+
+    /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+     * DYNMATRIX ARITHMETIC  * * * * * * * * * * * * * * * * * * * * * * * * * * *
+     * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+    template <class T>
+    inline DynMatrix<T> operator+ (const DynMatrix<T>& m1, const DynMatrix<T>& m2) {
+        if (m1.rows() != m2.rows() || m1.columns() != m2.columns()) {
+            throw std::invalid_argument("Matrix shapes don't match");
+        }
+
+        DynMatrix<T> output(m1.rows(), m1.columns());
+        for (size_t i = 0; i < m1.size(); ++i) {
+            output.data()[i] = m1.data()[i] + m2.data()[i];
+        }
+
+        return output;
+    }
+
+    template <class T>
+    inline DynMatrix<T> operator- (const DynMatrix<T>& m1, const DynMatrix<T>& m2) {
+        if (m1.rows() != m2.rows() || m1.columns() != m2.columns()) {
+            throw std::invalid_argument("Matrix shapes don't match");
+        }
+
+        DynMatrix<T> output(m1.rows(), m1.columns());
+        for (size_t i = 0; i < m1.size(); ++i) {
+            output.data()[i] = m1.data()[i] - m2.data()[i];
+        }
+
+        return output;
+    }
+
+    template <class T>
+    inline DynMatrix<T> operator* (const T& scale, const DynMatrix<T>& m) {
+        DynMatrix<T> output(m.rows(), m.columns());
+        for (size_t i = 0; i < m.size(); ++i) {
+            output.data()[i] = scale * m.data()[i];
+        }
+
+        return output;
+    }
+
+    template <class T>
+    inline DynMatrix<T> operator* (const DynMatrix<T>& m, const T& scale) {
+        return scale * m;
+    }
+
+    /**
+      * Matrix product, looping i-k-j so the innermost loop runs along rows
+      * of both m2 and the output and vectorises.
+      */
+    template <class T>
+    inline DynMatrix<T> operator* (const DynMatrix<T>& m1, const DynMatrix<T>& m2) {
+        if (m1.columns() != m2.rows()) {
+            throw std::invalid_argument("Matrix shapes don't match for multiplication");
+        }
+
+        const size_t n = m1.rows();
+        const size_t inner = m1.columns();
+        const size_t m = m2.columns();
+
+        DynMatrix<T> output(n, m);
+        const T* a = m1.data();
+        const T* b = m2.data();
+        T* c = output.data();
+
+        for (size_t i = 0; i < n; ++i) {
+            for (size_t k = 0; k < inner; ++k) {
+                const T a_ik = a[i * inner + k];
+                const T* b_row = b + k * m;
+                T* c_row = c + i * m;
+
+                for (size_t j = 0; j < m; ++j) {
+                    c_row[j] += a_ik * b_row[j];
+                }
+            }
+        }
+
+        return output;
+    }
+
+    template <class T>
+    inline DynArray<T> operator* (const DynMatrix<T>& m, const DynArray<T>& v) {
+        check_same_size(m.columns(), v.size());
+
+        return generate_array<T>(m.rows(), [&](const size_t i) {
+            const T* row = m.data() + i * m.columns();
+
+            T sum = 0;
+            for (size_t j = 0; j < m.columns(); ++j) {
+                sum += row[j] * v[j];
+            }
+
+            return sum;
+        });
+    }
+
+    template <class T, size_t N>
+    inline DynArray<T> operator* (const DynMatrix<T>& m, const MathArray<T, N>& v) {
+        return m * DynArray<T>(v);
+    }
+
+    // A fixed-size tensor applied to a runtime-sized vector of the right length.
+    template <class T, size_t N, size_t M>
+    inline MathArray<T, N> operator* (const Tensor<T, N, M>& t, const DynArray<T>& v) {
+        check_same_size(M, v.size());
+
+        MathArray<T, N> output{};
+        for (size_t i = 0; i < N; ++i) {
+            for (size_t k = 0; k < M; ++k) {
+                output[i] += t.data[i * M + k] * v[k];
+            }
+        }
+
+        return output;
+    }
+}
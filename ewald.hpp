@@ -0,0 +1,616 @@
+#pragma once
+
+#include "arrayutils.hpp"
+#include "boundingbox.hpp"
+#include "fft.hpp"
+#include "fluidutils.hpp"
+#include "particleset.hpp"
+#include "threadutils.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+namespace dav {
+    /**
+      * Knobs for SpectralEwald. xi splits the sum between real space, where
+      * pair terms decay like exp(-xi^2 r^2) and are cut off at cutoff, and
+      * k space, where they decay like exp(-k^2 / 4 xi^2) and are resolved on
+      * a grid of grid[0] x grid[1] x grid[2] points (powers of two). Forces
+      * are spread to and velocities gathered from the grid with Gaussians
+      * spanning support points along the coarsest axis.
+      */
+    struct EwaldParameters {
+        double xi;
+        double cutoff;
+        MathArray<size_t, 3> grid;
+        size_t support;
+
+        /**
+          * Parameters for a relative error of about tolerance with n
+          * particles in box, following Lindbo and Tornberg's estimates. If
+          * no cutoff is given, it's picked so each particle has around 50
+          * real-space neighbours, up to half the shortest side of the box.
+          */
+        static EwaldParameters for_tolerance(const BoundingBox& box, const size_t n, const double tolerance, double cutoff = 0) {
+            if (!(tolerance > 0 && tolerance < 1)) {
+                throw std::invalid_argument("Ewald tolerance must be between 0 and 1");
+            }
+
+            const MathArray<double, 3> sides{box.get_xsize(), box.get_ysize(), box.get_zsize()};
+            const double half_side = std::min({sides[0], sides[1], sides[2]}) / 2;
+
+            if (cutoff <= 0) {
+                const double neighbours = 50;
+                cutoff = std::min(half_side, std::cbrt(3 * box.volume() * neighbours / (4 * M_PI * std::max<size_t>(n, 1))));
+            }
+
+            // Real-space terms are exp(-q^2) small at the cutoff and k-space
+            // ones at the Nyquist wavenumber pi M / L. The gridding error
+            // measured against the direct k sum goes roughly as
+            // 0.1 exp(-1.15 P), a bit worse than Lindbo and Tornberg's
+            // estimate, so the support is picked from that.
+            const double q_sq = -std::log(tolerance);
+            const double q = std::sqrt(q_sq);
+            const double xi = q / cutoff;
+
+            MathArray<size_t, 3> grid{};
+            for (size_t i = 0; i < 3; ++i) {
+                grid[i] = next_power_of_two(std::max<size_t>(8, size_t(std::ceil(2 * xi * sides[i] * q / M_PI))));
+            }
+
+            const size_t support = std::min(std::min({grid[0], grid[1], grid[2]}), size_t(std::ceil(0.9 * q_sq)));
+
+            return EwaldParameters{xi, cutoff, grid, support};
+        }
+
+        // Gaussians are truncated where they've fallen by exp(-m^2 / 2), with
+        // m = shape_constant * sqrt(pi * support).
+        static constexpr double shape_constant = 0.95;
+    };
+
+
+    /**
+      * Spectral Ewald summation for Stokes flow in a box that is periodic in
+      * every direction: the velocity of each particle due to the forces on
+      * all the others and on all their periodic images. With radius = 0 the
+      * particles are point forces (Stokeslets); with radius > 0 they're
+      * spheres coupled by the RPY tensor, self mobility included.
+      *
+      * The Stokeslet S = I / r + r r^T / r^3 is split Hasimoto's way into
+      *
+      *   S^R = (erfc(xi r) / r - 2 xi / sqrt(pi) e^{-xi^2 r^2}) I
+      *       + (erfc(xi r) / r + 2 xi / sqrt(pi) e^{-xi^2 r^2}) r r^T / r^2,
+      *
+      * summed directly over pairs closer than the cutoff (minimum image, so
+      * the cutoff can be at most half the box), and a smooth remainder with
+      * Fourier transform
+      *
+      *   S^F(k) = 8 pi (1 / k^2 + 1 / 4 xi^2) (I - k k^T / k^2) e^{-k^2 / 4 xi^2},
+      *
+      * summed over the reciprocal lattice with k = 0 left out (the net force
+      * is balanced by a mean pressure gradient). The k sum includes each
+      * particle's own contribution, which is taken back out with the value
+      * of the remainder at r = 0, 4 xi / sqrt(pi) I. RPY away from overlap is
+      * (1 + a^2 / 3 nabla^2) S, so it's the same split with the Laplacian of
+      * S^R in real space and an extra factor of (1 - a^2 k^2 / 3) in k space;
+      * overlapping pairs get the difference from the overlap form added on.
+      *
+      * The k-space sum uses Lindbo and Tornberg's spectral Ewald method:
+      * forces are spread onto a grid with Gaussians, the grid is Fourier
+      * transformed, scaled by S^F with the Gaussians' own transform divided
+      * out, transformed back, and velocities are gathered at the particles
+      * with the same Gaussians. That's O(N P^3 + M log M) for M grid points
+      * instead of O(N M).
+      *
+      * The real-space pairs are found by binning the particles into cells at
+      * least a cutoff across, with neighbour cells wrapped around the box, so
+      * that half is O(N) at a fixed number of neighbours. The bins, grids,
+      * Gaussian windows and FFT line buffer are scratch kept between calls,
+      * so once they're sized for a given N an evaluation allocates nothing
+      * beyond the threads parallel_for starts (none with n_threads = 1). It
+      * also means one SpectralEwald mustn't be applied from several threads
+      * at once.
+      */
+    class SpectralEwald {
+
+    public:
+        SpectralEwald(const BoundingBox& box, const EwaldParameters& parameters, const double shear_viscosity, const double radius = 0, const size_t n_threads = 0)
+        : box(box)
+        , parameters(parameters)
+        , shear_viscosity(shear_viscosity)
+        , radius(radius)
+        , n_threads(n_threads)
+        , fft(parameters.grid[0], parameters.grid[1], parameters.grid[2]) {
+
+            if (!(parameters.xi > 0)) {
+                throw std::invalid_argument("Ewald xi must be positive");
+            }
+
+            if (!(parameters.cutoff > 0)) {
+                throw std::invalid_argument("Ewald cutoff must be positive");
+            }
+
+            if (!(radius >= 0)) {
+                throw std::invalid_argument("Ewald particle radius can't be negative");
+            }
+
+            for (size_t i = 0; i < 3; ++i) {
+                this->sides[i] = box.get_ith_size(i);
+                this->spacing[i] = this->sides[i] / parameters.grid[i];
+
+                if (2 * parameters.cutoff > this->sides[i]) {
+                    throw std::invalid_argument("Ewald cutoff can't be more than half the box");
+                }
+            }
+
+            // Gaussian window exp(-2 xi^2 |x|^2 / shape), with its width set so
+            // that it reaches exp(-m^2 / 2) at half the support of the coarsest
+            // axis. The finer axes get more points to cover the same width.
+            const double half_width = parameters.support * std::max({this->spacing[0], this->spacing[1], this->spacing[2]}) / 2;
+            const double m = EwaldParameters::shape_constant * std::sqrt(M_PI * parameters.support);
+            this->shape = square(2 * half_width * parameters.xi / m);
+
+            if (!(this->shape < 1)) {
+                throw std::invalid_argument("Ewald grid is too coarse for xi");
+            }
+
+            for (size_t i = 0; i < 3; ++i) {
+                this->supports[i] = std::min(parameters.grid[i], size_t(std::ceil(2 * half_width / this->spacing[i])));
+            }
+
+            // Cells at least a cutoff across. The cutoff is at most half the
+            // box, so there are at least two along each axis.
+            for (size_t i = 0; i < 3; ++i) {
+                this->cells_per_axis[i] = std::max<size_t>(1, size_t(this->sides[i] / parameters.cutoff));
+                this->inverse_cell_size[i] = this->cells_per_axis[i] / this->sides[i];
+            }
+
+            this->cell_starts.resize(this->cells_per_axis.prod() + 1);
+
+            for (std::vector<std::complex<double>>& grid : this->grids) {
+                grid.resize(this->fft.size());
+            }
+        }
+
+        const EwaldParameters& get_parameters() const noexcept {
+            return this->parameters;
+        }
+
+        double get_shape() const noexcept {
+            return this->shape;
+        }
+
+        /**
+          * Velocities of n particles at (x, y, z) with forces (fx, fy, fz).
+          * The outputs are overwritten. Positions outside the box are
+          * wrapped back in.
+          */
+        void apply(const double* x, const double* y, const double* z,
+                   const double* fx, const double* fy, const double* fz,
+                   const size_t n, double* ux, double* uy, double* uz) const {
+
+            this->real_space(x, y, z, fx, fy, fz, n, ux, uy, uz);
+
+            this->k_velocities.resize(n);
+            double* const kx = this->k_velocities.x().data();
+            double* const ky = this->k_velocities.y().data();
+            double* const kz = this->k_velocities.z().data();
+            this->k_space(x, y, z, fx, fy, fz, n, kx, ky, kz);
+
+            for (size_t i = 0; i < n; ++i) {
+                ux[i] += kx[i];
+                uy[i] += ky[i];
+                uz[i] += kz[i];
+            }
+        }
+
+        void apply(const VectorField& positions, const VectorField& forces, VectorField& velocities) const {
+            if (forces.size() != positions.size()) {
+                throw std::invalid_argument("Number of forces doesn't match the number of positions");
+            }
+
+            velocities.resize(positions.size());
+
+            this->apply(positions.x().data(), positions.y().data(), positions.z().data(),
+                        forces.x().data(), forces.y().data(), forces.z().data(),
+                        positions.size(),
+                        velocities.x().data(), velocities.y().data(), velocities.z().data());
+        }
+
+        /**
+          * The real-space half of apply, plus the self terms. Overwrites the
+          * outputs.
+          */
+        void real_space(const double* x, const double* y, const double* z,
+                        const double* fx, const double* fy, const double* fz,
+                        const size_t n, double* ux, double* uy, double* uz) const {
+
+            const double xi = this->parameters.xi;
+            const double cutoff_sq = square(this->parameters.cutoff);
+            const double prefactor = 1.0 / (8 * M_PI * this->shear_viscosity);
+
+            // What's left of the k sum at r = 0, and the RPY self mobility,
+            // both in units of 1 / (8 pi eta).
+            double self = -4 * xi / std::sqrt(M_PI);
+            if (this->radius > 0) {
+                self += 40.0 / 9.0 * square(this->radius) * cube(xi) / std::sqrt(M_PI) + 4 / (3 * this->radius);
+            }
+
+            this->bin(x, y, z, n);
+
+            const size_t nx = this->cells_per_axis[0];
+            const size_t ny = this->cells_per_axis[1];
+            const size_t nz = this->cells_per_axis[2];
+
+            // The cells either side of a cell along an axis, wrapped around.
+            // With fewer than three cells the wrapped ones would repeat, so
+            // then each cell is visited once instead.
+            const auto neighbours = [](const size_t index, const size_t count, size_t (&out)[3]) {
+                if (count < 3) {
+                    for (size_t k = 0; k < count; ++k) {
+                        out[k] = k;
+                    }
+
+                    return count;
+                }
+
+                out[0] = (index + count - 1) % count;
+                out[1] = index;
+                out[2] = (index + 1) % count;
+
+                return size_t(3);
+            };
+
+            parallel_for(0, n, [&](const size_t begin, const size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    MathArray<double, 3> u = self * MathArray<double, 3>{fx[i], fy[i], fz[i]};
+                    const MathArray<double, 3> position{x[i], y[i], z[i]};
+
+                    const size_t cell = this->particle_cells[i];
+                    size_t xs[3];
+                    size_t ys[3];
+                    size_t zs[3];
+                    const size_t x_count = neighbours(cell % nx, nx, xs);
+                    const size_t y_count = neighbours((cell / nx) % ny, ny, ys);
+                    const size_t z_count = neighbours(cell / (nx * ny), nz, zs);
+
+                    for (size_t a = 0; a < z_count; ++a) {
+                        for (size_t b = 0; b < y_count; ++b) {
+                            for (size_t c = 0; c < x_count; ++c) {
+                                const size_t neighbour = (zs[a] * ny + ys[b]) * nx + xs[c];
+
+                                for (size_t k = this->cell_starts[neighbour]; k < this->cell_starts[neighbour + 1]; ++k) {
+                                    const size_t j = this->cell_particles[k];
+
+                                    if (j == i) {
+                                        continue;
+                                    }
+
+                                    const MathArray<double, 3> r = PeriodicBoundaries::displacement(this->box, position, MathArray<double, 3>{x[j], y[j], z[j]});
+                                    const double r_sq = magnitude_sq(r);
+
+                                    if (r_sq >= cutoff_sq) {
+                                        continue;
+                                    }
+
+                                    const MathArray<double, 3> f{fx[j], fy[j], fz[j]};
+                                    const double r_dot_f = (r * f).sum();
+
+                                    double identity_coefficient;
+                                    double outer_coefficient;
+                                    this->real_space_coefficients(std::sqrt(r_sq), identity_coefficient, outer_coefficient);
+
+                                    u += identity_coefficient * f + (outer_coefficient * r_dot_f) * r;
+                                }
+                            }
+                        }
+                    }
+
+                    ux[i] = prefactor * u[0];
+                    uy[i] = prefactor * u[1];
+                    uz[i] = prefactor * u[2];
+                }
+            }, this->n_threads);
+        }
+
+        /**
+          * The k-space half of apply. Overwrites the outputs.
+          */
+        void k_space(const double* x, const double* y, const double* z,
+                     const double* fx, const double* fy, const double* fz,
+                     const size_t n, double* ux, double* uy, double* uz) const {
+
+            auto& grids = this->grids;
+            for (std::vector<std::complex<double>>& grid : grids) {
+                std::fill(grid.begin(), grid.end(), 0.0);
+            }
+
+            // Spread. Serial, since neighbouring particles write to the same
+            // grid points.
+            Window& window = this->spread_window;
+            for (size_t p = 0; p < n; ++p) {
+                this->window_at(MathArray<double, 3>{x[p], y[p], z[p]}, window);
+
+                const double force[3] = {fx[p], fy[p], fz[p]};
+                this->for_each_grid_point(window, [&](const size_t g, const double weight) {
+                    for (size_t c = 0; c < 3; ++c) {
+                        grids[c][g] += weight * force[c];
+                    }
+                });
+            }
+
+            for (std::vector<std::complex<double>>& grid : grids) {
+                this->fft.forward(grid.data());
+            }
+
+            this->scale_fourier_grids(grids);
+
+            for (std::vector<std::complex<double>>& grid : grids) {
+                this->fft.inverse(grid.data());
+            }
+
+            // Gather. The volume element of the quadrature, the 1 / V of the
+            // inverse transform, the spacing^3 of the forward one and
+            // 1 / (8 pi eta) all go into one factor.
+            const double cell_volume = this->spacing.prod();
+            const double gather_factor = cell_volume * cell_volume / (this->box.volume() * 8 * M_PI * this->shear_viscosity);
+
+            // The particles are split into one chunk per thread here, rather
+            // than by parallel_for, so each chunk can keep its own window.
+            const size_t chunks = std::min(n, this->n_threads == 0 ? default_thread_count() : this->n_threads);
+            if (this->gather_windows.size() < chunks) {
+                this->gather_windows.resize(chunks);
+            }
+
+            parallel_for(0, chunks, [&](const size_t chunk_begin, const size_t chunk_end) {
+                for (size_t chunk = chunk_begin; chunk < chunk_end; ++chunk) {
+                    this->gather(x, y, z, n * chunk / chunks, n * (chunk + 1) / chunks, gather_factor, this->gather_windows[chunk], ux, uy, uz);
+                }
+            }, chunks);
+        }
+
+    private:
+        // The 1D Gaussian weights and first grid index along each axis for
+        // one particle. The support is at most the grid size.
+        struct Window {
+            std::vector<double> weights[3];
+            std::vector<size_t> indices[3];
+        };
+
+        const BoundingBox box;
+        const EwaldParameters parameters;
+        const double shear_viscosity;
+        const double radius;
+        const size_t n_threads;
+        const FFT3D fft;
+
+        MathArray<double, 3> sides;
+        MathArray<double, 3> spacing;
+        MathArray<size_t, 3> supports;
+        double shape;
+
+        MathArray<size_t, 3> cells_per_axis;
+        MathArray<double, 3> inverse_cell_size;
+
+        // Scratch. The particles sorted by cell, with cell c's particles at
+        // cell_particles[cell_starts[c]] up to cell_starts[c + 1], and the
+        // grids and k-space velocities.
+        mutable std::vector<size_t> cell_starts;
+        mutable std::vector<size_t> cell_particles;
+        mutable std::vector<size_t> particle_cells;
+        mutable std::vector<std::complex<double>> grids[3];
+        mutable VectorField k_velocities;
+        mutable Window spread_window;
+        mutable std::vector<Window> gather_windows;
+
+        static double square(const double x) noexcept {
+            return x * x;
+        }
+
+        static double cube(const double x) noexcept {
+            return x * x * x;
+        }
+
+        // Velocities of particles [begin, end) from the transformed grids.
+        void gather(const double* x, const double* y, const double* z,
+                    const size_t begin, const size_t end, const double gather_factor, Window& window,
+                    double* ux, double* uy, double* uz) const {
+
+            for (size_t p = begin; p < end; ++p) {
+                this->window_at(MathArray<double, 3>{x[p], y[p], z[p]}, window);
+
+                double u[3] = {0, 0, 0};
+                this->for_each_grid_point(window, [&](const size_t g, const double weight) {
+                    for (size_t c = 0; c < 3; ++c) {
+                        u[c] += weight * this->grids[c][g].real();
+                    }
+                });
+
+                ux[p] = gather_factor * u[0];
+                uy[p] = gather_factor * u[1];
+                uz[p] = gather_factor * u[2];
+            }
+        }
+
+        // Counting sort of the particles into cells, wrapping them into the
+        // box first.
+        void bin(const double* x, const double* y, const double* z, const size_t n) const {
+            const double* const coordinates[3] = {x, y, z};
+            const size_t cell_count = this->cells_per_axis.prod();
+
+            this->particle_cells.resize(n);
+            this->cell_particles.resize(n);
+            std::fill(this->cell_starts.begin(), this->cell_starts.end(), 0);
+
+            for (size_t p = 0; p < n; ++p) {
+                size_t cell = 0;
+
+                for (size_t i = 3; i-- > 0;) {
+                    const double lower = this->box.get_lower_bounds()[i];
+                    const double wrapped = Periodic::apply(coordinates[i][p], lower, lower + this->sides[i]) - lower;
+                    const size_t index = std::min(size_t(wrapped * this->inverse_cell_size[i]), this->cells_per_axis[i] - 1);
+
+                    cell = cell * this->cells_per_axis[i] + index;
+                }
+
+                this->particle_cells[p] = cell;
+                ++this->cell_starts[cell];
+            }
+
+            // Running totals make cell_starts[c] the end of cell c, and then
+            // filling each cell from the back moves it down to the start.
+            for (size_t c = 1; c < cell_count; ++c) {
+                this->cell_starts[c] += this->cell_starts[c - 1];
+            }
+            this->cell_starts[cell_count] = n;
+
+            for (size_t p = n; p-- > 0;) {
+                this->cell_particles[--this->cell_starts[this->particle_cells[p]]] = p;
+            }
+        }
+
+        // Real-space pair tensor as identity_coefficient * I +
+        // outer_coefficient * r r^T, in units of 1 / (8 pi eta).
+        void real_space_coefficients(const double r, double& identity_coefficient, double& outer_coefficient) const noexcept {
+            const double xi = this->parameters.xi;
+            const double r_sq = r * r;
+            const double c = 2 * xi / std::sqrt(M_PI);
+            const double C = std::erfc(xi * r);
+            const double E = std::exp(-xi * xi * r_sq);
+
+            identity_coefficient = C / r - c * E;
+            outer_coefficient = (C / r + c * E) / r_sq;
+
+            if (this->radius <= 0) {
+                return;
+            }
+
+            // a^2 / 3 times the Laplacian of the above.
+            const double a_sq_3 = square(this->radius) / 3;
+            const double xi_sq = xi * xi;
+
+            identity_coefficient += a_sq_3 * (2 * C / (r_sq * r) + 2 * c * E / r_sq + 8 * c * xi_sq * E - 4 * c * xi_sq * xi_sq * r_sq * E);
+            outer_coefficient += a_sq_3 * (-6 * C / (r_sq * r_sq * r) - 6 * c * E / (r_sq * r_sq) - 4 * c * xi_sq * E / r_sq + 4 * c * xi_sq * xi_sq * E);
+
+            // Overlapping spheres: swap the far-field form, which the Ewald
+            // split is built on, for the overlap one.
+            const double a = this->radius;
+            if (r < 2 * a) {
+                const double far_identity = 1 / r + 2 * a * a / (3 * r_sq * r);
+                const double far_outer = 1 / (r_sq * r) - 2 * a * a / (r_sq * r_sq * r);
+
+                // 8 pi eta times the overlap RPY tensor (see rpy_tensor_at).
+                const double mu = 4 / (3 * a);
+                const double near_identity = mu * (1 - 9 * r / (32 * a));
+                const double near_outer = mu * 3 / (32 * a * r);
+
+                identity_coefficient += near_identity - far_identity;
+                outer_coefficient += near_outer - far_outer;
+            }
+        }
+
+        void window_at(const MathArray<double, 3>& position, Window& window) const {
+            const double xi = this->parameters.xi;
+
+            // Each axis gets its share of (2 xi^2 / pi shape)^{3/2}.
+            const double normalisation = std::sqrt(2 * xi * xi / (M_PI * this->shape));
+            const double exponent = 2 * xi * xi / this->shape;
+
+            for (size_t i = 0; i < 3; ++i) {
+                const double lower = this->box.get_lower_bounds()[i];
+                const double wrapped = Periodic::apply(position[i], lower, lower + this->sides[i]) - lower;
+                const size_t points = this->supports[i];
+                const size_t grid = this->parameters.grid[i];
+
+                // The points cover (s - P h / 2, s + P h / 2].
+                const double first = std::floor(wrapped / this->spacing[i] - points / 2.0) + 1;
+
+                window.weights[i].resize(points);
+                window.indices[i].resize(points);
+
+                for (size_t p = 0; p < points; ++p) {
+                    const double index = first + p;
+                    const double distance = index * this->spacing[i] - wrapped;
+
+                    window.weights[i][p] = normalisation * std::exp(-exponent * distance * distance);
+
+                    const long wrapped_index = long(index) % long(grid);
+                    window.indices[i][p] = size_t(wrapped_index < 0 ? wrapped_index + long(grid) : wrapped_index);
+                }
+            }
+        }
+
+        template <class F>
+        void for_each_grid_point(const Window& window, F&& f) const {
+            const size_t n1 = this->parameters.grid[1];
+            const size_t n2 = this->parameters.grid[2];
+
+            for (size_t a = 0; a < this->supports[0]; ++a) {
+                for (size_t b = 0; b < this->supports[1]; ++b) {
+                    const size_t row = (window.indices[0][a] * n1 + window.indices[1][b]) * n2;
+                    const double weight_ab = window.weights[0][a] * window.weights[1][b];
+
+                    for (size_t c = 0; c < this->supports[2]; ++c) {
+                        f(row + window.indices[2][c], weight_ab * window.weights[2][c]);
+                    }
+                }
+            }
+        }
+
+        // Multiply each wavevector's force by the k-space Stokeslet (or RPY)
+        // with the two Gaussians' transforms, exp(-shape k^2 / 8 xi^2) each,
+        // divided out.
+        void scale_fourier_grids(std::vector<std::complex<double>> (&grids)[3]) const {
+            const size_t n0 = this->parameters.grid[0];
+            const size_t n1 = this->parameters.grid[1];
+            const size_t n2 = this->parameters.grid[2];
+            const double xi_sq = square(this->parameters.xi);
+            const double a_sq_3 = square(this->radius) / 3;
+
+            // Wavenumber of index j along an axis of n points.
+            const auto wavenumber = [](const size_t j, const size_t n, const double side) {
+                const double signed_j = j < n / 2 ? double(j) : double(j) - double(n);
+
+                return 2 * M_PI * signed_j / side;
+            };
+
+            for (size_t i = 0; i < n0; ++i) {
+                const double k0 = wavenumber(i, n0, this->sides[0]);
+
+                for (size_t j = 0; j < n1; ++j) {
+                    const double k1 = wavenumber(j, n1, this->sides[1]);
+
+                    for (size_t l = 0; l < n2; ++l) {
+                        const double k2 = wavenumber(l, n2, this->sides[2]);
+                        const size_t g = (i * n1 + j) * n2 + l;
+
+                        const double k_sq = k0 * k0 + k1 * k1 + k2 * k2;
+
+                        if (k_sq == 0) {
+                            for (size_t c = 0; c < 3; ++c) {
+                                grids[c][g] = 0;
+                            }
+                            continue;
+                        }
+
+                        double scale = 8 * M_PI * (1 / k_sq + 1 / (4 * xi_sq)) * std::exp(-(1 - this->shape) * k_sq / (4 * xi_sq));
+                        if (this->radius > 0) {
+                            scale *= 1 - a_sq_3 * k_sq;
+                        }
+
+                        // (I - k k^T / k^2) F
+                        const std::complex<double> k_dot_f = (k0 * grids[0][g] + k1 * grids[1][g] + k2 * grids[2][g]) / k_sq;
+
+                        grids[0][g] = scale * (grids[0][g] - k0 * k_dot_f);
+                        grids[1][g] = scale * (grids[1][g] - k1 * k_dot_f);
+                        grids[2][g] = scale * (grids[2][g] - k2 * k_dot_f);
+                    }
+                }
+            }
+        }
+    };
+}
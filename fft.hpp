@@ -0,0 +1,196 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace dav {
+    inline constexpr bool is_power_of_two(const size_t n) noexcept {
+        return n != 0 && (n & (n - 1)) == 0;
+    }
+
+    inline size_t next_power_of_two(const size_t n) noexcept {
+        size_t output = 1;
+
+        while (output < n) {
+            output <<= 1;
+        }
+
+        return output;
+    }
+
+    /**
+      * Radix-2 fast Fourier transform of a fixed power-of-two length. The
+      * twiddle factors and bit reversal permutation are worked out once in
+      * the constructor, so reuse one FFT for every transform of that length.
+      *
+      * forward computes X_k = sum_j x_j e^{-2 pi i jk/n} and inverse the same
+      * with e^{+2 pi i jk/n}. Neither divides by n.
+      */
+    class FFT {
+
+    public:
+        explicit FFT(const size_t n)
+        : n(n)
+        , twiddles(n / 2)
+        , bit_reverse(n) {
+
+            if (!is_power_of_two(n)) {
+                throw std::invalid_argument("FFT length must be a power of two");
+            }
+
+            // Straight from cos and sin rather than by repeated multiplication,
+            // which loses a digit or so on long transforms.
+            for (size_t k = 0; k < n / 2; ++k) {
+                this->twiddles[k] = std::polar(1.0, -2 * M_PI * double(k) / double(n));
+            }
+
+            size_t bits = 0;
+            while ((size_t(1) << bits) < n) {
+                ++bits;
+            }
+
+            for (size_t i = 0; i < n; ++i) {
+                size_t reversed = 0;
+
+                for (size_t b = 0; b < bits; ++b) {
+                    reversed |= ((i >> b) & 1) << (bits - 1 - b);
+                }
+
+                this->bit_reverse[i] = reversed;
+            }
+        }
+
+        size_t size() const noexcept {
+            return this->n;
+        }
+
+        void forward(std::complex<double>* data) const noexcept {
+            this->transform(data, false);
+        }
+
+        void inverse(std::complex<double>* data) const noexcept {
+            this->transform(data, true);
+        }
+
+    private:
+        size_t n;
+        std::vector<std::complex<double>> twiddles;
+        std::vector<size_t> bit_reverse;
+
+        void transform(std::complex<double>* data, const bool inverse) const noexcept {
+            for (size_t i = 0; i < this->n; ++i) {
+                if (i < this->bit_reverse[i]) {
+                    std::swap(data[i], data[this->bit_reverse[i]]);
+                }
+            }
+
+            for (size_t length = 2; length <= this->n; length <<= 1) {
+                const size_t half = length / 2;
+                const size_t step = this->n / length;
+
+                for (size_t start = 0; start < this->n; start += length) {
+                    for (size_t k = 0; k < half; ++k) {
+                        const std::complex<double> w = inverse ? std::conj(this->twiddles[k * step]) : this->twiddles[k * step];
+                        const std::complex<double> odd = w * data[start + k + half];
+
+                        data[start + k + half] = data[start + k] - odd;
+                        data[start + k] += odd;
+                    }
+                }
+            }
+        }
+    };
+
+
+    /**
+      * Three-dimensional FFT of an n0 x n1 x n2 grid stored row-major, i.e.
+      * element (i, j, k) at (i * n1 + j) * n2 + k. Each axis is done as a
+      * batch of 1D transforms; lines that aren't contiguous are copied out to
+      * a buffer first so the butterflies don't stride through memory. The
+      * buffer belongs to the plan, so transforms allocate nothing, but one
+      * FFT3D can only run one transform at a time.
+      */
+    class FFT3D {
+
+    public:
+        FFT3D(const size_t n0, const size_t n1, const size_t n2)
+        : plans{FFT(n0), FFT(n1), FFT(n2)}
+        , line(std::max(n0, n1)) {}
+
+        size_t size() const noexcept {
+            return this->plans[0].size() * this->plans[1].size() * this->plans[2].size();
+        }
+
+        size_t size(const size_t axis) const noexcept {
+            return this->plans[axis].size();
+        }
+
+        void forward(std::complex<double>* data) const {
+            this->transform(data, false);
+        }
+
+        void inverse(std::complex<double>* data) const {
+            this->transform(data, true);
+        }
+
+    private:
+        FFT plans[3];
+
+        // Scratch for one line along the first or second axis.
+        mutable std::vector<std::complex<double>> line;
+
+        void transform(std::complex<double>* data, const bool inverse) const {
+            const size_t n0 = this->plans[0].size();
+            const size_t n1 = this->plans[1].size();
+            const size_t n2 = this->plans[2].size();
+
+            const auto run = [inverse](const FFT& plan, std::complex<double>* line) {
+                if (inverse) {
+                    plan.inverse(line);
+                } else {
+                    plan.forward(line);
+                }
+            };
+
+            // Last axis: contiguous already.
+            for (size_t row = 0; row < n0 * n1; ++row) {
+                run(this->plans[2], data + row * n2);
+            }
+
+            std::complex<double>* const line = this->line.data();
+
+            for (size_t i = 0; i < n0; ++i) {
+                for (size_t k = 0; k < n2; ++k) {
+                    for (size_t j = 0; j < n1; ++j) {
+                        line[j] = data[(i * n1 + j) * n2 + k];
+                    }
+
+                    run(this->plans[1], line);
+
+                    for (size_t j = 0; j < n1; ++j) {
+                        data[(i * n1 + j) * n2 + k] = line[j];
+                    }
+                }
+            }
+
+            for (size_t j = 0; j < n1; ++j) {
+                for (size_t k = 0; k < n2; ++k) {
+                    for (size_t i = 0; i < n0; ++i) {
+                        line[i] = data[(i * n1 + j) * n2 + k];
+                    }
+
+                    run(this->plans[0], line);
+
+                    for (size_t i = 0; i < n0; ++i) {
+                        data[(i * n1 + j) * n2 + k] = line[i];
+                    }
+                }
+            }
+        }
+    };
+}
@@ -4,110 +4,380 @@
 #include "tensorutils.hpp"
 #include "mathutils.hpp"
 #include "boundingbox.hpp"
+#include "particleset.hpp"
+#include "threadutils.hpp"
 
+#include <algorithm>
 #include <functional>
+#include <stdexcept>
+#include <vector>
 
 namespace dav {
+    /**
+      * Flow at separation (dx, dy, dz) from a sphere held still in a uniform
+      * stream (Ux, Uy, Uz):
+      *     U - 3a/4 (U/r + x (x.U)/r^3) - a^3/4 (U/r^3 - 3 x (x.U)/r^5).
+      * stokeslet = 3a/4 and dipole = a^3/4 only depend on the sphere, so
+      * batched callers work them out once.
+      */
+    inline void translating_flow_kernel(const double dx, const double dy, const double dz,
+                                        const double Ux, const double Uy, const double Uz,
+                                        const double stokeslet, const double dipole,
+                                        double& ux, double& uy, double& uz) noexcept {
+
+        const double inv_r_sq = 1.0 / (dx * dx + dy * dy + dz * dz);
+        const double inv_r = std::sqrt(inv_r_sq);
+        const double inv_r_3 = inv_r * inv_r_sq;
+
+        const double x_dot_U = dx * Ux + dy * Uy + dz * Uz;
+        const double along = (3 * dipole * inv_r_sq - stokeslet) * inv_r_3 * x_dot_U;
+        const double across = 1 - stokeslet * inv_r - dipole * inv_r_3;
+
+        ux = Ux * across + along * dx;
+        uy = Uy * across + along * dy;
+        uz = Uz * across + along * dz;
+    }
+
     inline MathArray<double, 3> translating_flow_at(const MathArray<double, 3>& position,
                                                     const MathArray<double, 3>& sphere_position,
                                                     const MathArray<double, 3>& translation_velocity,
                                                     const double sphere_radius) {
 
-        const MathArray<double, 3> new_coords = position - sphere_position;
-        const double distance = magnitude(new_coords);
-
         MathArray<double, 3> flow_speed{};
 
-        for (int i = 0; i < 3; ++i) {
-            for (int j = 0; j < 3; ++j) {
-                flow_speed[i] -= 0.75 * sphere_radius * translation_velocity[j] * delta(i, j) / distance;
-                flow_speed[i] -= 0.75 * sphere_radius * translation_velocity[j] * new_coords[i] * new_coords[j] / std::pow(distance, 3);
+        translating_flow_kernel(position[0] - sphere_position[0], position[1] - sphere_position[1], position[2] - sphere_position[2],
+                                translation_velocity[0], translation_velocity[1], translation_velocity[2],
+                                0.75 * sphere_radius, 0.25 * sphere_radius * sphere_radius * sphere_radius,
+                                flow_speed[0], flow_speed[1], flow_speed[2]);
 
-                flow_speed[i] -= 0.75 * std::pow(sphere_radius, 3) * translation_velocity[j] * delta(i, j) / (3.0 * std::pow(distance, 3));
-                flow_speed[i] += 0.75 * std::pow(sphere_radius, 3) * translation_velocity[j] * new_coords[i] * new_coords[j] / std::pow(distance, 5);
-            }
+        return flow_speed;
+    }
+
+    /**
+      * translating_flow_at for one sphere and n field points given as
+      * structure-of-arrays, e.g. every node of a visualisation grid. The
+      * outputs are overwritten. The points are split over n_threads threads
+      * (0 means one per hardware thread), but never into chunks of fewer
+      * than a few thousand, where starting the threads costs more than it
+      * saves.
+      */
+    inline void translating_flow_batch(const double* x, const double* y, const double* z, const size_t n,
+                                       const MathArray<double, 3>& sphere_position,
+                                       const MathArray<double, 3>& translation_velocity,
+                                       const double sphere_radius,
+                                       double* ux, double* uy, double* uz,
+                                       size_t n_threads = 0) {
+
+        constexpr size_t min_chunk = 4096;
+
+        const double cx = sphere_position[0];
+        const double cy = sphere_position[1];
+        const double cz = sphere_position[2];
+        const double Ux = translation_velocity[0];
+        const double Uy = translation_velocity[1];
+        const double Uz = translation_velocity[2];
+        const double stokeslet = 0.75 * sphere_radius;
+        const double dipole = 0.25 * sphere_radius * sphere_radius * sphere_radius;
+
+        if (n_threads == 0) {
+            n_threads = default_thread_count();
         }
+        n_threads = std::max<size_t>(1, std::min(n_threads, n / min_chunk));
 
-        return flow_speed + translation_velocity;
+        parallel_for(0, n, [&](const size_t begin, const size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                translating_flow_kernel(x[i] - cx, y[i] - cy, z[i] - cz,
+                                        Ux, Uy, Uz, stokeslet, dipole,
+                                        ux[i], uy[i], uz[i]);
+            }
+        }, n_threads);
     }
 
-    static double strain_tensor_shear(const size_t i, const size_t j, const double shear_rate) {
-        if ((i == 0 && j == 2) || (i == 2 && j == 0)) {
-            return shear_rate * 0.5;
-        } else {
-            return 0;
-        }
+    inline void translating_flow_batch(const VectorField& positions,
+                                       const MathArray<double, 3>& sphere_position,
+                                       const MathArray<double, 3>& translation_velocity,
+                                       const double sphere_radius,
+                                       VectorField& velocities,
+                                       const size_t n_threads = 0) {
+
+        velocities.resize(positions.size());
+
+        translating_flow_batch(positions.x().data(), positions.y().data(), positions.z().data(), positions.size(),
+                               sphere_position, translation_velocity, sphere_radius,
+                               velocities.x().data(), velocities.y().data(), velocities.z().data(),
+                               n_threads);
     }
 
-    static double stress_tensor_shear(const size_t i, const size_t j, const double shear_rate) {
-        if (i == 0 && j == 2) {
-            return shear_rate * 0.5;
-        } else if (i == 2 && j == 0) {
-            return -shear_rate * 0.5;
-        } else {
-            return 0;
+    /**
+      * Linear ambient flows u(x) = E.x + w x x, with E the (symmetric,
+      * traceless) rate of strain and w the rotation vector, i.e. half the
+      * vorticity. Each one knows how to apply E and w x to a vector; the
+      * sparse ones write that out so linear_flow_kernel only does the
+      * multiplies that aren't by zero, and GeneralLinearFlow does the full
+      * 3x3 product for anything else.
+      */
+    struct ShearFlow {
+        // (shear_rate * z, 0, 0)
+        double shear_rate;
+
+        void strain_dot(const double x, const double, const double z, double& ex, double& ey, double& ez) const noexcept {
+            ex = 0.5 * this->shear_rate * z;
+            ey = 0;
+            ez = 0.5 * this->shear_rate * x;
         }
-    }
 
-    static MathArray<double, 3> rotation_vector_shear(double shear_scaling) {
-        return MathArray<double, 3>{0, 0.5 * shear_scaling, 0};
-    }
+        void rotation_cross(const double x, const double, const double z, double& wx, double& wy, double& wz) const noexcept {
+            wx = 0.5 * this->shear_rate * z;
+            wy = 0;
+            wz = -0.5 * this->shear_rate * x;
+        }
 
-    // Assumes shear flow of form (az, 0, 0).
-    inline MathArray<double, 3> shear_flow_at(const MathArray<double, 3>& position,
-                                              const MathArray<double, 3>& sphere_position,
-                                              const double sphere_radius,
-                                              const double shear_rate) {
+        Tensor<double, 3, 3> strain_tensor() const noexcept {
+            const double e = 0.5 * this->shear_rate;
+            return Tensor<double, 3, 3>{0, 0, e, 0, 0, 0, e, 0, 0};
+        }
+
+        MathArray<double, 3> rotation_vector() const noexcept {
+            return MathArray<double, 3>{0, 0.5 * this->shear_rate, 0};
+        }
+    };
+
+    struct PlanarExtension {
+        // (strain_rate * x, -strain_rate * y, 0)
+        double strain_rate;
+
+        void strain_dot(const double x, const double y, const double, double& ex, double& ey, double& ez) const noexcept {
+            ex = this->strain_rate * x;
+            ey = -this->strain_rate * y;
+            ez = 0;
+        }
 
-        const MathArray<double, 3> new_coords = position - sphere_position;
-        const double distance = magnitude(new_coords);
+        void rotation_cross(const double, const double, const double, double& wx, double& wy, double& wz) const noexcept {
+            wx = wy = wz = 0;
+        }
 
-        const auto x = new_coords;
-        const auto r = distance;
-        const auto a = sphere_radius;
+        Tensor<double, 3, 3> strain_tensor() const noexcept {
+            return Tensor<double, 3, 3>{this->strain_rate, 0, 0, 0, -this->strain_rate, 0, 0, 0, 0};
+        }
 
-        if (distance < sphere_radius) {
-            return MathArray<double, 3>{0, 0, 0};
+        MathArray<double, 3> rotation_vector() const noexcept {
+            return MathArray<double, 3>{};
         }
+    };
 
-        MathArray<double, 3> flow_speed{0, 0, 0};
+    struct UniaxialExtension {
+        // (-strain_rate * x / 2, -strain_rate * y / 2, strain_rate * z), stretching along z.
+        double strain_rate;
 
-        for (int i = 0; i < 3; ++i) {
-            double term_1 = 0;
-            double term_2 = 0;
-            double term_3 = 0;
+        void strain_dot(const double x, const double y, const double z, double& ex, double& ey, double& ez) const noexcept {
+            ex = -0.5 * this->strain_rate * x;
+            ey = -0.5 * this->strain_rate * y;
+            ez = this->strain_rate * z;
+        }
 
-            for (int j = 0; j < 3; ++j) {
-                for (int k = 0; k < 3; ++k) {
-                    const double strain_tensor_value = strain_tensor_shear(j, k, shear_rate);
+        void rotation_cross(const double, const double, const double, double& wx, double& wy, double& wz) const noexcept {
+            wx = wy = wz = 0;
+        }
 
+        Tensor<double, 3, 3> strain_tensor() const noexcept {
+            const double e = this->strain_rate;
+            return Tensor<double, 3, 3>{-0.5 * e, 0, 0, 0, -0.5 * e, 0, 0, 0, e};
+        }
 
-                    if (strain_tensor_value != 0) {
-                        term_1 -= 2.5 * std::pow(a, 3) / std::pow(r, 5) * x[i] * x[j] * x[k] * strain_tensor_value;
+        MathArray<double, 3> rotation_vector() const noexcept {
+            return MathArray<double, 3>{};
+        }
+    };
 
-                        const double factor = 0.5 * std::pow(a / r, 5) * strain_tensor_value;
-                        term_2 -= factor * (delta(i, j) * x[k] + delta(i, k) * x[j]);
-                        term_3 += factor * 5 * x[i] * x[j] * x[k] / std::pow(r, 2);
-                    }
-                }
-            }
+    struct GeneralLinearFlow {
+        // Only the symmetric part of strain is meaningful; it isn't checked.
+        Tensor<double, 3, 3> strain;
+        MathArray<double, 3> rotation;
 
-            flow_speed[i] += term_1 + term_2 + term_3;
+        void strain_dot(const double x, const double y, const double z, double& ex, double& ey, double& ez) const noexcept {
+            const double* e = this->strain.data;
+            ex = e[0] * x + e[1] * y + e[2] * z;
+            ey = e[3] * x + e[4] * y + e[5] * z;
+            ez = e[6] * x + e[7] * y + e[8] * z;
         }
 
-        const MathArray<double, 3> rotation_vector = rotation_vector_shear(shear_rate);
-        flow_speed -= rotation_vector.cross(new_coords) * std::pow(sphere_radius / distance, 3);
+        void rotation_cross(const double x, const double y, const double z, double& wx, double& wy, double& wz) const noexcept {
+            const MathArray<double, 3>& w = this->rotation;
+            wx = w[1] * z - w[2] * y;
+            wy = w[2] * x - w[0] * z;
+            wz = w[0] * y - w[1] * x;
+        }
+
+        Tensor<double, 3, 3> strain_tensor() const noexcept {
+            return this->strain;
+        }
+
+        MathArray<double, 3> rotation_vector() const noexcept {
+            return this->rotation;
+        }
+    };
+
+    /**
+      * Flow at separation (dx, dy, dz) from a sphere of radius a sitting in
+      * the linear flow, field point at absolute position (px, py, pz). That's
+      * the strain disturbance
+      *     -5/2 a^3/r^5 x (x.E.x) - (a/r)^5 E.x + 5/2 a^5/r^7 x (x.E.x),
+      * the rotation disturbance -(a/r)^3 w x x, and translating_flow_kernel for
+      * the ambient velocity at the field point, U = E.p + w x p. Every power
+      * of r comes from one division. Zero inside the sphere.
+      */
+    template <class Flow>
+    inline void linear_flow_kernel(const Flow& flow,
+                                   const double dx, const double dy, const double dz,
+                                   const double px, const double py, const double pz,
+                                   const double sphere_radius,
+                                   double& ux, double& uy, double& uz) noexcept {
+
+        const double r_sq = dx * dx + dy * dy + dz * dz;
+        const double inv_r_sq = 1.0 / r_sq;
+        const double inv_r = std::sqrt(inv_r_sq);
+
+        const double a = sphere_radius;
+        const double a_3 = a * a * a;
+        const double a_3_r_3 = a_3 * inv_r * inv_r_sq;       // (a / r)^3
+        const double a_3_r_5 = a_3_r_3 * inv_r_sq;           // a^3 / r^5
+        const double a_5_r_5 = a_3_r_3 * a * a * inv_r_sq;   // (a / r)^5
+        const double a_5_r_7 = a_5_r_5 * inv_r_sq;           // a^5 / r^7
 
-        // What's the shearing in the sphere's rest frame?
-        flow_speed += translating_flow_at(position, sphere_position, MathArray<double, 3>{shear_rate * position[2]}, sphere_radius);
+        double ex, ey, ez;
+        double wx, wy, wz;
+        flow.strain_dot(dx, dy, dz, ex, ey, ez);
+        flow.rotation_cross(dx, dy, dz, wx, wy, wz);
+
+        const double xEx = dx * ex + dy * ey + dz * ez;
+        const double radial = (2.5 * a_5_r_7 - 2.5 * a_3_r_5) * xEx;
+
+        double flow_x = radial * dx - a_5_r_5 * ex - a_3_r_3 * wx;
+        double flow_y = radial * dy - a_5_r_5 * ey - a_3_r_3 * wy;
+        double flow_z = radial * dz - a_5_r_5 * ez - a_3_r_3 * wz;
+
+        double Ux, Uy, Uz;
+        double rotation_x, rotation_y, rotation_z;
+        flow.strain_dot(px, py, pz, Ux, Uy, Uz);
+        flow.rotation_cross(px, py, pz, rotation_x, rotation_y, rotation_z);
+        Ux += rotation_x;
+        Uy += rotation_y;
+        Uz += rotation_z;
+
+        double translating_x, translating_y, translating_z;
+        translating_flow_kernel(dx, dy, dz, Ux, Uy, Uz, 0.75 * a, 0.25 * a_3,
+                                translating_x, translating_y, translating_z);
+
+        flow_x += translating_x;
+        flow_y += translating_y;
+        flow_z += translating_z;
+
+        const bool outside = r_sq >= a * a;
+        ux = outside ? flow_x : 0;
+        uy = outside ? flow_y : 0;
+        uz = outside ? flow_z : 0;
+    }
+
+    template <class Flow>
+    inline MathArray<double, 3> linear_flow_at(const MathArray<double, 3>& position,
+                                               const MathArray<double, 3>& sphere_position,
+                                               const double sphere_radius,
+                                               const Flow& flow) {
+
+        MathArray<double, 3> flow_speed{};
+
+        linear_flow_kernel(flow,
+                           position[0] - sphere_position[0], position[1] - sphere_position[1], position[2] - sphere_position[2],
+                           position[0], position[1], position[2],
+                           sphere_radius,
+                           flow_speed[0], flow_speed[1], flow_speed[2]);
 
         return flow_speed;
     }
 
+    inline MathArray<double, 3> linear_flow_at(const MathArray<double, 3>& position,
+                                               const MathArray<double, 3>& sphere_position,
+                                               const double sphere_radius,
+                                               const Tensor<double, 3, 3>& strain,
+                                               const MathArray<double, 3>& rotation) {
+
+        return linear_flow_at(position, sphere_position, sphere_radius, GeneralLinearFlow{strain, rotation});
+    }
+
+    /**
+      * linear_flow_at for n field points given as structure-of-arrays. The
+      * outputs are overwritten.
+      */
+    template <class Flow>
+    inline void linear_flow_batch(const Flow& flow,
+                                  const double* x, const double* y, const double* z, const size_t n,
+                                  const MathArray<double, 3>& sphere_position, const double sphere_radius,
+                                  double* ux, double* uy, double* uz) noexcept {
+
+        for (size_t i = 0; i < n; ++i) {
+            linear_flow_kernel(flow,
+                               x[i] - sphere_position[0], y[i] - sphere_position[1], z[i] - sphere_position[2],
+                               x[i], y[i], z[i],
+                               sphere_radius,
+                               ux[i], uy[i], uz[i]);
+        }
+    }
+
+    template <class Flow>
+    inline void linear_flow_batch(const Flow& flow,
+                                  const VectorField& positions,
+                                  const MathArray<double, 3>& sphere_position, const double sphere_radius,
+                                  VectorField& velocities) {
+
+        velocities.resize(positions.size());
+
+        linear_flow_batch(flow, positions.x().data(), positions.y().data(), positions.z().data(), positions.size(),
+                          sphere_position, sphere_radius,
+                          velocities.x().data(), velocities.y().data(), velocities.z().data());
+    }
+
+    // Assumes shear flow of form (az, 0, 0).
+    inline MathArray<double, 3> shear_flow_at(const MathArray<double, 3>& position,
+                                              const MathArray<double, 3>& sphere_position,
+                                              const double sphere_radius,
+                                              const double shear_rate) {
+
+        return linear_flow_at(position, sphere_position, sphere_radius, ShearFlow{shear_rate});
+    }
+
+    inline void shear_flow_batch(const double* x, const double* y, const double* z, const size_t n,
+                                 const MathArray<double, 3>& sphere_position,
+                                 const double sphere_radius, const double shear_rate,
+                                 double* ux, double* uy, double* uz) noexcept {
+
+        linear_flow_batch(ShearFlow{shear_rate}, x, y, z, n, sphere_position, sphere_radius, ux, uy, uz);
+    }
+
+    inline void shear_flow_batch(const VectorField& positions,
+                                 const MathArray<double, 3>& sphere_position,
+                                 const double sphere_radius, const double shear_rate,
+                                 VectorField& velocities) {
+
+        linear_flow_batch(ShearFlow{shear_rate}, positions, sphere_position, sphere_radius, velocities);
+    }
+
     inline MathArray<double, 3> stokes_drag(const MathArray<double, 3>& velocity, const double shear_viscosity, const double radius) {
         return (6 * M_PI * shear_viscosity * radius) * velocity;
     }
 
+    /**
+      * Bulk version of stokes_drag over one component of n velocities, e.g. one
+      * of the component spans of a ParticleSet's velocities. Writes the drag
+      * into the matching component buffer.
+      */
+    inline void stokes_drag(const double* velocity, double* drag, const size_t n, const double shear_viscosity, const double radius) noexcept {
+        const double drag_coefficient = 6 * M_PI * shear_viscosity * radius;
+
+        for (size_t i = 0; i < n; ++i) {
+            drag[i] = drag_coefficient * velocity[i];
+        }
+    }
+
     inline double calculate_divergence(const std::function<MathArray<double, 3>(MathArray<double, 3>)>& f, const MathArray<double, 3>& position, const double dx=1e-10) {
         double divergence = 0;
 
@@ -189,4 +459,625 @@ namespace dav {
 
         return blake_tensor * force;
     }
+
+    /**
+      * Adds the flow at (tx, ty, tz) due to the Blake point forces at indices
+      * [begin, end) of the given structure-of-arrays buffers. This is
+      * blake_tensor_at contracted with the force and expanded by hand so there
+      * are no std::pow calls and no 3x3 loops; the loop body is straight-line
+      * arithmetic that the compiler can vectorise over j (GCC needs
+      * -fno-math-errno, or -ffast-math, before it will vectorise the square
+      * roots). Leaves out the 1/(8 pi eta) prefactor, which the callers apply
+      * once at the end.
+      */
+    inline void blake_flow_accumulate(const double tx, const double ty, const double tz,
+                                      const double* x, const double* y, const double* z,
+                                      const double* fx, const double* fy, const double* fz,
+                                      const size_t begin, const size_t end,
+                                      double& ux, double& uy, double& uz) noexcept {
+
+        double sum_x = 0;
+        double sum_y = 0;
+        double sum_z = 0;
+
+        for (size_t j = begin; j < end; ++j) {
+            const double h = z[j];
+            const double dx = tx - x[j];
+            const double dy = ty - y[j];
+            const double dz = tz - h;
+            const double Rz = tz + h;
+
+            const double inv_r = 1.0 / std::sqrt(dx * dx + dy * dy + dz * dz);
+            const double inv_r3 = inv_r * inv_r * inv_r;
+            const double inv_R = 1.0 / std::sqrt(dx * dx + dy * dy + Rz * Rz);
+            const double inv_R3 = inv_R * inv_R * inv_R;
+            const double inv_R5 = inv_R3 * inv_R * inv_R;
+
+            // Projections onto the real (r) and image (R) separations. The
+            // primed force is the force with its z component flipped, which is
+            // what the (j == 2 ? -1 : 1) factor in blake_tensor_at does.
+            const double r_dot_f = dx * fx[j] + dy * fy[j] + dz * fz[j];
+            const double R_dot_f = dx * fx[j] + dy * fy[j] + Rz * fz[j];
+            const double R_dot_fp = dx * fx[j] + dy * fy[j] - Rz * fz[j];
+
+            // Stokeslet minus image Stokeslet.
+            const double stokeslet_x = fx[j] * (inv_r - inv_R) + dx * (r_dot_f * inv_r3 - R_dot_f * inv_R3);
+            const double stokeslet_y = fy[j] * (inv_r - inv_R) + dy * (r_dot_f * inv_r3 - R_dot_f * inv_R3);
+            const double stokeslet_z = fz[j] * (inv_r - inv_R) + dz * r_dot_f * inv_r3 - Rz * R_dot_f * inv_R3;
+
+            // Source doublet and Stokeslet doublet at the image point.
+            const double doublet_common = 3 * tz * R_dot_fp * inv_R5 + fz[j] * inv_R3;
+            const double doublet_x = -tz * fx[j] * inv_R3 + dx * doublet_common;
+            const double doublet_y = -tz * fy[j] * inv_R3 + dy * doublet_common;
+            const double doublet_z = tz * fz[j] * inv_R3 + R_dot_fp * inv_R3 + Rz * doublet_common;
+
+            sum_x += stokeslet_x + 2 * h * doublet_x;
+            sum_y += stokeslet_y + 2 * h * doublet_y;
+            sum_z += stokeslet_z + 2 * h * doublet_z;
+        }
+
+        ux += sum_x;
+        uy += sum_y;
+        uz += sum_z;
+    }
+
+    /**
+      * Free-space counterpart of blake_flow_accumulate: adds the Stokeslet
+      * flow f / r + r (r . f) / r^3 at (tx, ty, tz) due to the point forces at
+      * indices [begin, end), leaving out the 1/(8 pi eta) prefactor.
+      */
+    inline void stokeslet_flow_accumulate(const double tx, const double ty, const double tz,
+                                          const double* x, const double* y, const double* z,
+                                          const double* fx, const double* fy, const double* fz,
+                                          const size_t begin, const size_t end,
+                                          double& ux, double& uy, double& uz) noexcept {
+
+        double sum_x = 0;
+        double sum_y = 0;
+        double sum_z = 0;
+
+        for (size_t j = begin; j < end; ++j) {
+            const double dx = tx - x[j];
+            const double dy = ty - y[j];
+            const double dz = tz - z[j];
+
+            const double inv_r = 1.0 / std::sqrt(dx * dx + dy * dy + dz * dz);
+            const double r_dot_f_over_r3 = (dx * fx[j] + dy * fy[j] + dz * fz[j]) * inv_r * inv_r * inv_r;
+
+            sum_x += fx[j] * inv_r + dx * r_dot_f_over_r3;
+            sum_y += fy[j] * inv_r + dy * r_dot_f_over_r3;
+            sum_z += fz[j] * inv_r + dz * r_dot_f_over_r3;
+        }
+
+        ux += sum_x;
+        uy += sum_y;
+        uz += sum_z;
+    }
+
+    /**
+      * Flow at every particle due to the Blake point forces on every other
+      * particle, i.e. u_i = sum_{j != i} blake_tensor_at(x_i, x_j) F_j. All
+      * buffers are structure-of-arrays with n entries; the outputs are
+      * overwritten. The wall is at z = 0, same as blake_tensor_at.
+      */
+    inline void blake_flow_batch(const double* x, const double* y, const double* z,
+                                 const double* fx, const double* fy, const double* fz,
+                                 const size_t n, const double shear_viscosity,
+                                 double* ux, double* uy, double* uz) noexcept {
+
+        const double prefactor = 1.0 / (8 * M_PI * shear_viscosity);
+
+        for (size_t i = 0; i < n; ++i) {
+            double u_x = 0;
+            double u_y = 0;
+            double u_z = 0;
+
+            // Split around i rather than branching on j == i, so the inner
+            // loop stays branch-free.
+            blake_flow_accumulate(x[i], y[i], z[i], x, y, z, fx, fy, fz, 0, i, u_x, u_y, u_z);
+            blake_flow_accumulate(x[i], y[i], z[i], x, y, z, fx, fy, fz, i + 1, n, u_x, u_y, u_z);
+
+            ux[i] = prefactor * u_x;
+            uy[i] = prefactor * u_y;
+            uz[i] = prefactor * u_z;
+        }
+    }
+
+    /**
+      * Flow at n_targets field points due to n_sources Blake point forces. Use
+      * this one when the field points are not the particles themselves, e.g.
+      * when sampling the flow on a grid. The outputs are overwritten.
+      */
+    inline void blake_flow_batch(const double* target_x, const double* target_y, const double* target_z,
+                                 const size_t n_targets,
+                                 const double* x, const double* y, const double* z,
+                                 const double* fx, const double* fy, const double* fz,
+                                 const size_t n_sources, const double shear_viscosity,
+                                 double* ux, double* uy, double* uz) noexcept {
+
+        const double prefactor = 1.0 / (8 * M_PI * shear_viscosity);
+
+        for (size_t i = 0; i < n_targets; ++i) {
+            double u_x = 0;
+            double u_y = 0;
+            double u_z = 0;
+
+            blake_flow_accumulate(target_x[i], target_y[i], target_z[i], x, y, z, fx, fy, fz, 0, n_sources, u_x, u_y, u_z);
+
+            ux[i] = prefactor * u_x;
+            uy[i] = prefactor * u_y;
+            uz[i] = prefactor * u_z;
+        }
+    }
+
+
+    /**
+      * Rotne-Prager-Yamakawa mobility between two spheres of the same radius
+      * in unbounded fluid: the velocity of the sphere at position due to a
+      * force on the sphere at source_position is this tensor times the force.
+      * Spheres closer than 2a use the overlapping form, which keeps the whole
+      * mobility matrix positive definite, and coincident positions give the
+      * self mobility I / (6 pi eta a).
+      */
+    inline Tensor<double, 3, 3> rpy_tensor_at(const MathArray<double, 3>& position,
+                                              const MathArray<double, 3>& source_position,
+                                              const double radius,
+                                              const double shear_viscosity) {
+
+        const MathArray<double, 3> r = position - source_position;
+        const double r_sq = magnitude_sq(r);
+        const double r_mag = std::sqrt(r_sq);
+        const double inv_radius = 1.0 / radius;
+        const double self_mobility = inv_radius / (6 * M_PI * shear_viscosity);
+
+        // The tensor is identity_coefficient * I + outer_coefficient * r r^T.
+        double identity_coefficient;
+        double outer_coefficient;
+
+        if (r_mag >= 2 * radius) {
+            // 1 / (8 pi eta r) written in terms of the self mobility.
+            const double inv_r = 1.0 / r_mag;
+            const double prefactor = 0.75 * self_mobility * radius * inv_r;
+            const double radius_ratio_sq = radius * radius * inv_r * inv_r;
+
+            identity_coefficient = prefactor * (1 + 2.0 / 3.0 * radius_ratio_sq);
+            outer_coefficient = prefactor * (1 - 2 * radius_ratio_sq) * inv_r * inv_r;
+        } else {
+            identity_coefficient = self_mobility * (1 - 9.0 / 32.0 * r_mag * inv_radius);
+            outer_coefficient = r_sq > 0 ? self_mobility * 3.0 / 32.0 * inv_radius / r_mag : 0;
+        }
+
+        Tensor<double, 3, 3> rpy_tensor{};
+
+        for (size_t i = 0; i < 3; ++i) {
+            for (size_t j = 0; j < 3; ++j) {
+                rpy_tensor[{i, j}] = identity_coefficient * delta(i, j) + outer_coefficient * r[i] * r[j];
+            }
+        }
+
+        return rpy_tensor;
+    }
+
+    /**
+      * What has to be added to rpy_tensor_at to account for a no-slip wall at
+      * z = 0, from Swan and Brady, "Simulation of hydrodynamically interacting
+      * particles near a no-slip boundary", Phys. Fluids 19, 113306 (2007). For
+      * coincident positions this is the self mobility correction, otherwise it
+      * is the pair correction, built from the image of the source sphere. The
+      * pair block for the other order is the transpose. Only meaningful with
+      * both spheres at least a radius above the wall. For small spheres the
+      * total tends to blake_tensor_at.
+      */
+    inline Tensor<double, 3, 3> rpy_wall_correction_at(const MathArray<double, 3>& position,
+                                                       const MathArray<double, 3>& source_position,
+                                                       const double radius,
+                                                       const double shear_viscosity) {
+
+        Tensor<double, 3, 3> correction{};
+
+        if (all(position == source_position)) {
+            const double self_mobility = 1.0 / (6 * M_PI * shear_viscosity * radius);
+            const double inv_h = radius / position[2];
+            const double inv_h3 = inv_h * inv_h * inv_h;
+            const double inv_h5 = inv_h3 * inv_h * inv_h;
+
+            const double parallel = -(9 * inv_h - 2 * inv_h3 + inv_h5) / 16;
+            const double perpendicular = -(9 * inv_h - 4 * inv_h3 + inv_h5) / 8;
+
+            correction[{0, 0}] = self_mobility * parallel;
+            correction[{1, 1}] = self_mobility * parallel;
+            correction[{2, 2}] = self_mobility * perpendicular;
+
+            return correction;
+        }
+
+        // Everything in units of the radius, relative to the source's image.
+        const double inv_radius = 1.0 / radius;
+        const MathArray<double, 3> R{
+            (position[0] - source_position[0]) * inv_radius,
+            (position[1] - source_position[1]) * inv_radius,
+            (position[2] + source_position[2]) * inv_radius
+        };
+        const double h_hat = source_position[2] / (position[2] + source_position[2]);
+
+        const double inv_R = 1.0 / magnitude(R);
+        const double inv_R3 = inv_R * inv_R * inv_R;
+        const double inv_R5 = inv_R3 * inv_R * inv_R;
+        const MathArray<double, 3> e = R * inv_R;
+        const double ez_sq = e[2] * e[2];
+
+        const double prefactor = inv_radius / (8 * M_PI * shear_viscosity);
+
+        // Coefficients of I, e e^T, e z^T, z e^T and z z^T respectively.
+        const double fact_1 = -(3 * (1 + 2 * h_hat * (1 - h_hat) * ez_sq) * inv_R + 2 * (1 - 3 * ez_sq) * inv_R3 - 2 * (1 - 5 * ez_sq) * inv_R5) * (1.0 / 3.0);
+        const double fact_2 = -(3 * (1 - 6 * h_hat * (1 - h_hat) * ez_sq) * inv_R - 6 * (1 - 5 * ez_sq) * inv_R3 + 10 * (1 - 7 * ez_sq) * inv_R5) * (1.0 / 3.0);
+        const double fact_3 = e[2] * (3 * h_hat * (1 - 6 * (1 - h_hat) * ez_sq) * inv_R - 6 * (1 - 5 * ez_sq) * inv_R3 + 10 * (2 - 7 * ez_sq) * inv_R5) * (2.0 / 3.0);
+        const double fact_4 = e[2] * (3 * h_hat * inv_R - 10 * inv_R5) * (2.0 / 3.0);
+        const double fact_5 = -(3 * h_hat * h_hat * ez_sq * inv_R + 3 * ez_sq * inv_R3 + (2 - 15 * ez_sq) * inv_R5) * (4.0 / 3.0);
+
+        for (size_t i = 0; i < 3; ++i) {
+            for (size_t j = 0; j < 3; ++j) {
+                double value = fact_1 * delta(i, j) + fact_2 * e[i] * e[j];
+
+                if (j == 2) {
+                    value += fact_3 * e[i];
+                }
+
+                if (i == 2) {
+                    value += fact_4 * e[j];
+                }
+
+                if (i == 2 && j == 2) {
+                    value += fact_5;
+                }
+
+                correction[{i, j}] = prefactor * value;
+            }
+        }
+
+        return correction;
+    }
+
+    inline Tensor<double, 3, 3> rpy_wall_tensor_at(const MathArray<double, 3>& position,
+                                                   const MathArray<double, 3>& source_position,
+                                                   const double radius,
+                                                   const double shear_viscosity) {
+
+        return rpy_tensor_at(position, source_position, radius, shear_viscosity)
+            + rpy_wall_correction_at(position, source_position, radius, shear_viscosity);
+    }
+
+
+    /**
+      * Pair mobility kernels for the assembly below: call operator gives the
+      * 3x3 block coupling the sphere at source_position to the one at
+      * position, including the self block when they're the same point.
+      */
+    struct RPYMobility {
+        double radius;
+        double shear_viscosity;
+
+        Tensor<double, 3, 3> operator()(const MathArray<double, 3>& position, const MathArray<double, 3>& source_position) const {
+            return rpy_tensor_at(position, source_position, this->radius, this->shear_viscosity);
+        }
+    };
+
+    struct RPYWallMobility {
+        double radius;
+        double shear_viscosity;
+
+        Tensor<double, 3, 3> operator()(const MathArray<double, 3>& position, const MathArray<double, 3>& source_position) const {
+            return rpy_wall_tensor_at(position, source_position, this->radius, this->shear_viscosity);
+        }
+    };
+
+    /**
+      * Blake point-force mobility above a no-slip wall at z = 0, for point
+      * particles with the given radius. The radius only sets the self block,
+      * which is the free-space Stokes mobility 1 / (6 pi eta a); the wall's
+      * effect on a particle's own motion is left out.
+      */
+    struct BlakeMobility {
+        double radius;
+        double shear_viscosity;
+
+        Tensor<double, 3, 3> operator()(const MathArray<double, 3>& position, const MathArray<double, 3>& source_position) const {
+            if (all(position == source_position)) {
+                const double self_mobility = 1.0 / (6 * M_PI * this->shear_viscosity * this->radius);
+
+                return Tensor<double, 3, 3>{self_mobility, 0, 0, 0, self_mobility, 0, 0, 0, self_mobility};
+            }
+
+            return blake_tensor_at(position, source_position, this->shear_viscosity);
+        }
+    };
+
+    /**
+      * Fill the dense 3n x 3n mobility matrix (row-major, so the velocity of
+      * particle i is rows 3i to 3i + 2) for n particles. The kernel must give
+      * block (j, i) as the transpose of block (i, j), which all the RPY ones
+      * do, so only one triangle of blocks is evaluated.
+      *
+      * The work goes in square tiles of tile_size particles. Each tile is
+      * built in a small local buffer, then written out row by row to its
+      * place and, transposed, to its mirror image, so every write to the big
+      * matrix is a contiguous run. Scattering each block and its transpose
+      * straight into the matrix hits a different row for every three values
+      * and ends up slower than evaluating every block twice.
+      */
+    template <class Kernel, size_t tile_size = 16>
+    inline void assemble_mobility_matrix(const Kernel& kernel,
+                                         const double* x, const double* y, const double* z,
+                                         const size_t n, double* matrix) {
+
+        constexpr size_t tile_width = 3 * tile_size;
+        const size_t stride = 3 * n;
+
+        double tile[tile_width * tile_width];
+
+        for (size_t tile_i = 0; tile_i < n; tile_i += tile_size) {
+            const size_t rows = 3 * (std::min(tile_i + tile_size, n) - tile_i);
+
+            for (size_t tile_j = tile_i; tile_j < n; tile_j += tile_size) {
+                const size_t columns = 3 * (std::min(tile_j + tile_size, n) - tile_j);
+                const bool diagonal = tile_i == tile_j;
+
+                for (size_t i = 0; i < rows / 3; ++i) {
+                    const MathArray<double, 3> position{x[tile_i + i], y[tile_i + i], z[tile_i + i]};
+
+                    // On the diagonal tile, only the upper triangle is needed.
+                    for (size_t j = (diagonal ? i : 0); j < columns / 3; ++j) {
+                        const size_t source = tile_j + j;
+                        const Tensor<double, 3, 3> block = kernel(position, MathArray<double, 3>{x[source], y[source], z[source]});
+
+                        for (size_t a = 0; a < 3; ++a) {
+                            for (size_t b = 0; b < 3; ++b) {
+                                tile[(3 * i + a) * tile_width + 3 * j + b] = block[{a, b}];
+                            }
+                        }
+                    }
+                }
+
+                if (diagonal) {
+                    for (size_t row = 0; row < rows; ++row) {
+                        for (size_t column = 0; column < 3 * (row / 3); ++column) {
+                            tile[row * tile_width + column] = tile[column * tile_width + row];
+                        }
+                    }
+                }
+
+                for (size_t row = 0; row < rows; ++row) {
+                    std::copy(tile + row * tile_width, tile + row * tile_width + columns, matrix + (3 * tile_i + row) * stride + 3 * tile_j);
+                }
+
+                if (!diagonal) {
+                    for (size_t column = 0; column < columns; ++column) {
+                        double* out = matrix + (3 * tile_j + column) * stride + 3 * tile_i;
+
+                        for (size_t row = 0; row < rows; ++row) {
+                            out[row] = tile[row * tile_width + column];
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    template <class Kernel, size_t tile_size = 16>
+    inline std::vector<double> assemble_mobility_matrix(const Kernel& kernel, const VectorField& positions) {
+        const size_t n = positions.size();
+        std::vector<double> matrix(9 * n * n);
+
+        assemble_mobility_matrix<Kernel, tile_size>(kernel, positions.x().data(), positions.y().data(), positions.z().data(), n, matrix.data());
+
+        return matrix;
+    }
+
+
+    /**
+      * Adds the flow at (tx, ty, tz) due to the forces on the sources at
+      * indices [begin, end), i.e. sum_j kernel(target, x_j) F_j. This is the
+      * generic version that goes through the kernel's 3x3 blocks; kernels
+      * with a faster contracted form overload it.
+      */
+    template <class Kernel>
+    inline void mobility_accumulate(const Kernel& kernel,
+                                    const double tx, const double ty, const double tz,
+                                    const double* x, const double* y, const double* z,
+                                    const double* fx, const double* fy, const double* fz,
+                                    const size_t begin, const size_t end,
+                                    double& ux, double& uy, double& uz) {
+
+        const MathArray<double, 3> target{tx, ty, tz};
+
+        for (size_t j = begin; j < end; ++j) {
+            const MathArray<double, 3> u = kernel(target, MathArray<double, 3>{x[j], y[j], z[j]}) * MathArray<double, 3>{fx[j], fy[j], fz[j]};
+
+            ux += u[0];
+            uy += u[1];
+            uz += u[2];
+        }
+    }
+
+    inline void mobility_accumulate(const BlakeMobility& kernel,
+                                    const double tx, const double ty, const double tz,
+                                    const double* x, const double* y, const double* z,
+                                    const double* fx, const double* fy, const double* fz,
+                                    const size_t begin, const size_t end,
+                                    double& ux, double& uy, double& uz) noexcept {
+
+        double sum_x = 0;
+        double sum_y = 0;
+        double sum_z = 0;
+
+        blake_flow_accumulate(tx, ty, tz, x, y, z, fx, fy, fz, begin, end, sum_x, sum_y, sum_z);
+
+        const double prefactor = 1.0 / (8 * M_PI * kernel.shear_viscosity);
+
+        ux += prefactor * sum_x;
+        uy += prefactor * sum_y;
+        uz += prefactor * sum_z;
+    }
+
+    /**
+      * Matrix-free mobility operator: u = M F for the mobility matrix that
+      * assemble_mobility_matrix would build for the same kernel, but worked
+      * out pair by pair on every call, so memory is O(N) rather than O(N^2).
+      *
+      * The targets are shared out between threads with parallel_for. Each
+      * thread walks the sources in tiles of source_tile particles (which,
+      * with their forces, fit comfortably in L1) and runs all of its targets
+      * against one tile before moving to the next. The self block of each
+      * particle is added separately, so the pair loops never branch on j == i.
+      *
+      * Vectors come in two layouts: structure-of-arrays VectorFields, or flat
+      * 3N arrays interleaved as (x_0, y_0, z_0, x_1, ...), which matches the
+      * rows of the assembled matrix and is what the iterative solvers use.
+      *
+      * parallel_for starts and joins its threads on every product, which
+      * costs tens of microseconds a call. That's noise for large N, but for
+      * small systems where a solver makes dozens of products a step, pass
+      * n_threads = 1: then a product starts no threads and allocates nothing.
+      * The interleaved apply keeps scratch in the operator, so one operator
+      * mustn't be applied from several threads at once.
+      */
+    template <class Kernel>
+    class MobilityOperator {
+
+    public:
+        static constexpr size_t source_tile = 256;
+
+        MobilityOperator(const Kernel& kernel, const VectorField& positions, const size_t n_threads = 0)
+        : kernel(kernel)
+        , positions(positions)
+        , n_threads(n_threads) {}
+
+        /**
+          * Number of rows (and columns) of the operator, i.e. 3N.
+          */
+        size_t dimension() const noexcept {
+            return 3 * this->size();
+        }
+
+        size_t size() const noexcept {
+            return this->positions.size();
+        }
+
+        const VectorField& get_positions() const noexcept {
+            return this->positions;
+        }
+
+        /**
+          * Move the particles. The number of them can change too.
+          */
+        void set_positions(const VectorField& new_positions) {
+            this->positions = new_positions;
+        }
+
+        const Kernel& get_kernel() const noexcept {
+            return this->kernel;
+        }
+
+        /**
+          * Velocities due to forces given as structure-of-arrays buffers with
+          * size() entries each. The outputs are overwritten and mustn't alias
+          * the forces.
+          */
+        void apply(const double* fx, const double* fy, const double* fz,
+                   double* ux, double* uy, double* uz) const {
+
+            const size_t n = this->size();
+            const double* x = this->positions.x().data();
+            const double* y = this->positions.y().data();
+            const double* z = this->positions.z().data();
+
+            parallel_for(0, n, [&](const size_t target_begin, const size_t target_end) {
+                for (size_t i = target_begin; i < target_end; ++i) {
+                    const MathArray<double, 3> self = this->kernel(this->positions[i].get(), this->positions[i].get()) * MathArray<double, 3>{fx[i], fy[i], fz[i]};
+
+                    ux[i] = self[0];
+                    uy[i] = self[1];
+                    uz[i] = self[2];
+                }
+
+                for (size_t tile_begin = 0; tile_begin < n; tile_begin += source_tile) {
+                    const size_t tile_end = std::min(tile_begin + source_tile, n);
+
+                    for (size_t i = target_begin; i < target_end; ++i) {
+                        // Split the tile around i, if it's in there.
+                        const size_t skip_begin = std::min(std::max(i, tile_begin), tile_end);
+                        const size_t skip_end = std::min(std::max(i + 1, tile_begin), tile_end);
+
+                        mobility_accumulate(this->kernel, x[i], y[i], z[i], x, y, z, fx, fy, fz, tile_begin, skip_begin, ux[i], uy[i], uz[i]);
+                        mobility_accumulate(this->kernel, x[i], y[i], z[i], x, y, z, fx, fy, fz, skip_end, tile_end, ux[i], uy[i], uz[i]);
+                    }
+                }
+            }, this->n_threads);
+        }
+
+        void apply(const VectorField& forces, VectorField& velocities) const {
+            if (forces.size() != this->size()) {
+                throw std::invalid_argument("Number of forces doesn't match the number of particles");
+            }
+
+            velocities.resize(this->size());
+
+            this->apply(forces.x().data(), forces.y().data(), forces.z().data(),
+                        velocities.x().data(), velocities.y().data(), velocities.z().data());
+        }
+
+        /**
+          * u = M F for flat interleaved vectors of dimension() entries. The
+          * output is overwritten and mustn't alias the input. The vectors are
+          * split into SoA scratch kept by the operator, so after the first
+          * call at a given size this allocates nothing of its own.
+          */
+        void apply(const double* force, double* velocity) const {
+            const size_t n = this->size();
+            this->force_scratch.resize(n);
+            this->velocity_scratch.resize(n);
+
+            double* fx = this->force_scratch.x().data();
+            double* fy = this->force_scratch.y().data();
+            double* fz = this->force_scratch.z().data();
+
+            for (size_t i = 0; i < n; ++i) {
+                fx[i] = force[3 * i];
+                fy[i] = force[3 * i + 1];
+                fz[i] = force[3 * i + 2];
+            }
+
+            double* ux = this->velocity_scratch.x().data();
+            double* uy = this->velocity_scratch.y().data();
+            double* uz = this->velocity_scratch.z().data();
+
+            this->apply(fx, fy, fz, ux, uy, uz);
+
+            for (size_t i = 0; i < n; ++i) {
+                velocity[3 * i] = ux[i];
+                velocity[3 * i + 1] = uy[i];
+                velocity[3 * i + 2] = uz[i];
+            }
+        }
+
+        std::vector<double> operator()(const std::vector<double>& force) const {
+            if (force.size() != this->dimension()) {
+                throw std::invalid_argument("Force vector doesn't match the operator's dimension");
+            }
+
+            std::vector<double> velocity(this->dimension());
+            this->apply(force.data(), velocity.data());
+
+            return velocity;
+        }
+
+    private:
+        Kernel kernel;
+        VectorField positions;
+        size_t n_threads;
+
+        // Scratch for the interleaved apply.
+        mutable VectorField force_scratch;
+        mutable VectorField velocity_scratch;
+    };
 }
@@ -0,0 +1,381 @@
+#pragma once
+
+#include "randomutils.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace dav {
+    /**
+      * Krylov approximation to sqrt(M) w for a symmetric positive definite M
+      * that's only available as a product, e.g. a MobilityOperator. This is
+      * what correlated Brownian displacements need each step:
+      * sqrt(2 kT dt) sqrt(M) W, without the O(N^3) of a Cholesky factor.
+      *
+      * k steps of Lanczos build an orthonormal basis V_k of the Krylov space
+      * of w and a tridiagonal T_k = V_k^T M V_k, and then
+      *     sqrt(M) w ~ |w| V_k sqrt(T_k) e_1,
+      * with the small square root done by diagonalising T_k. Iterations
+      * stop once adding a step changes the estimate by less than tolerance
+      * relative to its size, which usually takes tens of products even for
+      * large N since the mobility's spectrum is fairly narrow.
+      *
+      * The sampler's own workspace is allocated in the constructor for a
+      * fixed dimension and iteration cap, so apply and sample allocate
+      * nothing themselves; whether a whole step does depends on the product.
+      * MobilityOperator's interleaved apply only stays allocation free with
+      * n_threads = 1, since parallel_for starts threads on every call. One
+      * LanczosSqrt per thread: the workspace isn't shared safely.
+      */
+    class LanczosSqrt {
+
+    public:
+        LanczosSqrt(const size_t dimension, const size_t max_iterations = 100, const double tolerance = 1e-6)
+        : n(dimension)
+        , max_steps(std::min(max_iterations, dimension))
+        , tolerance(tolerance)
+        , basis((max_steps + 1) * dimension)
+        , product(dimension)
+        , noise(dimension)
+        , alpha(max_steps)
+        , beta(max_steps)
+        , diagonal(max_steps)
+        , off_diagonal(max_steps)
+        , eigenvectors(max_steps * max_steps)
+        , coefficients(max_steps)
+        , previous_coefficients(max_steps) {
+
+            if (dimension == 0 || max_iterations == 0) {
+                throw std::invalid_argument("LanczosSqrt needs a non-zero dimension and iteration count");
+            }
+
+            if (!(tolerance > 0)) {
+                throw std::invalid_argument("LanczosSqrt tolerance must be positive");
+            }
+        }
+
+        size_t dimension() const noexcept {
+            return this->n;
+        }
+
+        size_t max_iterations() const noexcept {
+            return this->max_steps;
+        }
+
+        double get_tolerance() const noexcept {
+            return this->tolerance;
+        }
+
+        void set_tolerance(const double tolerance) {
+            if (!(tolerance > 0)) {
+                throw std::invalid_argument("LanczosSqrt tolerance must be positive");
+            }
+
+            this->tolerance = tolerance;
+        }
+
+        // Number of products the last apply took, and whether it got down to
+        // the tolerance before running out of iterations.
+        size_t iterations() const noexcept {
+            return this->last_iterations;
+        }
+
+        bool converged() const noexcept {
+            return this->last_converged;
+        }
+
+        /**
+          * out = sqrt(M) w, where multiply(in, out) sets out = M in for
+          * vectors of length dimension(). out mustn't alias w. Returns the
+          * number of products used.
+          */
+        template <class Operator>
+        size_t apply(Operator&& multiply, const double* w, double* out) {
+            const size_t n = this->n;
+
+            double norm = 0;
+            for (size_t i = 0; i < n; ++i) {
+                norm += w[i] * w[i];
+            }
+            norm = std::sqrt(norm);
+
+            this->last_iterations = 0;
+            this->last_converged = true;
+
+            if (norm == 0) {
+                std::fill(out, out + n, 0.0);
+                return 0;
+            }
+
+            double* const first = this->basis.data();
+            for (size_t i = 0; i < n; ++i) {
+                first[i] = w[i] / norm;
+            }
+
+            size_t steps = 0;
+            double largest_alpha = 0;
+            this->last_converged = false;
+
+            while (steps < this->max_steps) {
+                double* const v = this->vector(steps);
+                double* const z = this->product.data();
+
+                multiply(static_cast<const double*>(v), z);
+
+                double a = 0;
+                for (size_t i = 0; i < n; ++i) {
+                    a += v[i] * z[i];
+                }
+                this->alpha[steps] = a;
+                largest_alpha = std::max(largest_alpha, std::abs(a));
+
+                // Full reorthogonalisation against the whole basis. It's
+                // O(k n) a step, which is nothing next to the product, and
+                // without it the basis loses orthogonality as soon as the
+                // extreme eigenvalues converge.
+                for (size_t j = 0; j <= steps; ++j) {
+                    const double* const u = this->vector(j);
+
+                    double projection = 0;
+                    for (size_t i = 0; i < n; ++i) {
+                        projection += u[i] * z[i];
+                    }
+
+                    for (size_t i = 0; i < n; ++i) {
+                        z[i] -= projection * u[i];
+                    }
+                }
+
+                double b = 0;
+                for (size_t i = 0; i < n; ++i) {
+                    b += z[i] * z[i];
+                }
+                b = std::sqrt(b);
+
+                ++steps;
+
+                this->square_root_coefficients(steps);
+
+                // The Krylov space stopped growing, so sqrt(T_k) e_1 is exact.
+                if (b <= 1e-14 * largest_alpha) {
+                    this->last_converged = true;
+                    break;
+                }
+
+                if (steps > 1 && this->change_since_last_step(steps) <= this->tolerance) {
+                    this->last_converged = true;
+                    break;
+                }
+
+                this->beta[steps - 1] = b;
+
+                double* const next = this->vector(steps);
+                for (size_t i = 0; i < n; ++i) {
+                    next[i] = z[i] / b;
+                }
+
+                std::copy(this->coefficients.begin(), this->coefficients.begin() + steps, this->previous_coefficients.begin());
+            }
+
+            std::fill(out, out + n, 0.0);
+            for (size_t j = 0; j < steps; ++j) {
+                const double* const v = this->vector(j);
+                const double c = norm * this->coefficients[j];
+
+                for (size_t i = 0; i < n; ++i) {
+                    out[i] += c * v[i];
+                }
+            }
+
+            this->last_iterations = steps;
+            return steps;
+        }
+
+        template <class Operator>
+        size_t apply(Operator&& multiply, const std::vector<double>& w, std::vector<double>& out) {
+            if (w.size() != this->n) {
+                throw std::invalid_argument("Vector doesn't match the LanczosSqrt dimension");
+            }
+
+            out.resize(this->n);
+            return this->apply(multiply, w.data(), out.data());
+        }
+
+        /**
+          * out = sigma sqrt(M) W for W a fresh standard normal vector drawn
+          * with fill_normal, i.e. one step's worth of correlated Brownian
+          * displacement when sigma = sqrt(2 kT dt).
+          */
+        template <class Operator, class Engine>
+        size_t sample(Operator&& multiply, Engine& engine, double* out, const double sigma = 1) {
+            fill_normal(this->noise.data(), this->n, sigma, engine);
+
+            return this->apply(multiply, this->noise.data(), out);
+        }
+
+    private:
+        size_t n;
+        size_t max_steps;
+        double tolerance;
+
+        // Lanczos vectors, one after the other.
+        std::vector<double> basis;
+        std::vector<double> product;
+        std::vector<double> noise;
+
+        // T_k is alpha on the diagonal and beta next to it.
+        std::vector<double> alpha;
+        std::vector<double> beta;
+
+        // Scratch for diagonalising T_k, and sqrt(T_k) e_1 for this step and
+        // the one before.
+        std::vector<double> diagonal;
+        std::vector<double> off_diagonal;
+        std::vector<double> eigenvectors;
+        std::vector<double> coefficients;
+        std::vector<double> previous_coefficients;
+
+        size_t last_iterations = 0;
+        bool last_converged = false;
+
+        double* vector(const size_t j) noexcept {
+            return this->basis.data() + j * this->n;
+        }
+
+        double change_since_last_step(const size_t k) const noexcept {
+            double difference = 0;
+            double size = 0;
+
+            for (size_t j = 0; j < k; ++j) {
+                const double previous = (j + 1 < k) ? this->previous_coefficients[j] : 0.0;
+                difference += (this->coefficients[j] - previous) * (this->coefficients[j] - previous);
+                size += this->coefficients[j] * this->coefficients[j];
+            }
+
+            return std::sqrt(difference / size);
+        }
+
+        // coefficients = sqrt(T_k) e_1 = sum_j sqrt(lambda_j) q_j q_j[0].
+        void square_root_coefficients(const size_t k) {
+            std::copy(this->alpha.begin(), this->alpha.begin() + k, this->diagonal.begin());
+            std::copy(this->beta.begin(), this->beta.begin() + k, this->off_diagonal.begin());
+            this->off_diagonal[k - 1] = 0;
+
+            double* const q = this->eigenvectors.data();
+            std::fill(q, q + k * k, 0.0);
+            for (size_t i = 0; i < k; ++i) {
+                q[i * k + i] = 1;
+            }
+
+            tridiagonal_eigen(this->diagonal.data(), this->off_diagonal.data(), q, k);
+
+            const double largest = *std::max_element(this->diagonal.begin(), this->diagonal.begin() + k);
+
+            std::fill(this->coefficients.begin(), this->coefficients.begin() + k, 0.0);
+            for (size_t j = 0; j < k; ++j) {
+                double lambda = this->diagonal[j];
+
+                // Rounding can leave the smallest eigenvalues a hair below
+                // zero; anything more than that means M isn't positive
+                // definite and there's no real square root.
+                if (lambda < 0) {
+                    if (lambda < -1e-10 * std::abs(largest)) {
+                        throw std::domain_error("LanczosSqrt operator isn't positive definite");
+                    }
+
+                    lambda = 0;
+                }
+
+                const double weight = std::sqrt(lambda) * q[j];
+
+                for (size_t i = 0; i < k; ++i) {
+                    this->coefficients[i] += weight * q[i * k + j];
+                }
+            }
+        }
+
+        /**
+          * Implicit QL with Wilkinson shifts on the k x k symmetric
+          * tridiagonal matrix with diagonal d and d's neighbours in e (e[i]
+          * couples i and i + 1; e[k - 1] is scratch). On exit d holds the
+          * eigenvalues and column j of the row-major q has been rotated into
+          * the j-th eigenvector (start q at the identity).
+          */
+        static void tridiagonal_eigen(double* d, double* e, double* q, const size_t k) {
+            constexpr double epsilon = std::numeric_limits<double>::epsilon();
+
+            for (size_t l = 0; l < k; ++l) {
+                size_t iterations = 0;
+                size_t m;
+
+                do {
+                    for (m = l; m + 1 < k; ++m) {
+                        const double scale = std::abs(d[m]) + std::abs(d[m + 1]);
+
+                        if (std::abs(e[m]) <= epsilon * scale) {
+                            break;
+                        }
+                    }
+
+                    if (m == l) {
+                        break;
+                    }
+
+                    if (++iterations > 60) {
+                        throw std::runtime_error("Tridiagonal eigensolver didn't converge");
+                    }
+
+                    double g = (d[l + 1] - d[l]) / (2 * e[l]);
+                    double r = std::hypot(g, 1.0);
+                    g = d[m] - d[l] + e[l] / (g + std::copysign(r, g));
+
+                    double s = 1;
+                    double c = 1;
+                    double p = 0;
+                    bool underflow = false;
+
+                    for (size_t i = m; i-- > l;) {
+                        const double f = s * e[i];
+                        const double b = c * e[i];
+
+                        r = std::hypot(f, g);
+                        e[i + 1] = r;
+
+                        if (r == 0) {
+                            d[i + 1] -= p;
+                            e[m] = 0;
+                            underflow = true;
+                            break;
+                        }
+
+                        s = f / r;
+                        c = g / r;
+                        g = d[i + 1] - p;
+                        r = (d[i] - g) * s + 2 * c * b;
+                        p = s * r;
+                        d[i + 1] = g + p;
+                        g = c * r - b;
+
+                        for (size_t row = 0; row < k; ++row) {
+                            const double upper = q[row * k + i + 1];
+                            q[row * k + i + 1] = s * q[row * k + i] + c * upper;
+                            q[row * k + i] = c * q[row * k + i] - s * upper;
+                        }
+                    }
+
+                    if (underflow) {
+                        continue;
+                    }
+
+                    d[l] -= p;
+                    e[l] = g;
+                    e[m] = 0;
+                } while (m != l);
+            }
+        }
+    };
+}
@@ -1,11 +1,16 @@
 #pragma once
 
 #include <array>
+#include <cctype>
+#include <charconv>
 #include <iostream>
 #include <stdexcept>
 #include <limits>
 #include <string>
+#include <string_view>
 #include <cstring>
+#include <system_error>
+#include <type_traits>
 #include <cmath>
 #include <vector>
 #include <random>
@@ -63,84 +68,82 @@ namespace dav {
 
     };
 
+    /**
+      * Parse a number out of a string with std::from_chars, so no allocation,
+      * locale lookups or errno. Leading and trailing whitespace and a leading
+      * '+' are allowed, anything else left over is an error, as is a value
+      * that doesn't fit in T. Returns std::errc() on success and leaves value
+      * alone otherwise; use convert below if you'd rather have an exception.
+      */
     template <class T>
-    inline T convert(const std::string& s);
-
-    template <>
-    inline std::string convert(const std::string& s) {
-        return s;
-    }
+    inline std::errc try_convert(const std::string_view s, T& value) noexcept {
+        static_assert(std::is_arithmetic<T>::value && !std::is_same<T, bool>::value, "Can only convert to numbers");
 
-    template <>
-    inline int convert(const std::string& s) {
-        char* leftovers;
-        const long value = std::strtol(s.c_str(), &leftovers, 10);
+        const char* first = s.data();
+        const char* last = s.data() + s.size();
 
-        if (value == 0) {
-            if (errno == EINVAL) {
-                throw number_format_exception("Couldn't convert string to int");
-            }
+        while (first != last && std::isspace(static_cast<unsigned char>(*first))) {
+            ++first;
+        }
 
-            if (errno == ERANGE) {
-                throw number_format_exception("Value too big for long");
-            }
+        while (last != first && std::isspace(static_cast<unsigned char>(*(last - 1)))) {
+            --last;
+        }
 
-            if (value < std::numeric_limits<int>::min() || value > std::numeric_limits<int>::max()) {
-                throw number_format_exception("Value too big for int");
-            }
+        // from_chars won't take a plus sign, but a minus sign straight after
+        // one would be accepted if we just skipped it.
+        if (first != last && *first == '+') {
+            ++first;
 
-            if (std::strcmp(leftovers, s.c_str()) == 0) {
-                throw number_format_exception("Unknown error occured in int conversion");
+            if (first != last && *first == '-') {
+                return std::errc::invalid_argument;
             }
         }
 
-        return value;
-    }
-
-    template <>
-    inline long convert(const std::string& s) {
-        char* leftovers;
-        const long value = std::strtol(s.c_str(), &leftovers, 10);
+        if (first == last) {
+            return std::errc::invalid_argument;
+        }
 
-        if (value == 0) {
-            if (errno == EINVAL) {
-                throw number_format_exception("Couldn't convert string to int");
-            }
+        T parsed{};
+        const std::from_chars_result result = std::from_chars(first, last, parsed);
 
-            if (errno == ERANGE) {
-                throw number_format_exception("Value too big for long");
-            }
+        if (result.ec != std::errc()) {
+            return result.ec;
+        }
 
-            if (std::strcmp(leftovers, s.c_str()) == 0) {
-                throw number_format_exception("Unknown error occured in long conversion");
-            }
+        if (result.ptr != last) {
+            return std::errc::invalid_argument;
         }
 
-        return value;
+        value = parsed;
+        return std::errc();
     }
 
-    template <>
-    inline double convert(const std::string& s) {
-        char* leftovers;
-        const double value = std::strtod(s.c_str(), &leftovers);
+    template <class T>
+    inline T convert(const std::string_view s) {
+        static_assert(std::is_arithmetic<T>::value && !std::is_same<T, bool>::value, "Can only convert to numbers or strings");
 
-        if (value == 0) {
-            if (errno == EINVAL) {
-                throw number_format_exception("Couldn't convert string to double");
-            }
+        const char* const type_name = std::is_integral<T>::value ? "integer" : "floating point number";
 
-            if (errno == ERANGE) {
-                throw number_format_exception("Value too big for double");
-            }
+        T value{};
+        const std::errc error = try_convert(s, value);
 
-            if (std::strcmp(leftovers, s.c_str()) == 0) {
-                throw number_format_exception("Unknown error occured in double conversion");
-            }
+        if (error == std::errc::result_out_of_range) {
+            throw number_format_exception("Value '" + std::string(s) + "' out of range for " + type_name);
+        }
+
+        if (error != std::errc()) {
+            throw number_format_exception("Couldn't convert '" + std::string(s) + "' to " + type_name);
         }
 
         return value;
     }
 
+    template <>
+    inline std::string convert(const std::string_view s) {
+        return std::string(s);
+    }
+
     template <class T>
     struct MilsteinParameters {
         T alpha_1;
@@ -202,4 +205,97 @@ namespace dav {
         return x + w + u * delta;
     }
 
+    /**
+      * Compile-time versions of the MilsteinParameters above. Passing one of
+      * these as a template parameter instead of a MilsteinParameters reference
+      * lets the compiler fold the coefficients into the arithmetic and drop
+      * the terms that are multiplied by zero.
+      */
+    struct AdamsBashforthScheme {
+        static constexpr double alpha_1 = -1.0;
+        static constexpr double alpha_0 = 0.0;
+        static constexpr double beta_1 = 1.5;
+        static constexpr double beta_0 = -0.5;
+        static constexpr double gamma_1 = 1.0;
+        static constexpr double gamma_0 = 1.0 + alpha_1;
+    };
+
+    struct MidpointRuleScheme {
+        static constexpr double alpha_1 = 0.0;
+        static constexpr double alpha_0 = -1.0;
+        static constexpr double beta_1 = 2.0;
+        static constexpr double beta_0 = 0.0;
+        static constexpr double gamma_1 = 1.0;
+        static constexpr double gamma_0 = 1.0 + alpha_1;
+    };
+
+    // Plain Euler-Maruyama written as a one-step Milstein scheme.
+    struct EulerMaruyamaScheme {
+        static constexpr double alpha_1 = -1.0;
+        static constexpr double alpha_0 = 0.0;
+        static constexpr double beta_1 = 1.0;
+        static constexpr double beta_0 = 0.0;
+        static constexpr double gamma_1 = 1.0;
+        static constexpr double gamma_0 = 1.0 + alpha_1;
+    };
+
+    /**
+      * Same as milstein, but with the scheme fixed at compile time. Terms with
+      * a zero coefficient are skipped entirely, so e.g. the EulerMaruyamaScheme
+      * never reads x_prev, u_prev or w_prev.
+      */
+    template <class Scheme, class T>
+    inline T milstein(const T x, const T x_prev, const T u, const T u_prev, const T w, const T w_prev, const T delta) noexcept {
+        T term_1 = 0;
+        T term_2 = 0;
+        T term_3 = 0;
+
+        if constexpr (Scheme::alpha_1 != 0) term_1 -= T(Scheme::alpha_1) * x;
+        if constexpr (Scheme::alpha_0 != 0) term_1 -= T(Scheme::alpha_0) * x_prev;
+        if constexpr (Scheme::beta_1 != 0) term_2 += T(Scheme::beta_1) * u;
+        if constexpr (Scheme::beta_0 != 0) term_2 += T(Scheme::beta_0) * u_prev;
+        if constexpr (Scheme::gamma_1 != 0) term_3 += T(Scheme::gamma_1) * w;
+        if constexpr (Scheme::gamma_0 != 0) term_3 += T(Scheme::gamma_0) * w_prev;
+
+        return term_1 + delta * term_2 + term_3;
+    }
+
+    /**
+      * Step n coordinates at once, e.g. all 3N components of a set of
+      * particles laid out contiguously. x_next[i] is computed from element i
+      * of every other array only, so x_next may be the same buffer as x or
+      * x_prev (handy for rotating two position buffers). Previous-step arrays
+      * that the scheme doesn't need may be null.
+      */
+    template <class Scheme, class T>
+    inline void milstein_batch(T* x_next, const T* x, const T* x_prev, const T* u, const T* u_prev, const T* w, const T* w_prev, const T delta, const size_t n) noexcept {
+        for (size_t i = 0; i < n; ++i) {
+            const T x_prev_i = Scheme::alpha_0 != 0 ? x_prev[i] : T(0);
+            const T u_prev_i = Scheme::beta_0 != 0 ? u_prev[i] : T(0);
+            const T w_prev_i = Scheme::gamma_0 != 0 ? w_prev[i] : T(0);
+
+            x_next[i] = milstein<Scheme, T>(x[i], x_prev_i, u[i], u_prev_i, w[i], w_prev_i, delta);
+        }
+    }
+
+    template <class T>
+    inline void adams_bashforth_milstein_batch(T* x_next, const T* x, const T* x_prev, const T* u, const T* u_prev, const T* w, const T* w_prev, const T delta, const size_t n) noexcept {
+        milstein_batch<AdamsBashforthScheme>(x_next, x, x_prev, u, u_prev, w, w_prev, delta, n);
+    }
+
+    template <class T>
+    inline void midpoint_rule_milstein_batch(T* x_next, const T* x, const T* x_prev, const T* u, const T* u_prev, const T* w, const T* w_prev, const T delta, const size_t n) noexcept {
+        milstein_batch<MidpointRuleScheme>(x_next, x, x_prev, u, u_prev, w, w_prev, delta, n);
+    }
+
+    /**
+      * In-place Euler-Maruyama step over n coordinates: x += w + u * delta.
+      */
+    template <class T>
+    inline void euler_maruyama_batch(T* x, const T* u, const T* w, const T delta, const size_t n) noexcept {
+        for (size_t i = 0; i < n; ++i) {
+            x[i] = x[i] + w[i] + u[i] * delta;
+        }
+    }
+
 }
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <limits>
+#include <new>
+
+namespace dav {
+    /**
+      * Allocator that hands out memory aligned to the given number of bytes
+      * (a cache line by default), so that bulk kernels can use aligned SIMD
+      * loads and never straddle cache lines at the start of a buffer. Drop it
+      * into any standard container, e.g. std::vector<double, AlignedAllocator<double>>.
+      */
+    template <class T, size_t Alignment = 64>
+    class AlignedAllocator {
+
+        static_assert(Alignment >= alignof(T), "Alignment is weaker than the type's own alignment");
+        static_assert((Alignment & (Alignment - 1)) == 0, "Alignment must be a power of two");
+
+    public:
+        using value_type = T;
+
+        template <class U>
+        struct rebind {
+            using other = AlignedAllocator<U, Alignment>;
+        };
+
+        AlignedAllocator() noexcept = default;
+
+        template <class U>
+        AlignedAllocator(const AlignedAllocator<U, Alignment>&) noexcept {}
+
+        T* allocate(const size_t n) {
+            if (n > std::numeric_limits<size_t>::max() / sizeof(T)) {
+                throw std::bad_array_new_length();
+            }
+
+            return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+        }
+
+        void deallocate(T* p, const size_t) noexcept {
+            ::operator delete(p, std::align_val_t(Alignment));
+        }
+    };
+
+    template <class T, class U, size_t Alignment>
+    inline bool operator== (const AlignedAllocator<T, Alignment>&, const AlignedAllocator<U, Alignment>&) noexcept {
+        return true;
+    }
+
+    template <class T, class U, size_t Alignment>
+    inline bool operator!= (const AlignedAllocator<T, Alignment>&, const AlignedAllocator<U, Alignment>&) noexcept {
+        return false;
+    }
+
+    /**
+      * Non-owning view of a contiguous run of values, for handing one
+      * component of a structure-of-arrays container to a bulk kernel.
+      */
+    template <class T>
+    class Span {
+
+    public:
+        constexpr Span() noexcept = default;
+
+        constexpr Span(T* data, const size_t size) noexcept
+        : pointer(data)
+        , length(size) {}
+
+        constexpr T* data() const noexcept {
+            return this->pointer;
+        }
+
+        constexpr size_t size() const noexcept {
+            return this->length;
+        }
+
+        constexpr bool empty() const noexcept {
+            return this->length == 0;
+        }
+
+        constexpr T* begin() const noexcept {
+            return this->pointer;
+        }
+
+        constexpr T* end() const noexcept {
+            return this->pointer + this->length;
+        }
+
+        constexpr T& operator[](const size_t i) const noexcept {
+            return this->pointer[i];
+        }
+
+    private:
+        T* pointer = nullptr;
+        size_t length = 0;
+    };
+}
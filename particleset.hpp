@@ -0,0 +1,303 @@
+#pragma once
+
+#include "arrayutils.hpp"
+#include "memoryutils.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+namespace dav {
+    /**
+      * Proxy for one 3-vector that is scattered across the three component
+      * buffers of a VectorField. Reads and writes go straight through to the
+      * buffers, so it behaves like a MathArray<double, 3>& for indexing,
+      * assignment and the compound operators, and converts to a MathArray for
+      * everything else. Template functions won't deduce through the
+      * conversion, so call get() before passing one to e.g. magnitude().
+      */
+    template <class T>
+    class Vector3Reference {
+
+        using Value = std::remove_const_t<T>;
+
+    public:
+        constexpr Vector3Reference(T* x, T* y, T* z) noexcept
+        : components{x, y, z} {}
+
+        T& operator[](const size_t i) const noexcept {
+            return *this->components[i];
+        }
+
+        T& at(const size_t i) const {
+            if (i >= 3) {
+                throw std::range_error("index out of range");
+            }
+
+            return (*this)[i];
+        }
+
+        MathArray<Value, 3> get() const noexcept {
+            return MathArray<Value, 3>{*this->components[0], *this->components[1], *this->components[2]};
+        }
+
+        operator MathArray<Value, 3>() const noexcept {
+            return this->get();
+        }
+
+        const Vector3Reference<T>& operator=(const MathArray<Value, 3>& other) const noexcept {
+            static_assert(!std::is_const<T>::value, "Can't assign through a const reference");
+
+            for (size_t i = 0; i < 3; ++i) {
+                *this->components[i] = other[i];
+            }
+
+            return *this;
+        }
+
+        // Assigning one proxy to another copies the values, like a real
+        // reference would, rather than reseating the proxy.
+        const Vector3Reference<T>& operator=(const Vector3Reference<T>& other) const noexcept {
+            return *this = other.get();
+        }
+
+        const Vector3Reference<T>& operator+=(const MathArray<Value, 3>& other) const noexcept {
+            static_assert(!std::is_const<T>::value, "Can't assign through a const reference");
+
+            for (size_t i = 0; i < 3; ++i) {
+                *this->components[i] += other[i];
+            }
+
+            return *this;
+        }
+
+        const Vector3Reference<T>& operator-=(const MathArray<Value, 3>& other) const noexcept {
+            static_assert(!std::is_const<T>::value, "Can't assign through a const reference");
+
+            for (size_t i = 0; i < 3; ++i) {
+                *this->components[i] -= other[i];
+            }
+
+            return *this;
+        }
+
+        const Vector3Reference<T>& operator*=(const Value& scalar) const noexcept {
+            static_assert(!std::is_const<T>::value, "Can't assign through a const reference");
+
+            for (size_t i = 0; i < 3; ++i) {
+                *this->components[i] *= scalar;
+            }
+
+            return *this;
+        }
+
+    private:
+        T* const components[3];
+    };
+
+
+    /**
+      * A run-time sized list of 3-vectors stored as structure-of-arrays: one
+      * contiguous, cache-line aligned buffer per component. Individual vectors
+      * come out as Vector3Reference proxies; whole components come out as
+      * Spans for bulk kernels to loop over.
+      */
+    class VectorField {
+
+    public:
+        using Storage = std::vector<double, AlignedAllocator<double>>;
+
+        VectorField() = default;
+
+        explicit VectorField(const size_t n)
+        : components{Storage(n), Storage(n), Storage(n)} {}
+
+        explicit VectorField(const std::vector<MathArray<double, 3>>& vectors) {
+            this->reserve(vectors.size());
+
+            for (const MathArray<double, 3>& v : vectors) {
+                this->push_back(v);
+            }
+        }
+
+        size_t size() const noexcept {
+            return this->components[0].size();
+        }
+
+        size_t capacity() const noexcept {
+            return this->components[0].capacity();
+        }
+
+        bool empty() const noexcept {
+            return this->size() == 0;
+        }
+
+        void reserve(const size_t n) {
+            for (Storage& component : this->components) {
+                component.reserve(n);
+            }
+        }
+
+        void resize(const size_t n) {
+            for (Storage& component : this->components) {
+                component.resize(n);
+            }
+        }
+
+        void clear() noexcept {
+            for (Storage& component : this->components) {
+                component.clear();
+            }
+        }
+
+        void push_back(const MathArray<double, 3>& v) {
+            for (size_t i = 0; i < 3; ++i) {
+                this->components[i].push_back(v[i]);
+            }
+        }
+
+        Vector3Reference<double> operator[](const size_t i) noexcept {
+            return Vector3Reference<double>(&this->components[0][i], &this->components[1][i], &this->components[2][i]);
+        }
+
+        Vector3Reference<const double> operator[](const size_t i) const noexcept {
+            return Vector3Reference<const double>(&this->components[0][i], &this->components[1][i], &this->components[2][i]);
+        }
+
+        Vector3Reference<double> at(const size_t i) {
+            if (i >= this->size()) {
+                throw std::range_error("index out of range");
+            }
+
+            return (*this)[i];
+        }
+
+        Vector3Reference<const double> at(const size_t i) const {
+            if (i >= this->size()) {
+                throw std::range_error("index out of range");
+            }
+
+            return (*this)[i];
+        }
+
+        Span<double> component(const size_t c) noexcept {
+            return Span<double>(this->components[c].data(), this->size());
+        }
+
+        Span<const double> component(const size_t c) const noexcept {
+            return Span<const double>(this->components[c].data(), this->size());
+        }
+
+        Span<double> x() noexcept { return this->component(0); }
+        Span<double> y() noexcept { return this->component(1); }
+        Span<double> z() noexcept { return this->component(2); }
+        Span<const double> x() const noexcept { return this->component(0); }
+        Span<const double> y() const noexcept { return this->component(1); }
+        Span<const double> z() const noexcept { return this->component(2); }
+
+        void fill(const MathArray<double, 3>& v) noexcept {
+            for (size_t c = 0; c < 3; ++c) {
+                std::fill(this->components[c].begin(), this->components[c].end(), v[c]);
+            }
+        }
+
+        std::vector<MathArray<double, 3>> to_vector() const {
+            std::vector<MathArray<double, 3>> output(this->size());
+
+            for (size_t i = 0; i < this->size(); ++i) {
+                output[i] = (*this)[i].get();
+            }
+
+            return output;
+        }
+
+    private:
+        Storage components[3];
+    };
+
+
+    /**
+      * Positions, velocities and forces of a set of particles, each kept as a
+      * structure-of-arrays VectorField so that the bulk kernels can stream
+      * through one component at a time. The three fields always have the same
+      * size and grow together.
+      */
+    class ParticleSet {
+
+    public:
+        ParticleSet() = default;
+
+        explicit ParticleSet(const size_t n)
+        : position_field(n)
+        , velocity_field(n)
+        , force_field(n) {}
+
+        explicit ParticleSet(const std::vector<MathArray<double, 3>>& positions) {
+            this->reserve(positions.size());
+
+            for (const MathArray<double, 3>& position : positions) {
+                this->push_back(position);
+            }
+        }
+
+        size_t size() const noexcept {
+            return this->position_field.size();
+        }
+
+        size_t capacity() const noexcept {
+            return this->position_field.capacity();
+        }
+
+        bool empty() const noexcept {
+            return this->size() == 0;
+        }
+
+        void reserve(const size_t n) {
+            this->position_field.reserve(n);
+            this->velocity_field.reserve(n);
+            this->force_field.reserve(n);
+        }
+
+        void resize(const size_t n) {
+            this->position_field.resize(n);
+            this->velocity_field.resize(n);
+            this->force_field.resize(n);
+        }
+
+        void clear() noexcept {
+            this->position_field.clear();
+            this->velocity_field.clear();
+            this->force_field.clear();
+        }
+
+        void push_back(const MathArray<double, 3>& position,
+                       const MathArray<double, 3>& velocity = MathArray<double, 3>{},
+                       const MathArray<double, 3>& force = MathArray<double, 3>{}) {
+
+            this->position_field.push_back(position);
+            this->velocity_field.push_back(velocity);
+            this->force_field.push_back(force);
+        }
+
+        VectorField& positions() noexcept { return this->position_field; }
+        VectorField& velocities() noexcept { return this->velocity_field; }
+        VectorField& forces() noexcept { return this->force_field; }
+        const VectorField& positions() const noexcept { return this->position_field; }
+        const VectorField& velocities() const noexcept { return this->velocity_field; }
+        const VectorField& forces() const noexcept { return this->force_field; }
+
+        Vector3Reference<double> position(const size_t i) noexcept { return this->position_field[i]; }
+        Vector3Reference<double> velocity(const size_t i) noexcept { return this->velocity_field[i]; }
+        Vector3Reference<double> force(const size_t i) noexcept { return this->force_field[i]; }
+        Vector3Reference<const double> position(const size_t i) const noexcept { return this->position_field[i]; }
+        Vector3Reference<const double> velocity(const size_t i) const noexcept { return this->velocity_field[i]; }
+        Vector3Reference<const double> force(const size_t i) const noexcept { return this->force_field[i]; }
+
+    private:
+        VectorField position_field;
+        VectorField velocity_field;
+        VectorField force_field;
+    };
+}
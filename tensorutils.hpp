@@ -5,7 +5,10 @@
 #include <cstddef>
 #include <stdexcept>
 #include <algorithm>
+#include <cmath>
 #include <iterator>
+#include <limits>
+#include <utility>
 
 namespace dav {
     template <class T, size_t N, size_t M> class Tensor;
@@ -190,16 +193,150 @@ namespace dav {
         }
     };
 
+    /**
+      * Kernels behind Tensor * Tensor, on row-major data: c (I x J) = a (I x K)
+      * b (K x J). Both add up each element of c in increasing k, the same as
+      * the textbook triple loop, so results don't depend on which one runs.
+      */
+    namespace matmul {
+        template <class T, size_t J, size_t... ks>
+        constexpr T row_times_column(const T* a_row, const T* b, const size_t j, std::index_sequence<ks...>) noexcept {
+            return (... + (a_row[ks] * b[ks * J + j]));
+        }
+
+        /**
+          * Every element of c written out as its own sum at compile time, so
+          * there are no loops or index arithmetic left at all. Only sensible
+          * for the 3x3s and 4x4s that turn up everywhere; the code grows as
+          * I * J * K.
+          */
+        template <class T, size_t I, size_t J, size_t K, size_t... cells>
+        constexpr void unrolled(const T* a, const T* b, T* c, std::index_sequence<cells...>) noexcept {
+            static_assert(K > 0, "Nothing to unroll");
+
+            ((c[cells] = row_times_column<T, J>(a + (cells / J) * K, b, cells % J, std::make_index_sequence<K>{})), ...);
+        }
+
+        /**
+          * The textbook loop on the raw arrays. With all three sizes known at
+          * compile time the optimiser unrolls and vectorises this well enough
+          * that blocking only starts to pay off from around 16x16.
+          */
+        template <class T, size_t I, size_t J, size_t K>
+        constexpr void simple(const T* a, const T* b, T* c) noexcept {
+            for (size_t i = 0; i < I; ++i) {
+                for (size_t j = 0; j < J; ++j) {
+                    T sum{};
+
+                    for (size_t k = 0; k < K; ++k) {
+                        sum += a[i * K + k] * b[k * J + j];
+                    }
+
+                    c[i * J + j] = sum;
+                }
+            }
+        }
+
+        /**
+          * c[i, j] += sum over k in [k_begin, k_end) of a[i, k] b[k, j] for
+          * one rows x columns block of c, kept in local accumulators (i.e.
+          * registers) for the whole run of k rather than going back to
+          * memory each time.
+          */
+        template <class T, size_t J, size_t K, size_t rows, size_t columns>
+        constexpr void block_update(const T* a, const T* b, T* c, const size_t i, const size_t j, const size_t k_begin, const size_t k_end) noexcept {
+            T sums[rows][columns] = {};
+
+            for (size_t r = 0; r < rows; ++r) {
+                for (size_t s = 0; s < columns; ++s) {
+                    sums[r][s] = c[(i + r) * J + j + s];
+                }
+            }
+
+            for (size_t k = k_begin; k < k_end; ++k) {
+                const T* const b_row = b + k * J + j;
+
+                for (size_t r = 0; r < rows; ++r) {
+                    const T a_ik = a[(i + r) * K + k];
+
+                    for (size_t s = 0; s < columns; ++s) {
+                        sums[r][s] += a_ik * b_row[s];
+                    }
+                }
+            }
+
+            for (size_t r = 0; r < rows; ++r) {
+                for (size_t s = 0; s < columns; ++s) {
+                    c[(i + r) * J + j + s] = sums[r][s];
+                }
+            }
+        }
+
+        /**
+          * For bigger tensors, e.g. mobility blocks for a few dozen particles.
+          * c is built up in 4x4 register blocks, and b is walked in tiles of
+          * tile_k x tile_j (128 kB of doubles, so it stays in L2 while every
+          * row of a goes past it). Rows and columns that don't fill a whole
+          * block get the same treatment one at a time.
+          */
+        template <class T, size_t I, size_t J, size_t K>
+        constexpr void blocked(const T* a, const T* b, T* c) noexcept {
+            constexpr size_t block = 4;
+            constexpr size_t tile_k = 64;
+            constexpr size_t tile_j = 256;
+
+            constexpr size_t whole_rows = I - I % block;
+            constexpr size_t whole_columns = J - J % block;
+
+            for (size_t i = 0; i < I * J; ++i) {
+                c[i] = T{};
+            }
+
+            for (size_t k_begin = 0; k_begin < K; k_begin += tile_k) {
+                const size_t k_end = std::min(k_begin + tile_k, K);
+
+                for (size_t j_begin = 0; j_begin < J; j_begin += tile_j) {
+                    const size_t j_end = std::min(j_begin + tile_j, J);
+                    const size_t j_whole = std::min(j_end, whole_columns);
+
+                    for (size_t i = 0; i < whole_rows; i += block) {
+                        size_t j = j_begin;
+
+                        for (; j < j_whole; j += block) {
+                            block_update<T, J, K, block, block>(a, b, c, i, j, k_begin, k_end);
+                        }
+
+                        for (; j < j_end; ++j) {
+                            block_update<T, J, K, block, 1>(a, b, c, i, j, k_begin, k_end);
+                        }
+                    }
+
+                    for (size_t i = whole_rows; i < I; ++i) {
+                        size_t j = j_begin;
+
+                        for (; j < j_whole; j += block) {
+                            block_update<T, J, K, 1, block>(a, b, c, i, j, k_begin, k_end);
+                        }
+
+                        for (; j < j_end; ++j) {
+                            block_update<T, J, K, 1, 1>(a, b, c, i, j, k_begin, k_end);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
     template <class T, size_t I, size_t J, size_t K>
     constexpr Tensor<T, I, J> operator*(const Tensor<T, I, K>& t1, const Tensor<T, K, J>& t2) noexcept {
         Tensor<T, I, J> output{};
 
-        for (size_t i = 0; i < I; ++i) {
-            for (size_t j = 0; j < J; ++j) {
-                for (size_t k = 0; k < K; ++k) {
-                    output[{i, j}] += t1[{i, k}] * t2[{k, j}];
-                }
-            }
+        if constexpr (K > 0 && I * J * K <= 64) {
+            matmul::unrolled<T, I, J, K>(t1.data, t2.data, output.data, std::make_index_sequence<I * J>{});
+        } else if constexpr (I * J * K <= 16 * 16 * 16) {
+            matmul::simple<T, I, J, K>(t1.data, t2.data, output.data);
+        } else {
+            matmul::blocked<T, I, J, K>(t1.data, t2.data, output.data);
         }
 
         return output;
@@ -230,6 +367,200 @@ namespace dav {
         return output;
     }
 
+    /**
+      * Symmetric N x N tensor storing only the N(N + 1)/2 entries on and
+      * above the diagonal, packed row by row (so xx, xy, xz, yy, yz, zz for
+      * 3x3). Both [{i, j}] and [{j, i}] give the same element. Strain rates
+      * and pair mobilities like the Oseen and RPY tensors are symmetric, so
+      * keeping arrays of them in this form cuts the memory traffic from 9
+      * values a pair to 6.
+      */
+    template <class T, size_t N>
+    class SymmetricTensor {
+
+        static constexpr size_t flatten(const size_t i, const size_t j) noexcept {
+            const size_t row = i < j ? i : j;
+            const size_t column = i < j ? j : i;
+
+            return row * N - row * (row - 1) / 2 + column - row;
+        }
+
+    public:
+        static constexpr size_t packed_size = N * (N + 1) / 2;
+
+        T data[packed_size];
+
+        T& operator[](const Index& i) noexcept {
+            return this->data[flatten(i.i, i.j)];
+        }
+
+        constexpr const T& operator[](const Index& i) const noexcept {
+            return this->data[flatten(i.i, i.j)];
+        }
+
+        T& at(const size_t i, const size_t j) {
+            if (i >= N || j >= N) {
+                throw std::range_error("Indices out of bounds for tensor");
+            }
+
+            return this->data[flatten(i, j)];
+        }
+
+        const T& at(const size_t i, const size_t j) const {
+            if (i >= N || j >= N) {
+                throw std::range_error("Indices out of bounds for tensor");
+            }
+
+            return this->data[flatten(i, j)];
+        }
+
+        constexpr Tensor<T, N, N> to_tensor() const noexcept {
+            Tensor<T, N, N> output{};
+
+            for (size_t i = 0; i < N; ++i) {
+                for (size_t j = 0; j < N; ++j) {
+                    output.data[i * N + j] = this->data[flatten(i, j)];
+                }
+            }
+
+            return output;
+        }
+
+        // The symmetric part (t + t^T) / 2, which is just t for a t that's
+        // already symmetric.
+        static constexpr SymmetricTensor from_tensor(const Tensor<T, N, N>& t) noexcept {
+            SymmetricTensor output{};
+
+            for (size_t i = 0; i < N; ++i) {
+                for (size_t j = i; j < N; ++j) {
+                    output.data[flatten(i, j)] = (t.data[i * N + j] + t.data[j * N + i]) / T{2};
+                }
+            }
+
+            return output;
+        }
+
+        constexpr T trace() const noexcept {
+            T output{};
+
+            for (size_t i = 0; i < N; ++i) {
+                output += this->data[flatten(i, i)];
+            }
+
+            return output;
+        }
+    };
+
+    template <class T, size_t N>
+    constexpr MathArray<T, N> operator*(const SymmetricTensor<T, N>& t, const MathArray<T, N>& v) noexcept {
+        const T* s = t.data;
+
+        if constexpr (N == 3) {
+            return MathArray<T, 3>{s[0] * v[0] + s[1] * v[1] + s[2] * v[2],
+                                   s[1] * v[0] + s[3] * v[1] + s[4] * v[2],
+                                   s[2] * v[0] + s[4] * v[1] + s[5] * v[2]};
+        } else {
+            MathArray<T, N> output{};
+            size_t index = 0;
+
+            // Each off-diagonal element does double duty, for (i, j) and (j, i).
+            for (size_t i = 0; i < N; ++i) {
+                output[i] += s[index++] * v[i];
+
+                for (size_t j = i + 1; j < N; ++j, ++index) {
+                    output[i] += s[index] * v[j];
+                    output[j] += s[index] * v[i];
+                }
+            }
+
+            return output;
+        }
+    }
+
+    template <class T, size_t N>
+    constexpr SymmetricTensor<T, N> operator+(const SymmetricTensor<T, N>& t1, const SymmetricTensor<T, N>& t2) noexcept {
+        SymmetricTensor<T, N> output{};
+
+        for (size_t i = 0; i < SymmetricTensor<T, N>::packed_size; ++i) {
+            output.data[i] = t1.data[i] + t2.data[i];
+        }
+
+        return output;
+    }
+
+    template <class T, size_t N>
+    constexpr SymmetricTensor<T, N> operator*(const T scale, const SymmetricTensor<T, N>& t) noexcept {
+        SymmetricTensor<T, N> output{};
+
+        for (size_t i = 0; i < SymmetricTensor<T, N>::packed_size; ++i) {
+            output.data[i] = scale * t.data[i];
+        }
+
+        return output;
+    }
+
+    template <class T, size_t N>
+    constexpr SymmetricTensor<T, N> operator*(const SymmetricTensor<T, N>& t, const T scale) noexcept {
+        return scale * t;
+    }
+
+    /**
+      * A : B = sum_ij A_ij B_ij. With both symmetric that's the diagonal plus
+      * twice the packed off-diagonal terms.
+      */
+    template <class T, size_t N>
+    constexpr T double_contraction(const SymmetricTensor<T, N>& t1, const SymmetricTensor<T, N>& t2) noexcept {
+        T diagonal{};
+        T off_diagonal{};
+        size_t index = 0;
+
+        for (size_t i = 0; i < N; ++i) {
+            diagonal += t1.data[index] * t2.data[index];
+            ++index;
+
+            for (size_t j = i + 1; j < N; ++j, ++index) {
+                off_diagonal += t1.data[index] * t2.data[index];
+            }
+        }
+
+        return diagonal + 2 * off_diagonal;
+    }
+
+    template <class T, size_t N>
+    constexpr T double_contraction(const SymmetricTensor<T, N>& t1, const Tensor<T, N, N>& t2) noexcept {
+        T output{};
+        size_t index = 0;
+
+        for (size_t i = 0; i < N; ++i) {
+            output += t1.data[index++] * t2.data[i * N + i];
+
+            for (size_t j = i + 1; j < N; ++j, ++index) {
+                output += t1.data[index] * (t2.data[i * N + j] + t2.data[j * N + i]);
+            }
+        }
+
+        return output;
+    }
+
+    // v . T . v, e.g. x.E.x in the flow around a sphere.
+    template <class T, size_t N>
+    constexpr T quadratic_form(const SymmetricTensor<T, N>& t, const MathArray<T, N>& v) noexcept {
+        T diagonal{};
+        T off_diagonal{};
+        size_t index = 0;
+
+        for (size_t i = 0; i < N; ++i) {
+            diagonal += t.data[index++] * v[i] * v[i];
+
+            for (size_t j = i + 1; j < N; ++j, ++index) {
+                off_diagonal += t.data[index] * v[i] * v[j];
+            }
+        }
+
+        return diagonal + 2 * off_diagonal;
+    }
+
+
     template <class T, size_t N, size_t M>
     Tensor<T, N, M> tensor_from_array(const T (&arr)[N][M]) {
         Tensor<T, N, M> out{};
@@ -253,6 +584,342 @@ namespace dav {
         return out;
     }
 
+    /**
+      * Closed forms for the 3x3s that every pair of particles produces:
+      * cofactor expansions, no pivoting. For other sizes these fall through
+      * to the LU versions further down.
+      */
+    template <class T>
+    constexpr T determinant(const Tensor<T, 3, 3>& t) noexcept {
+        const T* m = t.data;
+
+        return m[0] * (m[4] * m[8] - m[5] * m[7])
+             + m[1] * (m[5] * m[6] - m[3] * m[8])
+             + m[2] * (m[3] * m[7] - m[4] * m[6]);
+    }
+
+    template <class T>
+    constexpr Tensor<T, 3, 3> inverse(const Tensor<T, 3, 3>& t) {
+        const T* m = t.data;
+
+        const T c_00 = m[4] * m[8] - m[5] * m[7];
+        const T c_01 = m[5] * m[6] - m[3] * m[8];
+        const T c_02 = m[3] * m[7] - m[4] * m[6];
+        const T det = m[0] * c_00 + m[1] * c_01 + m[2] * c_02;
+
+        if (det == T{}) {
+            throw std::domain_error("Can't invert a singular tensor");
+        }
+
+        const T inv_det = T{1} / det;
+
+        // Transposed cofactors over the determinant.
+        return Tensor<T, 3, 3>{c_00 * inv_det, (m[2] * m[7] - m[1] * m[8]) * inv_det, (m[1] * m[5] - m[2] * m[4]) * inv_det,
+                               c_01 * inv_det, (m[0] * m[8] - m[2] * m[6]) * inv_det, (m[2] * m[3] - m[0] * m[5]) * inv_det,
+                               c_02 * inv_det, (m[1] * m[6] - m[0] * m[7]) * inv_det, (m[0] * m[4] - m[1] * m[3]) * inv_det};
+    }
+
+    template <class T>
+    constexpr MathArray<T, 3> solve(const Tensor<T, 3, 3>& t, const MathArray<T, 3>& b) {
+        return inverse(t) * b;
+    }
+
+
+    /**
+      * PA = LU with partial pivoting, for any small N. L (unit diagonal, not
+      * stored) sits below the diagonal of lu and U on and above it; row i of
+      * lu came from row permutation[i] of the original. Decomposing never
+      * fails: a column with nothing to pivot on is skipped, which leaves a
+      * zero on U's diagonal, so determinant() comes out as 0 and solve() and
+      * inverse() throw.
+      */
+    template <class T, size_t N>
+    struct LUDecomposition {
+        Tensor<T, N, N> lu;
+        size_t permutation[N];
+        int sign;
+
+        constexpr bool singular() const noexcept {
+            for (size_t i = 0; i < N; ++i) {
+                if (this->lu.data[i * N + i] == T{}) {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        constexpr T determinant() const noexcept {
+            T output = T(this->sign);
+
+            for (size_t i = 0; i < N; ++i) {
+                output *= this->lu.data[i * N + i];
+            }
+
+            return output;
+        }
+
+        constexpr MathArray<T, N> solve(const MathArray<T, N>& b) const {
+            if (this->singular()) {
+                throw std::domain_error("Can't solve with a singular tensor");
+            }
+
+            const T* a = this->lu.data;
+            MathArray<T, N> x{};
+
+            // Forward substitution with L, then back substitution with U.
+            for (size_t i = 0; i < N; ++i) {
+                T sum = b[this->permutation[i]];
+
+                for (size_t k = 0; k < i; ++k) {
+                    sum -= a[i * N + k] * x[k];
+                }
+
+                x[i] = sum;
+            }
+
+            for (size_t i = N; i-- > 0;) {
+                T sum = x[i];
+
+                for (size_t k = i + 1; k < N; ++k) {
+                    sum -= a[i * N + k] * x[k];
+                }
+
+                x[i] = sum / a[i * N + i];
+            }
+
+            return x;
+        }
+
+        constexpr Tensor<T, N, N> inverse() const {
+            Tensor<T, N, N> output{};
+
+            for (size_t column = 0; column < N; ++column) {
+                MathArray<T, N> unit{};
+                unit[column] = T{1};
+
+                const MathArray<T, N> x = this->solve(unit);
+
+                for (size_t row = 0; row < N; ++row) {
+                    output.data[row * N + column] = x[row];
+                }
+            }
+
+            return output;
+        }
+    };
+
+    template <class T, size_t N>
+    constexpr LUDecomposition<T, N> lu_decompose(const Tensor<T, N, N>& t) noexcept {
+        LUDecomposition<T, N> output{t, {}, 1};
+        T* a = output.lu.data;
+
+        for (size_t i = 0; i < N; ++i) {
+            output.permutation[i] = i;
+        }
+
+        for (size_t k = 0; k < N; ++k) {
+            size_t pivot = k;
+            T largest = a[k * N + k] < T{} ? -a[k * N + k] : a[k * N + k];
+
+            for (size_t i = k + 1; i < N; ++i) {
+                const T size = a[i * N + k] < T{} ? -a[i * N + k] : a[i * N + k];
+
+                if (size > largest) {
+                    largest = size;
+                    pivot = i;
+                }
+            }
+
+            if (largest == T{}) {
+                continue;
+            }
+
+            if (pivot != k) {
+                for (size_t j = 0; j < N; ++j) {
+                    const T swap = a[k * N + j];
+                    a[k * N + j] = a[pivot * N + j];
+                    a[pivot * N + j] = swap;
+                }
+
+                const size_t swap = output.permutation[k];
+                output.permutation[k] = output.permutation[pivot];
+                output.permutation[pivot] = swap;
+                output.sign = -output.sign;
+            }
+
+            for (size_t i = k + 1; i < N; ++i) {
+                const T factor = a[i * N + k] / a[k * N + k];
+                a[i * N + k] = factor;
+
+                for (size_t j = k + 1; j < N; ++j) {
+                    a[i * N + j] -= factor * a[k * N + j];
+                }
+            }
+        }
+
+        return output;
+    }
+
+    template <class T, size_t N>
+    constexpr T determinant(const Tensor<T, N, N>& t) noexcept {
+        return lu_decompose(t).determinant();
+    }
+
+    template <class T, size_t N>
+    constexpr Tensor<T, N, N> inverse(const Tensor<T, N, N>& t) {
+        return lu_decompose(t).inverse();
+    }
+
+    template <class T, size_t N>
+    constexpr MathArray<T, N> solve(const Tensor<T, N, N>& t, const MathArray<T, N>& b) {
+        return lu_decompose(t).solve(b);
+    }
+
+
+    /**
+      * Eigenvalues (ascending) and orthonormal eigenvectors (as the columns
+      * of eigenvectors, in the same order) of a symmetric tensor, by cyclic
+      * Jacobi rotations. Only the upper triangle is trusted to be right.
+      * For 3x3s this converges in a handful of sweeps and, unlike the
+      * closed-form cubic, doesn't lose accuracy when eigenvalues are close.
+      */
+    template <class T, size_t N>
+    inline void symmetric_eigen(const Tensor<T, N, N>& t, MathArray<T, N>& eigenvalues, Tensor<T, N, N>& eigenvectors) {
+        constexpr size_t max_sweeps = 50;
+
+        Tensor<T, N, N> a{};
+        T norm_sq{};
+
+        for (size_t i = 0; i < N; ++i) {
+            for (size_t j = i; j < N; ++j) {
+                a.data[i * N + j] = a.data[j * N + i] = t.data[i * N + j];
+                norm_sq += (i == j ? 1 : 2) * t.data[i * N + j] * t.data[i * N + j];
+            }
+        }
+
+        T* const v = eigenvectors.data;
+        for (size_t i = 0; i < N * N; ++i) {
+            v[i] = T{};
+        }
+        for (size_t i = 0; i < N; ++i) {
+            v[i * N + i] = T{1};
+        }
+
+        const T threshold = norm_sq * std::numeric_limits<T>::epsilon() * std::numeric_limits<T>::epsilon();
+
+        for (size_t sweep = 0; sweep < max_sweeps; ++sweep) {
+            T off_diagonal{};
+
+            for (size_t p = 0; p < N; ++p) {
+                for (size_t q = p + 1; q < N; ++q) {
+                    off_diagonal += a.data[p * N + q] * a.data[p * N + q];
+                }
+            }
+
+            if (off_diagonal <= threshold) {
+                break;
+            }
+
+            for (size_t p = 0; p < N; ++p) {
+                for (size_t q = p + 1; q < N; ++q) {
+                    const T a_pq = a.data[p * N + q];
+
+                    if (a_pq == T{}) {
+                        continue;
+                    }
+
+                    // Rotate by the smaller angle that zeroes a_pq.
+                    const T theta = (a.data[q * N + q] - a.data[p * N + p]) / (2 * a_pq);
+                    const T tangent = (std::abs(theta) > T(1e150))
+                        ? T{1} / (2 * theta)
+                        : std::copysign(T{1}, theta) / (std::abs(theta) + std::sqrt(theta * theta + 1));
+                    const T c = 1 / std::sqrt(tangent * tangent + 1);
+                    const T s = tangent * c;
+
+                    for (size_t k = 0; k < N; ++k) {
+                        const T a_kp = a.data[k * N + p];
+                        const T a_kq = a.data[k * N + q];
+                        a.data[k * N + p] = c * a_kp - s * a_kq;
+                        a.data[k * N + q] = s * a_kp + c * a_kq;
+                    }
+
+                    for (size_t k = 0; k < N; ++k) {
+                        const T a_pk = a.data[p * N + k];
+                        const T a_qk = a.data[q * N + k];
+                        a.data[p * N + k] = c * a_pk - s * a_qk;
+                        a.data[q * N + k] = s * a_pk + c * a_qk;
+                    }
+
+                    a.data[p * N + q] = a.data[q * N + p] = T{};
+
+                    for (size_t k = 0; k < N; ++k) {
+                        const T v_kp = v[k * N + p];
+                        const T v_kq = v[k * N + q];
+                        v[k * N + p] = c * v_kp - s * v_kq;
+                        v[k * N + q] = s * v_kp + c * v_kq;
+                    }
+                }
+            }
+        }
+
+        for (size_t i = 0; i < N; ++i) {
+            eigenvalues[i] = a.data[i * N + i];
+        }
+
+        // Selection sort, swapping eigenvector columns along with the values.
+        for (size_t i = 0; i < N; ++i) {
+            size_t smallest = i;
+
+            for (size_t j = i + 1; j < N; ++j) {
+                if (eigenvalues[j] < eigenvalues[smallest]) {
+                    smallest = j;
+                }
+            }
+
+            if (smallest != i) {
+                std::swap(eigenvalues[i], eigenvalues[smallest]);
+
+                for (size_t k = 0; k < N; ++k) {
+                    std::swap(v[k * N + i], v[k * N + smallest]);
+                }
+            }
+        }
+    }
+
+
+    /**
+      * The above over n tensors at once, e.g. every pair block of a mobility
+      * matrix. Arrays are indexed together; outputs are overwritten.
+      */
+    template <class T, size_t N>
+    inline void determinant_batch(const Tensor<T, N, N>* tensors, T* determinants, const size_t n) noexcept {
+        for (size_t i = 0; i < n; ++i) {
+            determinants[i] = determinant(tensors[i]);
+        }
+    }
+
+    template <class T, size_t N>
+    inline void inverse_batch(const Tensor<T, N, N>* tensors, Tensor<T, N, N>* inverses, const size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            inverses[i] = inverse(tensors[i]);
+        }
+    }
+
+    template <class T, size_t N>
+    inline void solve_batch(const Tensor<T, N, N>* tensors, const MathArray<T, N>* rhs, MathArray<T, N>* solutions, const size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            solutions[i] = solve(tensors[i], rhs[i]);
+        }
+    }
+
+    template <class T, size_t N>
+    inline void symmetric_eigen_batch(const Tensor<T, N, N>* tensors, MathArray<T, N>* eigenvalues, Tensor<T, N, N>* eigenvectors, const size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            symmetric_eigen(tensors[i], eigenvalues[i], eigenvectors[i]);
+        }
+    }
+
 }
 
 template<class T, size_t N, size_t M>
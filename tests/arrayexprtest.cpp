@@ -0,0 +1,88 @@
+#include "arrayexpr.hpp"
+#include "arrayutils.hpp"
+#include "testutils.hpp"
+
+#include <type_traits>
+
+using namespace dav;
+
+void test_laziness() {
+    const LazyArray<double, 3> a{1, 2, 3};
+    const LazyArray<double, 3> b{4, 5, 6};
+    const MathArray<double, 3> c{7, 8, 9};
+
+    // Lazy operands build expressions, plain MathArrays still go through the
+    // eager operators.
+    static_assert(is_array_expression<std::decay_t<decltype(a + b)>>::value, "LazyArray sum wasn't lazy");
+    static_assert(is_array_expression<std::decay_t<decltype(a * c - 2.0)>>::value, "Mixed expression wasn't lazy");
+    static_assert(is_array_expression<std::decay_t<decltype(-a)>>::value, "Negation wasn't lazy");
+    static_assert(std::is_same<std::decay_t<decltype(c + c)>, MathArray<double, 3>>::value, "MathArray sum was lazy");
+}
+
+void test_arithmetic() {
+    const LazyArray<double, 4> a{1, 2, 3, 4};
+    const LazyArray<double, 4> b{-5, 0.5, 7, 11};
+    const LazyArray<double, 4> c{2, 4, 8, 16};
+    const MathArray<double, 4> d{3, -1, 4, -1};
+
+    const MathArray<double, 4> a_eager(a);
+    const MathArray<double, 4> b_eager(b);
+    const MathArray<double, 4> c_eager(c);
+
+    const MathArray<double, 4> lazy_result = a + b * c - d;
+    const MathArray<double, 4> eager_result = a_eager + b_eager * c_eager - d;
+    assert_all_eq(lazy_result, eager_result, "Failed fused add/multiply/subtract");
+
+    const LazyArray<double, 4> lazy_division = (a - 1.0) / c + 2.0 * -b;
+    const MathArray<double, 4> eager_division = (a_eager - 1.0) / c_eager + 2.0 * -b_eager;
+    assert_all_eq(lazy_division, eager_division, "Failed fused division/negation");
+
+    const MathArray<double, 4> scalar_first = 10.0 - a / 2.0;
+    assert_all_eq(scalar_first, MathArray<double, 4>{9.5, 9, 8.5, 8}, "Failed scalar on the left");
+
+    assert(evaluate(a * b).sum() == (a_eager * b_eager).sum(), "Failed evaluate");
+    assert((a * b).sum() == a_eager.dot(b_eager), "Failed expression sum");
+}
+
+void test_assignment() {
+    LazyArray<int, 5> a{1, 2, 3, 4, 5};
+    const LazyArray<int, 5> b{5, 4, 3, 2, 1};
+
+    // Aliasing is fine because everything is elementwise.
+    a = a * b + a;
+    assert_all_eq(a, MathArray<int, 5>{6, 10, 12, 12, 10}, "Failed aliased assignment");
+
+    MathArray<int, 5> m{1, 1, 1, 1, 1};
+    m += a - b;
+    assert_all_eq(m, MathArray<int, 5>{2, 7, 10, 11, 10}, "Failed compound addition of expression");
+
+    m -= b * 2;
+    assert_all_eq(m, MathArray<int, 5>{-8, -1, 4, 7, 8}, "Failed compound subtraction of expression");
+
+    m *= b + 0;
+    assert_all_eq(m, MathArray<int, 5>{-40, -4, 12, 14, 8}, "Failed compound multiplication by expression");
+
+    m /= b + b;
+    assert_all_eq(m, MathArray<int, 5>{-4, 0, 2, 3, 4}, "Failed compound division by expression");
+}
+
+void test_interop() {
+    const LazyArray<double, 3> a{3, 4, 0};
+    const LazyArray<double, 3> b{0, 4, 3};
+
+    // LazyArray is still a MathArray as far as everything else is concerned.
+    assert(magnitude(a) == 5, "Failed magnitude of LazyArray");
+    assert(distance_between(a, b) == magnitude(MathArray<double, 3>{3, 0, -3}), "Failed distance between LazyArrays");
+    assert(all(a <= MathArray<double, 3>{3, 4, 0}), "Failed comparison of LazyArray");
+    assert_all_eq(a.cross(b), MathArray<double, 3>{12, -9, 12}, "Failed cross product of LazyArrays");
+
+    const LazyArray<double, 3> zero{};
+    assert_all_eq(zero, MathArray<double, 3>{0, 0, 0}, "LazyArray wasn't zero-initialised");
+}
+
+int main() {
+    test_laziness();
+    test_arithmetic();
+    test_assignment();
+    test_interop();
+}
@@ -309,6 +309,50 @@ void test_dot_cross() {
     assert(a1.dot(a2) == 5477, "Failed dot product");
 }
 
+void test_double_vector_kernels() {
+    const MathArray<double, 3> a3{1.5, -2.25, 3.125};
+    const MathArray<double, 3> b3{-0.5, 4, 7.75};
+    const MathArray<double, 4> a4{1.5, -2.25, 3.125, 0.1};
+    const MathArray<double, 4> b4{-0.5, 4, 7.75, -9.3};
+
+    // The 3-vector kernels add up in the same order as the generic loops, so
+    // should agree exactly.
+    assert(magnitude_sq(a3) == magnitude_sq<double, 3>(a3), "Failed 3-vector magnitude_sq");
+    assert(magnitude(a3) == magnitude<double, 3>(a3), "Failed 3-vector magnitude");
+    assert(distance_between_sq(a3, b3) == distance_between_sq<double, 3>(a3, b3), "Failed 3-vector distance_sq");
+    assert(distance_between(a3, b3) == distance_between<double, 3>(a3, b3), "Failed 3-vector distance");
+    assert(a3.dot(b3) == (a3 * b3).sum(), "Failed 3-vector dot product");
+
+    assert(std::abs(magnitude_sq(a4) - magnitude_sq<double, 4>(a4)) < 1e-12, "Failed 4-vector magnitude_sq");
+    assert(std::abs(magnitude(a4) - magnitude<double, 4>(a4)) < 1e-12, "Failed 4-vector magnitude");
+    assert(std::abs(distance_between_sq(a4, b4) - distance_between_sq<double, 4>(a4, b4)) < 1e-12, "Failed 4-vector distance_sq");
+    assert(std::abs(distance_between(a4, b4) - distance_between<double, 4>(a4, b4)) < 1e-12, "Failed 4-vector distance");
+    assert(std::abs(a4.dot(b4) - (a4 * b4).sum()) < 1e-12, "Failed 4-vector dot product");
+
+    // Still usable in constant expressions, where the kernels take plain
+    // arithmetic that adds up in the same order as the SIMD paths.
+    constexpr MathArray<double, 3> p3{1, 2, 3};
+    constexpr MathArray<double, 3> q3{4, 6, 3};
+    constexpr MathArray<double, 4> p4{1, 2, 3, 4};
+    constexpr MathArray<double, 4> q4{2, 4, 6, 8};
+    static_assert(magnitude_sq(p3) == 14 && magnitude_sq(p4) == 30, "Failed constexpr magnitude_sq");
+    static_assert(magnitude(MathArray<double, 3>{2, 3, 6}) == 7 && magnitude(MathArray<double, 4>{1, 1, 1, 1}) == 2, "Failed constexpr magnitude");
+    static_assert(distance_between_sq(p3, q3) == 25 && distance_between_sq(p4, q4) == 30, "Failed constexpr distance_sq");
+    static_assert(distance_between(p3, q3) == 5, "Failed constexpr distance");
+    static_assert(p3.dot(q3) == 25 && p4.dot(q4) == 60, "Failed constexpr dot product");
+
+    constexpr double compile_time_3 = magnitude_sq(MathArray<double, 3>{1.5, -2.25, 3.125});
+    constexpr double compile_time_4 = distance_between_sq(MathArray<double, 4>{1.5, -2.25, 3.125, 0.1}, MathArray<double, 4>{-0.5, 4, 7.75, -9.3});
+    assert(compile_time_3 == magnitude_sq(a3), "Compile time 3-vector magnitude_sq differs from runtime");
+    assert(compile_time_4 == distance_between_sq(a4, b4), "Compile time 4-vector distance_sq differs from runtime");
+
+    // Cross product should be orthogonal to both inputs and follow the right
+    // hand rule.
+    const MathArray<double, 3> c3 = a3.cross(b3);
+    assert(std::abs(c3.dot(a3)) < 1e-12 && std::abs(c3.dot(b3)) < 1e-12, "Failed cross product orthogonality");
+    assert_all_eq(MathArray<double, 3>{1, 0, 0}.cross(MathArray<double, 3>{0, 1, 0}), MathArray<double, 3>{0, 0, 1}, "Failed right hand rule");
+}
+
 void test_set() {
     MathArray<int, 5> a1{1, 2, 3, 4, 5};
 
@@ -459,6 +503,7 @@ int main() {
     test_add_index();
 
     test_dot_cross();
+    test_double_vector_kernels();
 
     test_astype();
 
@@ -0,0 +1,226 @@
+#include "barneshut.hpp"
+#include "testutils.hpp"
+
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using namespace dav;
+
+struct Suspension {
+    VectorField positions;
+    VectorField forces;
+};
+
+Suspension random_suspension(const BoundingBox& bb, const size_t n, const unsigned seed) {
+    std::mt19937 engine(seed);
+    std::normal_distribution<double> component(0, 1);
+
+    Suspension output;
+    for (size_t i = 0; i < n; ++i) {
+        output.positions.push_back(bb.random_point_in_bounds(engine));
+        output.forces.push_back(MathArray<double, 3>{component(engine), component(engine), component(engine)});
+    }
+
+    return output;
+}
+
+template <class Flow>
+VectorField direct_flow(const Suspension& suspension, const double shear_viscosity) {
+    const size_t n = suspension.positions.size();
+    const VectorField& p = suspension.positions;
+    const VectorField& f = suspension.forces;
+    VectorField output(n);
+
+    for (size_t i = 0; i < n; ++i) {
+        double ux = 0;
+        double uy = 0;
+        double uz = 0;
+
+        Flow::accumulate(p[i][0], p[i][1], p[i][2], p.x().data(), p.y().data(), p.z().data(), f.x().data(), f.y().data(), f.z().data(), 0, i, ux, uy, uz);
+        Flow::accumulate(p[i][0], p[i][1], p[i][2], p.x().data(), p.y().data(), p.z().data(), f.x().data(), f.y().data(), f.z().data(), i + 1, n, ux, uy, uz);
+
+        output[i] = MathArray<double, 3>{ux, uy, uz} / (8 * M_PI * shear_viscosity);
+    }
+
+    return output;
+}
+
+// Root-mean-square error relative to the root-mean-square flow.
+double relative_error(const VectorField& approximate, const VectorField& exact) {
+    double error = 0;
+    double norm = 0;
+
+    for (size_t i = 0; i < exact.size(); ++i) {
+        error += magnitude_sq(approximate[i].get() - exact[i].get());
+        norm += magnitude_sq(exact[i].get());
+    }
+
+    return std::sqrt(error / norm);
+}
+
+void test_stokeslet_kernel() {
+    // One force, one target, against the Stokeslet written out in full.
+    const MathArray<double, 3> r{1, -2, 0.5};
+    const MathArray<double, 3> f{0.3, 0.1, -1};
+    const double x = 0, y = 0, z = 0;
+    double ux = 0, uy = 0, uz = 0;
+
+    stokeslet_flow_accumulate(r[0], r[1], r[2], &x, &y, &z, &f[0], &f[1], &f[2], 0, 1, ux, uy, uz);
+
+    const double r_mag = magnitude(r);
+    const MathArray<double, 3> expected = f / r_mag + r * ((r * f).sum() / (r_mag * r_mag * r_mag));
+    assert_all_approx_eq(MathArray<double, 3>{ux, uy, uz}, expected, 1e-14, "Stokeslet kernel is wrong");
+}
+
+template <class Flow>
+void check_accuracy(const BoundingBox& bb, const Suspension& suspension) {
+    const VectorField exact = direct_flow<Flow>(suspension, 0.7);
+
+    // theta = 0 never expands anything, so it's the direct sum.
+    BarnesHutTree<Flow> exact_tree(bb, 0, 8);
+    exact_tree.build(suspension.positions, suspension.forces);
+    VectorField velocities;
+    exact_tree.flow_at_sources(0.7, velocities);
+    assert(relative_error(velocities, exact) < 1e-13, "Barnes-Hut with theta = 0 isn't the direct sum");
+
+    // The error shrinks like theta^2.
+    double previous_error = 1;
+    for (const double theta : {0.8, 0.4, 0.2}) {
+        BarnesHutTree<Flow> tree(bb, theta, 8, 3);
+        tree.build(suspension.positions, suspension.forces);
+        tree.flow_at_sources(0.7, velocities);
+
+        const double error = relative_error(velocities, exact);
+        assert(error < 0.3 * theta * theta, "Barnes-Hut error is too big");
+        assert(error < previous_error / 2, "Barnes-Hut error doesn't shrink with theta");
+        previous_error = error;
+    }
+}
+
+template <class Flow>
+void check_large_theta(const BoundingBox& bb, const Suspension& suspension) {
+    const VectorField exact = direct_flow<Flow>(suspension, 0.7);
+
+    // Past theta = 1 a target can be far enough from its own cell's centre
+    // to pass the theta test, but that cell still contains it, so it must
+    // not be expanded. The result should be no worse than theta = 1.
+    BarnesHutTree<Flow> reference_tree(bb, 1, 8, 3);
+    reference_tree.build(suspension.positions, suspension.forces);
+    VectorField reference;
+    reference_tree.flow_at_sources(0.7, reference);
+    const double reference_error = relative_error(reference, exact);
+
+    for (const double theta : {1.5, 4.0, 100.0}) {
+        BarnesHutTree<Flow> tree(bb, theta, 8, 3);
+        tree.build(suspension.positions, suspension.forces);
+        VectorField velocities;
+        tree.flow_at_sources(0.7, velocities);
+
+        const double error = relative_error(velocities, exact);
+        assert(error <= reference_error && error < 0.3, "Barnes-Hut with theta > 1 expanded a cell containing the target");
+    }
+}
+
+void test_accuracy() {
+    const BoundingBox bb(0, 20, 0, 20, 0.5, 20.5);
+    const Suspension suspension = random_suspension(bb, 2000, 5);
+
+    check_accuracy<StokesletFlow>(bb, suspension);
+    check_accuracy<BlakeFlow>(bb, suspension);
+
+    check_large_theta<StokesletFlow>(bb, suspension);
+    check_large_theta<BlakeFlow>(bb, suspension);
+}
+
+void test_field_points() {
+    const BoundingBox bb(0, 10, 0, 10, 1, 11);
+    const Suspension suspension = random_suspension(bb, 500, 7);
+
+    BarnesHutTree<BlakeFlow> tree(bb, 0.25);
+    tree.build(suspension.positions.to_vector(), suspension.forces.to_vector());
+
+    const VectorField& p = suspension.positions;
+    const VectorField& f = suspension.forces;
+
+    const auto exact_flow_at = [&](const MathArray<double, 3>& target) {
+        double ux = 0, uy = 0, uz = 0;
+        blake_flow_accumulate(target[0], target[1], target[2], p.x().data(), p.y().data(), p.z().data(), f.x().data(), f.y().data(), f.z().data(), 0, p.size(), ux, uy, uz);
+
+        return MathArray<double, 3>{ux, uy, uz} / (8 * M_PI);
+    };
+
+    // Near the wall the real and image contributions nearly cancel, so the
+    // errors are measured against the flow in the middle of the cloud.
+    const double scale = magnitude(exact_flow_at(MathArray<double, 3>{5, 5, 5}));
+
+    for (const MathArray<double, 3>& target : {MathArray<double, 3>{5, 5, 5}, MathArray<double, 3>{3.3, 8.1, 1.2}, MathArray<double, 3>{40, -10, 30}}) {
+        assert(magnitude(tree.flow_at(target, 1) - exact_flow_at(target)) < 1e-2 * scale, "Barnes-Hut flow at a field point is wrong");
+    }
+
+    // New forces on the same tree.
+    VectorField doubled(p.size());
+    for (size_t i = 0; i < p.size(); ++i) {
+        doubled[i] = 2.0 * f[i].get();
+    }
+
+    const MathArray<double, 3> before = tree.flow_at(MathArray<double, 3>{5, 5, 5}, 1);
+    tree.set_forces(doubled);
+    assert_all_approx_eq(tree.flow_at(MathArray<double, 3>{5, 5, 5}, 1), 2.0 * before, 1e-12, "set_forces didn't update the expansions");
+}
+
+void test_awkward_inputs() {
+    const BoundingBox bb(0, 1, 0, 1, 1, 2);
+
+    // Some particles outside the box, and a tight clump of them.
+    Suspension suspension = random_suspension(bb, 200, 9);
+    suspension.positions[0] = MathArray<double, 3>{-3, 0.5, 1.5};
+    suspension.positions[1] = MathArray<double, 3>{0.5, 4, 3};
+    for (size_t i = 2; i < 40; ++i) {
+        suspension.positions[i] = MathArray<double, 3>{0.25 + 1e-3 * i, 0.25, 1.25};
+    }
+
+    const VectorField exact = direct_flow<BlakeFlow>(suspension, 1);
+
+    BarnesHutTree<BlakeFlow> tree(bb, 0.3, 4);
+    tree.build(suspension.positions, suspension.forces);
+    VectorField velocities;
+    tree.flow_at_sources(1, velocities);
+    assert(relative_error(velocities, exact) < 1e-2, "Barnes-Hut fails with particles outside the box");
+
+    // Particles exactly on top of each other can't be split apart, so the
+    // tree has to stop at its depth limit.
+    for (size_t i = 2; i < 40; ++i) {
+        suspension.positions[i] = MathArray<double, 3>{0.25, 0.25, 1.25};
+    }
+    BarnesHutTree<StokesletFlow> stokeslet_tree(bb, 0.3, 4);
+    stokeslet_tree.build(suspension.positions, suspension.forces);
+
+    const MathArray<double, 3> far{5, 5, 5};
+    const VectorField& p = suspension.positions;
+    const VectorField& f = suspension.forces;
+    double ux = 0, uy = 0, uz = 0;
+    stokeslet_flow_accumulate(far[0], far[1], far[2], p.x().data(), p.y().data(), p.z().data(), f.x().data(), f.y().data(), f.z().data(), 0, p.size(), ux, uy, uz);
+    const MathArray<double, 3> exact_far = MathArray<double, 3>{ux, uy, uz} / (8 * M_PI);
+    assert(magnitude(stokeslet_tree.flow_at(far, 1) - exact_far) < 1e-2 * magnitude(exact_far), "Barnes-Hut fails with coincident particles");
+
+    BarnesHutTree<BlakeFlow> empty(bb);
+    empty.build(VectorField(), VectorField());
+    assert_all_eq(empty.flow_at(MathArray<double, 3>{0.5, 0.5, 1.5}, 1), MathArray<double, 3>{}, "Empty tree has a flow");
+
+    bool caught = false;
+    try {
+        BarnesHutTree<BlakeFlow> bad(bb, -1);
+    } catch (const std::invalid_argument&) {
+        caught = true;
+    }
+    assert(caught, "Negative theta was accepted");
+}
+
+int main() {
+    test_stokeslet_kernel();
+    test_accuracy();
+    test_field_points();
+    test_awkward_inputs();
+}
@@ -2,7 +2,9 @@
 #include "arrayutils.hpp"
 #include "testutils.hpp"
 
+#include <cmath>
 #include <random>
+#include <vector>
 
 using namespace dav;
 
@@ -136,6 +138,41 @@ void test_random() {
     }
 }
 
+void test_surface_faces() {
+    std::mt19937 engine(7);
+    const BoundingBox bb(0, 1, 0, 2, 0, 3);
+
+    // Faces in the order lower x, upper x, lower y, upper y, lower z, upper z.
+    const double total = 2 * (bb.get_xsurface() + bb.get_ysurface() + bb.get_zsurface());
+    const std::vector<double> expected{
+        bb.get_xsurface() / total, bb.get_xsurface() / total,
+        bb.get_ysurface() / total, bb.get_ysurface() / total,
+        bb.get_zsurface() / total, bb.get_zsurface() / total
+    };
+
+    std::vector<double> frequencies(6, 0);
+    const int n = 1'000'000;
+    for (int i = 0; i < n; ++i) {
+        const auto pt = bb.random_point_on_surface(engine);
+
+        for (size_t axis = 0; axis < 3; ++axis) {
+            if (pt[axis] == bb.get_lower_bounds()[axis]) {
+                frequencies[2 * axis] += 1.0 / n;
+            } else if (pt[axis] == bb.get_upper_bounds()[axis]) {
+                frequencies[2 * axis + 1] += 1.0 / n;
+            }
+        }
+    }
+
+    assert_all_approx_eq(frequencies, expected, 2e-3, "Failed surface face frequencies");
+
+    // A flat box only has its two big faces.
+    const BoundingBox flat(0, 4, 0, 4, 1, 1);
+    for (int i = 0; i < 1000; ++i) {
+        assert(flat.random_point_on_surface(engine)[2] == 1, "Failed surface point on flat box");
+    }
+}
+
 void test_area() {
     const BoundingBox bb(13, 17, 23);
 
@@ -152,6 +189,72 @@ void test_elementwise_filters() {
     assert_all_eq(elementwise_min(a1, a2), {0.5, 2, 3, -1, 5}, "Failed elementwise_max test");
 }
 
+void test_boundary_policies() {
+    const BoundingBox box(0, 10, -5, 5, 0, 20);
+
+    // Reflecting matches the existing reflection.
+    {
+        const MathArray<double, 3> outside{12, -6.5, -3};
+        assert_all_eq(ReflectingBoundaries::apply(box, outside), box.reflect(outside), "Reflecting policy disagrees with reflect");
+        assert_all_eq(ReflectingBoundaries::apply(box, MathArray<double, 3>{1, 2, 3}), MathArray<double, 3>{1, 2, 3}, "Reflecting policy moved an inside point");
+    }
+
+    // Periodic wraps however far outside the point is.
+    {
+        assert_all_approx_eq(PeriodicBoundaries::apply(box, MathArray<double, 3>{12, -6.5, -3}), MathArray<double, 3>{2, 3.5, 17}, 1e-12, "Failed periodic wrap");
+        assert_all_approx_eq(PeriodicBoundaries::apply(box, MathArray<double, 3>{-27, 16, 65}), MathArray<double, 3>{3, -4, 5}, 1e-12, "Failed periodic multiple wrap");
+        assert_all_eq(PeriodicBoundaries::apply(box, MathArray<double, 3>{1, 2, 3}), MathArray<double, 3>{1, 2, 3}, "Periodic policy moved an inside point");
+    }
+
+    // Mixed: periodic sideways, wall in z.
+    {
+        MathArray<double, 3> position{-1, 7, -2};
+        BlakeBoundaries::apply_situ(box, position);
+        assert_all_approx_eq(position, MathArray<double, 3>{9, -3, 2}, 1e-12, "Failed mixed boundary conditions");
+    }
+
+    // Minimum image separations
+    {
+        const MathArray<double, 3> a{0.5, 4.5, 1};
+        const MathArray<double, 3> b{9.5, -4.5, 19};
+
+        assert_all_approx_eq(PeriodicBoundaries::displacement(box, a, b), MathArray<double, 3>{1, -1, 2}, 1e-12, "Failed periodic minimum image");
+        assert_all_approx_eq(BlakeBoundaries::displacement(box, a, b), MathArray<double, 3>{1, -1, -18}, 1e-12, "Failed mixed minimum image");
+        assert(std::abs(PeriodicBoundaries::distance_between(box, a, b) - std::sqrt(6)) < 1e-12, "Failed periodic distance");
+        assert(std::abs(ReflectingBoundaries::distance_between_sq(box, a, b) - distance_between_sq(a, b)) < 1e-12, "Failed reflecting distance");
+    }
+
+    // Batched over a whole array matches one at a time.
+    {
+        std::mt19937 engine(3);
+        std::uniform_real_distribution<double> dist(-30, 30);
+
+        const size_t n = 101;
+        std::vector<double> x(n), y(n), z(n);
+        std::vector<MathArray<double, 3>> positions(n);
+        for (size_t i = 0; i < n; ++i) {
+            positions[i] = MathArray<double, 3>{dist(engine), dist(engine), dist(engine) / 10 + 10};
+            x[i] = positions[i][0];
+            y[i] = positions[i][1];
+            z[i] = positions[i][2];
+        }
+
+        std::vector<MathArray<double, 3>> expected(positions);
+        for (auto& position : expected) {
+            BlakeBoundaries::apply_situ(box, position);
+        }
+
+        BlakeBoundaries::apply(box, x.data(), y.data(), z.data(), n);
+        BlakeBoundaries::apply(box, positions);
+
+        for (size_t i = 0; i < n; ++i) {
+            assert_all_eq(MathArray<double, 3>{x[i], y[i], z[i]}, expected[i], "Failed batched boundary conditions");
+            assert_all_eq(positions[i], expected[i], "Failed vector boundary conditions");
+            assert(box.in_bounds(expected[i]), "Boundary conditions left a particle outside");
+        }
+    }
+}
+
 int main() {
     test_contains();
     test_reflect();
@@ -160,6 +263,8 @@ int main() {
     test_constructors();
     test_random();
     test_area();
+    test_surface_faces();
     test_elementwise_filters();
+    test_boundary_policies();
 
 }
@@ -0,0 +1,143 @@
+#include "celllist.hpp"
+#include "boundingbox.hpp"
+#include "particleset.hpp"
+#include "testutils.hpp"
+
+#include <algorithm>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+using namespace dav;
+
+using PairSet = std::set<std::pair<size_t, size_t>>;
+
+std::pair<size_t, size_t> ordered(const size_t i, const size_t j) {
+    return std::make_pair(std::min(i, j), std::max(i, j));
+}
+
+PairSet brute_force_pairs(const VectorField& positions, const double cutoff) {
+    PairSet output;
+
+    for (size_t i = 0; i < positions.size(); ++i) {
+        for (size_t j = i + 1; j < positions.size(); ++j) {
+            if (distance_between(positions[i].get(), positions[j].get()) < cutoff) {
+                output.insert(ordered(i, j));
+            }
+        }
+    }
+
+    return output;
+}
+
+PairSet cell_list_pairs(const CellList& cells, const VectorField& positions) {
+    PairSet output;
+
+    cells.for_each_neighbour_pair(positions, [&](const size_t i, const size_t j, const double r_sq) {
+        assert(std::abs(r_sq - distance_between_sq(positions[i].get(), positions[j].get())) < 1e-12, "Wrong squared distance passed to callback");
+        assert(output.insert(ordered(i, j)).second, "Pair visited twice");
+    });
+
+    return output;
+}
+
+void test_pairs_match_brute_force() {
+    std::mt19937 engine(7);
+    const BoundingBox bb(-10, 10, -7, 13, 0, 9);
+    const double cutoff = 1.7;
+
+    VectorField positions;
+    for (size_t i = 0; i < 800; ++i) {
+        positions.push_back(bb.random_point_in_bounds(engine));
+    }
+
+    CellList cells(bb, cutoff);
+    cells.build(positions);
+
+    assert(cells.get_cells_per_axis()[0] == 11 && cells.get_cells_per_axis()[1] == 11 && cells.get_cells_per_axis()[2] == 5, "Wrong number of cells");
+    assert(cell_list_pairs(cells, positions) == brute_force_pairs(positions, cutoff), "Cell list pairs don't match brute force");
+
+    // Jiggle the particles and check the incremental update agrees too.
+    std::normal_distribution<double> jiggle(0, 0.3);
+    for (size_t i = 0; i < positions.size(); ++i) {
+        positions[i] = bb.reflect(positions[i].get() + MathArray<double, 3>{jiggle(engine), jiggle(engine), jiggle(engine)});
+    }
+
+    const size_t moved = cells.update(positions);
+    assert(moved > 0 && moved < positions.size(), "Incremental update moved an unlikely number of particles");
+    assert(cell_list_pairs(cells, positions) == brute_force_pairs(positions, cutoff), "Updated cell list pairs don't match brute force");
+
+    // A fresh build should put everything in the same cells.
+    CellList rebuilt(bb, cutoff);
+    rebuilt.build(positions);
+    for (size_t i = 0; i < positions.size(); ++i) {
+        assert(rebuilt.cell_of(i) == cells.cell_of(i), "Incremental update disagrees with rebuild");
+    }
+}
+
+void test_iterator() {
+    std::mt19937 engine(11);
+    const BoundingBox bb(8, 8, 8);
+
+    std::vector<MathArray<double, 3>> positions;
+    for (size_t i = 0; i < 300; ++i) {
+        positions.push_back(bb.random_point_in_bounds(engine));
+    }
+
+    CellList cells(bb, 2.0);
+    cells.build(positions);
+
+    std::vector<std::pair<size_t, size_t>> from_callback;
+    cells.for_each_pair([&](const size_t i, const size_t j) {
+        from_callback.emplace_back(i, j);
+    });
+
+    std::vector<std::pair<size_t, size_t>> from_iterator;
+    for (const auto pair : cells.pairs()) {
+        from_iterator.push_back(pair);
+    }
+
+    assert(!from_iterator.empty(), "Iterator found no pairs");
+    assert(from_iterator == from_callback, "Iterator and callback disagree");
+
+    // Empty list
+    CellList empty(bb, 2.0);
+    empty.build(std::vector<MathArray<double, 3>>{});
+    assert(empty.pairs().begin() == empty.pairs().end(), "Empty cell list has pairs");
+}
+
+void test_edge_cases() {
+    const BoundingBox bb(10, 10, 10);
+
+    // Cutoff bigger than the box: everything is in one cell.
+    {
+        CellList cells(bb, 50);
+        assert(cells.cell_count() == 1, "Oversized cutoff should give one cell");
+    }
+
+    // Particles outside the box are clamped to the edge cells rather than lost.
+    {
+        const std::vector<MathArray<double, 3>> positions{{-5.5, 0, 0}, {-4.8, 0, 0}, {100, 100, 100}};
+        CellList cells(bb, 1.0);
+        cells.build(positions);
+
+        size_t count = 0;
+        for (const auto pair : cells.pairs()) {
+            assert(pair == std::make_pair<size_t, size_t>(0, 1), "Wrong pair for out-of-bounds particles");
+            ++count;
+        }
+        assert(count == 1, "Didn't find the out-of-bounds pair");
+    }
+
+    try {
+        CellList cells(bb, 0);
+        assert(false, "Failed to reject zero cutoff");
+    } catch (std::invalid_argument&) {}
+}
+
+int main() {
+    test_pairs_match_brute_force();
+    test_iterator();
+    test_edge_cases();
+}
@@ -0,0 +1,120 @@
+#include "config.hpp"
+#include "testutils.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+using namespace dav;
+
+const std::string config_path = "./configtest.ini";
+
+void write_config() {
+    std::ofstream file(config_path);
+
+    file << "[simulation]\n"
+         << "particles = 1000\n"
+         << "timestep = 1e-3\n"
+         << "name = blake test\n"
+         << "big = 5000000000\n"
+         << "negative = -12\n"
+         << "bad = 3x\n"
+         << "\n"
+         << "[fluid]\n"
+         << "viscosity = 0.5\n"
+         << "particles = 7\n"
+         << "\n"
+         << "[Integrator]\n"
+         << "Dt = 0.5\n"
+         << "MaxSteps = 20\n";
+}
+
+void test_get() {
+    const Config config(config_path);
+
+    assert(config.get_int("simulation", "particles") == 1000, "Failed int lookup");
+    assert(config.get_double("simulation", "timestep") == 1e-3, "Failed double lookup");
+    assert(config.get_double("simulation", "particles") == 1000.0, "Failed integer as double lookup");
+    assert(config.get_string("simulation", "name") == "blake test", "Failed string lookup");
+    assert(config.get<long>("simulation", "big") == 5000000000L, "Failed long lookup");
+    assert(config.get<unsigned>("simulation", "particles") == 1000u, "Failed unsigned lookup");
+    assert(config.get<float>("fluid", "viscosity") == 0.5f, "Failed float lookup");
+    assert(config.get_int("fluid", "particles") == 7, "Failed lookup of key repeated in another section");
+
+    assert(config.has("fluid", "viscosity"), "Failed has for existing key");
+    assert(!config.has("fluid", "timestep"), "Failed has for missing key");
+    assert(!config.has("simulationparticles", ""), "Failed has for run together key");
+
+    try {
+        config.get_int("fluid", "timestep");
+        assert(false, "Failed to throw on missing key");
+    } catch (std::invalid_argument&) {}
+
+    try {
+        config.get_int("simulation", "big");
+        assert(false, "Failed to throw on int overflow");
+    } catch (number_format_exception&) {}
+
+    try {
+        config.get<unsigned>("simulation", "negative");
+        assert(false, "Failed to throw on negative unsigned");
+    } catch (number_format_exception&) {}
+
+    try {
+        config.get_double("simulation", "bad");
+        assert(false, "Failed to throw on bad double");
+    } catch (std::runtime_error&) {}
+}
+
+void test_case_insensitive() {
+    const Config config(config_path);
+
+    assert(config.get_double("integrator", "dt") == 0.5, "Failed lower case lookup of mixed case key");
+    assert(config.get_double("INTEGRATOR", "DT") == 0.5, "Failed upper case lookup of mixed case key");
+    assert(config.get_int("Integrator", "maxSTEPS") == 20, "Failed mixed case lookup");
+    assert(config.get_int("Simulation", "Particles") == 1000, "Failed mixed case lookup of lower case key");
+    assert(config.has("FLUID", "Viscosity"), "Failed mixed case has");
+    assert(!config.has("integrator", "dt2"), "Failed has for missing key after case folding");
+
+    const Config::Handle<double> dt = config.handle<double>("INTEGRATOR", "dt");
+    assert(*dt == 0.5, "Failed mixed case handle");
+}
+
+void test_handles() {
+    const Config config(config_path);
+
+    const Config::Handle<double> timestep = config.handle<double>("simulation", "timestep");
+    const Config::Handle<int> particles = config.handle<int>("simulation", "particles");
+    const Config::Handle<std::string> name = config.handle<std::string>("simulation", "name");
+
+    assert(timestep.get() == 1e-3, "Failed double handle");
+    assert(*particles == 1000, "Failed int handle");
+    assert(name.get() == "blake test", "Failed string handle");
+
+    const double doubled = 2 * timestep;
+    assert(doubled == 2e-3, "Failed handle conversion");
+
+    try {
+        config.handle<int>("simulation", "name");
+        assert(false, "Failed to throw resolving bad handle");
+    } catch (number_format_exception&) {}
+}
+
+void test_copy() {
+    const Config original(config_path);
+    const Config copy(original);
+
+    assert(copy.get_int("simulation", "particles") == 1000, "Failed lookup in copied config");
+    assert(copy.get_file_path() == config_path, "Failed to copy file path");
+}
+
+int main() {
+    write_config();
+
+    test_get();
+    test_case_insensitive();
+    test_handles();
+    test_copy();
+
+    std::remove(config_path.c_str());
+}
@@ -0,0 +1,201 @@
+#include "dynarray.hpp"
+#include "testutils.hpp"
+
+#include <cstdint>
+#include <stdexcept>
+
+using namespace dav;
+
+template <class F>
+bool throws_invalid_argument(F&& f) {
+    try {
+        f();
+    } catch (const std::invalid_argument&) {
+        return true;
+    }
+
+    return false;
+}
+
+void test_dynarray_basics() {
+    DynArray<double> a(1000, 2.5);
+    assert(a.size() == 1000 && a[999] == 2.5, "Wrong size or fill value");
+    assert(reinterpret_cast<std::uintptr_t>(a.data()) % 64 == 0, "DynArray storage isn't cache-line aligned");
+
+    DynArray<double> b{1, 2, 3, 4};
+    assert(b.size() == 4 && b.front() == 1 && b.back() == 4, "Initializer list not copied");
+
+    b.at(2) = 10;
+    assert(b[2] == 10, "at() didn't write");
+
+    bool thrown = false;
+    try {
+        b.at(4);
+    } catch (const std::range_error&) {
+        thrown = true;
+    }
+    assert(thrown, "Out of range at() should throw");
+
+    b.resize(6, -1.0);
+    assert(b.size() == 6 && b[5] == -1, "resize didn't fill");
+
+    const Span<double> span = b.span();
+    assert(span.data() == b.data() && span.size() == b.size(), "Span doesn't cover the array");
+}
+
+void test_dynarray_reductions() {
+    const DynArray<double> a{1, 2, 3, 4};
+    const MathArray<double, 4> fixed{1, 2, 3, 4};
+
+    assert(a.sum() == fixed.sum(), "Wrong sum");
+    assert(a.prod() == fixed.prod(), "Wrong prod");
+    assert_all_eq(a.cumsum().to_fixed<4>(), fixed.cumsum(), "Wrong cumsum");
+    assert_all_eq(a.cumprod().to_fixed<4>(), fixed.cumprod(), "Wrong cumprod");
+    assert(a.dot(a) == fixed.dot(fixed), "Wrong dot product");
+    assert(a.dot(fixed) == 30, "Wrong dot product with a MathArray");
+    assert(magnitude_sq(a) == 30, "Wrong magnitude_sq");
+
+    DynArray<double> b{3, 4};
+    b.normalise();
+    assert(std::abs(magnitude(b) - 1) < 1e-15, "normalise didn't give a unit vector");
+
+    const DynArray<double> empty;
+    assert(empty.sum() == 0 && empty.prod() == 1 && empty.empty(), "Wrong reductions of an empty array");
+
+    assert(throws_invalid_argument([&]() { a.dot(b); }), "Dot product of mismatched sizes should throw");
+}
+
+void test_dynarray_arithmetic() {
+    const DynArray<double> a{1, 2, 3};
+    const DynArray<double> b{4, -5, 6};
+    const MathArray<double, 3> fa{1, 2, 3};
+    const MathArray<double, 3> fb{4, -5, 6};
+
+    // Everything should agree with MathArray's arithmetic.
+    assert_all_eq((a + b).to_fixed<3>(), fa + fb, "Wrong sum");
+    assert_all_eq((a - b).to_fixed<3>(), fa - fb, "Wrong difference");
+    assert_all_eq((a * b).to_fixed<3>(), fa * fb, "Wrong product");
+    assert_all_eq((a / b).to_fixed<3>(), fa / fb, "Wrong quotient");
+    assert_all_eq((-a).to_fixed<3>(), -fa, "Wrong negation");
+
+    assert_all_eq((a + 2.0).to_fixed<3>(), fa + 2.0, "Wrong scalar sum");
+    assert_all_eq((2.0 - a).to_fixed<3>(), 2.0 - fa, "Wrong scalar difference");
+    assert_all_eq((a * 3.0).to_fixed<3>(), fa * 3.0, "Wrong scalar product");
+    assert_all_eq((3.0 / a).to_fixed<3>(), 3.0 / fa, "Wrong scalar quotient");
+
+    // Mixed fixed and dynamic.
+    assert_all_eq((a + fb).to_fixed<3>(), fa + fb, "Wrong mixed sum");
+    assert_all_eq((fa - b).to_fixed<3>(), fa - fb, "Wrong mixed difference");
+    assert_all_eq((fa * b).to_fixed<3>(), fa * fb, "Wrong mixed product");
+    assert_all_eq((a / fb).to_fixed<3>(), fa / fb, "Wrong mixed quotient");
+
+    DynArray<double> c = a;
+    c += b;
+    c *= 2.0;
+    c -= fa;
+    c /= fb;
+    assert_all_eq(c.to_fixed<3>(), ((fa + fb) * 2.0 - fa) / fb, "Wrong compound assignment");
+
+    assert_all_eq(abs(b).to_fixed<3>(), abs(fb), "Wrong abs");
+    assert_all_eq(pow(a, 2.0).to_fixed<3>(), pow(fa, 2.0), "Wrong pow");
+
+    const DynArray<double> longer{1, 2, 3, 4};
+    assert(throws_invalid_argument([&]() { a + longer; }), "Mismatched sum should throw");
+    assert(throws_invalid_argument([&]() { longer * fa; }), "Mismatched mixed product should throw");
+    assert(throws_invalid_argument([&]() { c += longer; }), "Mismatched compound assignment should throw");
+}
+
+void test_dynarray_fixed_interop() {
+    // Particle-sized buffer of interleaved 3-vectors.
+    DynArray<double> positions(30);
+    for (size_t i = 0; i < 10; ++i) {
+        positions.set_fixed(3 * i, MathArray<double, 3>{double(i), 2.0 * i, -1.0 * i});
+    }
+
+    assert_all_eq(positions.to_fixed<3>(12), MathArray<double, 3>{4, 8, -4}, "Wrong particle read back");
+    assert(throws_invalid_argument([&]() { positions.to_fixed<3>(28); }), "Reading past the end should throw");
+
+    const DynArray<double> from_fixed(MathArray<double, 3>{7, 8, 9});
+    assert(from_fixed.size() == 3 && from_fixed[2] == 9, "Conversion from MathArray failed");
+}
+
+void test_dynmatrix() {
+    DynMatrix<double> m(4, 3);
+    assert(m.rows() == 4 && m.columns() == 3 && m.size() == 12, "Wrong matrix shape");
+    assert(reinterpret_cast<std::uintptr_t>(m.data()) % 64 == 0, "DynMatrix storage isn't cache-line aligned");
+
+    for (size_t i = 0; i < 4; ++i) {
+        for (size_t j = 0; j < 3; ++j) {
+            m[{i, j}] = 10.0 * i + j;
+        }
+    }
+
+    assert(m.at(3, 2) == 32 && m.row(2)[1] == 21, "Wrong element access");
+
+    const DynMatrix<double> t = m.transpose();
+    assert(t.rows() == 3 && t[{2, 3}] == 32, "Wrong transpose");
+
+    // Agrees with Tensor for products.
+    const Tensor<double, 3, 2> tensor_b{1, 2,
+                                        3, 4,
+                                        5, 6};
+    const Tensor<double, 4, 3> tensor_a = m.to_fixed<4, 3>();
+    const Tensor<double, 4, 2> expected = tensor_a * tensor_b;
+    const DynMatrix<double> product = m * DynMatrix<double>(tensor_b);
+
+    assert(product.rows() == 4 && product.columns() == 2, "Wrong product shape");
+    const Tensor<double, 4, 2> product_fixed = product.to_fixed<4, 2>();
+    assert(std::equal(std::begin(product_fixed.data), std::end(product_fixed.data), std::begin(expected.data)), "Wrong matrix product");
+
+    const MathArray<double, 3> v{1, -1, 2};
+    assert_all_eq((m * v).to_fixed<4>(), tensor_a * v, "Wrong matrix times MathArray");
+    assert_all_eq((m * DynArray<double>(v)).to_fixed<4>(), tensor_a * v, "Wrong matrix times DynArray");
+    assert_all_eq(tensor_a * DynArray<double>(v), tensor_a * v, "Wrong Tensor times DynArray");
+
+    assert(throws_invalid_argument([&]() { m * m; }), "Mismatched matrix product should throw");
+    assert(throws_invalid_argument([&]() { m * DynArray<double>(4); }), "Mismatched matrix-vector product should throw");
+    assert(throws_invalid_argument([&]() { m.to_fixed<3, 3>(); }), "Wrong-shape to_fixed should throw");
+
+    const DynMatrix<double> sum = m + m - 0.5 * m;
+    assert(sum[{3, 1}] == 1.5 * 31 && sum.sum() == 1.5 * m.sum(), "Wrong matrix arithmetic");
+
+    const DynMatrix<double> identity = DynMatrix<double>::identity(5);
+    assert(identity.trace() == 5 && identity.sum() == 5, "Wrong identity");
+}
+
+void test_dynmatrix_blocks() {
+    // 3N x 3N matrix built from 3x3 pair blocks, the mobility matrix layout.
+    const size_t n = 4;
+    DynMatrix<double> matrix(3 * n, 3 * n);
+
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < n; ++j) {
+            Tensor<double, 3, 3> block{};
+            for (size_t k = 0; k < 9; ++k) {
+                block.data[k] = 100.0 * i + 10.0 * j + k;
+            }
+            matrix.set_block(3 * i, 3 * j, block);
+        }
+    }
+
+    const Tensor<double, 3, 3> block = matrix.block<3, 3>(6, 3);
+    assert(block[{0, 0}] == 210 && block[{2, 2}] == 218, "Wrong block read back");
+    assert(matrix[{7, 5}] == 215, "Block in the wrong place");
+
+    bool thrown = false;
+    try {
+        matrix.block<3, 3>(10, 0);
+    } catch (const std::range_error&) {
+        thrown = true;
+    }
+    assert(thrown, "Block past the edge should throw");
+}
+
+int main() {
+    test_dynarray_basics();
+    test_dynarray_reductions();
+    test_dynarray_arithmetic();
+    test_dynarray_fixed_interop();
+    test_dynmatrix();
+    test_dynmatrix_blocks();
+}
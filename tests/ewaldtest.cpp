@@ -0,0 +1,209 @@
+#include "ewald.hpp"
+#include "testutils.hpp"
+
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using namespace dav;
+
+struct Suspension {
+    VectorField positions;
+    VectorField forces;
+};
+
+Suspension random_suspension(const BoundingBox& bb, const size_t n, const unsigned seed) {
+    std::mt19937 engine(seed);
+    std::normal_distribution<double> component(0, 1);
+
+    Suspension output;
+    for (size_t i = 0; i < n; ++i) {
+        output.positions.push_back(bb.random_point_in_bounds(engine));
+        output.forces.push_back(MathArray<double, 3>{component(engine), component(engine), component(engine)});
+    }
+
+    return output;
+}
+
+// Largest difference relative to the largest velocity.
+double relative_difference(const VectorField& a, const VectorField& b) {
+    double difference = 0;
+    double scale = 0;
+
+    for (size_t i = 0; i < a.size(); ++i) {
+        difference = std::max(difference, magnitude(a[i].get() - b[i].get()));
+        scale = std::max(scale, magnitude(b[i].get()));
+    }
+
+    return difference / scale;
+}
+
+VectorField ewald_velocities(const BoundingBox& bb, const Suspension& suspension, const EwaldParameters& parameters, const double radius) {
+    const SpectralEwald ewald(bb, parameters, 1.3, radius);
+    VectorField velocities;
+    ewald.apply(suspension.positions, suspension.forces, velocities);
+
+    return velocities;
+}
+
+// The real-space Stokeslet sum over every minimum-image pair inside the
+// cutoff, checking all N^2 pairs.
+VectorField direct_real_space(const BoundingBox& bb, const Suspension& suspension, const double xi, const double cutoff, const double eta) {
+    const size_t n = suspension.positions.size();
+    const double c = 2 * xi / std::sqrt(M_PI);
+
+    VectorField velocities(n);
+    for (size_t i = 0; i < n; ++i) {
+        MathArray<double, 3> u = -2 * c * suspension.forces[i].get();
+
+        for (size_t j = 0; j < n; ++j) {
+            const MathArray<double, 3> r = PeriodicBoundaries::displacement(bb, suspension.positions[i].get(), suspension.positions[j].get());
+            const double r_sq = magnitude_sq(r);
+
+            if (j == i || r_sq >= cutoff * cutoff) {
+                continue;
+            }
+
+            const double distance = std::sqrt(r_sq);
+            const double C = std::erfc(xi * distance);
+            const double E = std::exp(-xi * xi * r_sq);
+            const MathArray<double, 3> f = suspension.forces[j].get();
+
+            u += (C / distance - c * E) * f + ((C / distance + c * E) / r_sq * (r * f).sum()) * r;
+        }
+
+        velocities[i] = u / (8 * M_PI * eta);
+    }
+
+    return velocities;
+}
+
+void test_real_space_cells() {
+    // Cutoffs that give two cells along some axes (where wrapping left and
+    // right lands in the same cell), three, and many.
+    const BoundingBox bb(-3, 9, 0, 9, 2, 17);
+    const double eta = 1.3;
+
+    for (const double cutoff : {4.4, 3.0, 1.7}) {
+        const EwaldParameters parameters = EwaldParameters::for_tolerance(bb, 300, 1e-6, cutoff);
+        const SpectralEwald ewald(bb, parameters, eta);
+
+        // A second, smaller suspension reuses the scratch from the first.
+        for (const size_t n : {300, 120}) {
+            const Suspension suspension = random_suspension(bb, n, unsigned(n + 10 * cutoff));
+            const VectorField expected = direct_real_space(bb, suspension, parameters.xi, cutoff, eta);
+
+            VectorField velocities(n);
+            ewald.real_space(suspension.positions.x().data(), suspension.positions.y().data(), suspension.positions.z().data(),
+                             suspension.forces.x().data(), suspension.forces.y().data(), suspension.forces.z().data(),
+                             n, velocities.x().data(), velocities.y().data(), velocities.z().data());
+
+            assert(relative_difference(velocities, expected) < 1e-12, "Cell list real-space sum doesn't match the direct one");
+        }
+    }
+}
+
+void test_xi_independence() {
+    // How the sum is split between real and k space mustn't matter.
+    const BoundingBox bb(0, 5, 0, 6, 0, 7);
+    Suspension suspension = random_suspension(bb, 30, 3);
+
+    // Make sure some RPY spheres overlap, one of them across the boundary.
+    suspension.positions[1] = suspension.positions[0].get() + MathArray<double, 3>{0.2, 0.1, 0};
+    suspension.positions[2] = MathArray<double, 3>{0.1, 3, 3};
+    suspension.positions[3] = MathArray<double, 3>{4.8, 3.1, 3};
+
+    for (const double radius : {0.0, 0.3}) {
+        const VectorField wide = ewald_velocities(bb, suspension, EwaldParameters::for_tolerance(bb, 30, 1e-12, 2.4), radius);
+        const VectorField narrow = ewald_velocities(bb, suspension, EwaldParameters::for_tolerance(bb, 30, 1e-12, 1.5), radius);
+
+        assert(relative_difference(narrow, wide) < 1e-8, "Ewald sum depends on xi");
+    }
+}
+
+void test_tolerance() {
+    const BoundingBox bb(0, 8, 0, 8, 0, 8);
+    const Suspension suspension = random_suspension(bb, 100, 5);
+
+    for (const double radius : {0.0, 0.2}) {
+        const VectorField reference = ewald_velocities(bb, suspension, EwaldParameters::for_tolerance(bb, 100, 1e-12), radius);
+
+        for (const double tolerance : {1e-4, 1e-7}) {
+            const VectorField velocities = ewald_velocities(bb, suspension, EwaldParameters::for_tolerance(bb, 100, tolerance), radius);
+
+            assert(relative_difference(velocities, reference) < 10 * tolerance, "Ewald sum misses its tolerance");
+        }
+    }
+}
+
+void test_hasimoto() {
+    // One sphere dragged through a lattice of its images is slowed down by
+    // 1 - 2.8373 a / L + 4 pi / 3 (a / L)^3, which RPY gets right.
+    for (const double side : {10.0, 20.0}) {
+        const BoundingBox bb(side, side, side);
+
+        Suspension suspension;
+        suspension.positions.push_back(MathArray<double, 3>{0.1, 0.2, 0.3});
+        suspension.forces.push_back(MathArray<double, 3>{0, 1, 0});
+
+        const double eta = 1.3;
+        const SpectralEwald ewald(bb, EwaldParameters::for_tolerance(bb, 1, 1e-10), eta, 1.0);
+        VectorField velocities;
+        ewald.apply(suspension.positions, suspension.forces, velocities);
+
+        const double ratio = 1 / side;
+        const double expected = (1 - 2.837297 * ratio + 4 * M_PI / 3 * ratio * ratio * ratio) / (6 * M_PI * eta);
+
+        assert(std::abs(velocities[0][1] - expected) < 1e-6 * expected, "Periodic self mobility doesn't match Hasimoto");
+        assert(std::abs(velocities[0][0]) < 1e-10 * expected && std::abs(velocities[0][2]) < 1e-10 * expected, "Periodic self mobility isn't isotropic");
+    }
+}
+
+void test_translation_invariance() {
+    // Shifting everything, including across the boundary, changes nothing.
+    const BoundingBox bb(-2, 4, 0, 6, 1, 7);
+    const Suspension suspension = random_suspension(bb, 40, 7);
+    const EwaldParameters parameters = EwaldParameters::for_tolerance(bb, 40, 1e-10);
+
+    Suspension shifted = suspension;
+    for (size_t i = 0; i < shifted.positions.size(); ++i) {
+        shifted.positions[i] = shifted.positions[i].get() + MathArray<double, 3>{2.345, -1.5, 10.1};
+    }
+
+    for (const double radius : {0.0, 0.25}) {
+        const VectorField velocities = ewald_velocities(bb, suspension, parameters, radius);
+        const VectorField shifted_velocities = ewald_velocities(bb, shifted, parameters, radius);
+
+        assert(relative_difference(shifted_velocities, velocities) < 1e-9, "Ewald sum isn't translation invariant");
+    }
+}
+
+void test_bad_parameters() {
+    const BoundingBox bb(4, 4, 4);
+
+    bool caught = false;
+    try {
+        SpectralEwald ewald(bb, EwaldParameters{3, 2.5, MathArray<size_t, 3>{32, 32, 32}, 8}, 1);
+    } catch (const std::invalid_argument&) {
+        caught = true;
+    }
+    assert(caught, "Ewald accepted a cutoff bigger than half the box");
+
+    caught = false;
+    try {
+        EwaldParameters::for_tolerance(bb, 10, 0);
+    } catch (const std::invalid_argument&) {
+        caught = true;
+    }
+    assert(caught, "Ewald accepted a zero tolerance");
+}
+
+int main() {
+    test_real_space_cells();
+    test_xi_independence();
+    test_tolerance();
+    test_hasimoto();
+    test_translation_invariance();
+    test_bad_parameters();
+}
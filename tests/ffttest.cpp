@@ -0,0 +1,110 @@
+#include "fft.hpp"
+#include "testutils.hpp"
+
+#include <cmath>
+#include <complex>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using namespace dav;
+
+std::vector<std::complex<double>> random_signal(const size_t n, const unsigned seed) {
+    std::mt19937 engine(seed);
+    std::normal_distribution<double> component(0, 1);
+
+    std::vector<std::complex<double>> output(n);
+    for (std::complex<double>& value : output) {
+        value = std::complex<double>(component(engine), component(engine));
+    }
+
+    return output;
+}
+
+double max_difference(const std::vector<std::complex<double>>& a, const std::vector<std::complex<double>>& b) {
+    double output = 0;
+
+    for (size_t i = 0; i < a.size(); ++i) {
+        output = std::max(output, std::abs(a[i] - b[i]));
+    }
+
+    return output;
+}
+
+void test_powers_of_two() {
+    assert(is_power_of_two(1) && is_power_of_two(64) && !is_power_of_two(0) && !is_power_of_two(48), "is_power_of_two is wrong");
+    assert(next_power_of_two(0) == 1 && next_power_of_two(17) == 32 && next_power_of_two(32) == 32, "next_power_of_two is wrong");
+
+    bool caught = false;
+    try {
+        FFT fft(12);
+    } catch (const std::invalid_argument&) {
+        caught = true;
+    }
+    assert(caught, "FFT accepted a length that isn't a power of two");
+}
+
+void test_fft_1d() {
+    for (const size_t n : {1, 2, 8, 64}) {
+        const std::vector<std::complex<double>> signal = random_signal(n, 3);
+
+        // Straight from the definition.
+        std::vector<std::complex<double>> expected(n);
+        for (size_t k = 0; k < n; ++k) {
+            for (size_t j = 0; j < n; ++j) {
+                expected[k] += signal[j] * std::polar(1.0, -2 * M_PI * double(j * k % n) / double(n));
+            }
+        }
+
+        const FFT fft(n);
+        std::vector<std::complex<double>> transformed(signal);
+        fft.forward(transformed.data());
+        assert(max_difference(transformed, expected) < 1e-12, "FFT doesn't match the DFT");
+
+        fft.inverse(transformed.data());
+        for (std::complex<double>& value : transformed) {
+            value /= double(n);
+        }
+        assert(max_difference(transformed, signal) < 1e-13, "Inverse FFT doesn't undo the forward one");
+    }
+}
+
+void test_fft_3d() {
+    const size_t n0 = 4, n1 = 8, n2 = 2;
+    const std::vector<std::complex<double>> signal = random_signal(n0 * n1 * n2, 5);
+
+    std::vector<std::complex<double>> expected(signal.size());
+    for (size_t a = 0; a < n0; ++a) {
+        for (size_t b = 0; b < n1; ++b) {
+            for (size_t c = 0; c < n2; ++c) {
+                for (size_t i = 0; i < n0; ++i) {
+                    for (size_t j = 0; j < n1; ++j) {
+                        for (size_t k = 0; k < n2; ++k) {
+                            const double phase = double(a * i) / n0 + double(b * j) / n1 + double(c * k) / n2;
+                            expected[(a * n1 + b) * n2 + c] += signal[(i * n1 + j) * n2 + k] * std::polar(1.0, -2 * M_PI * phase);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    const FFT3D fft(n0, n1, n2);
+    assert(fft.size() == n0 * n1 * n2 && fft.size(1) == n1, "FFT3D has the wrong size");
+
+    std::vector<std::complex<double>> transformed(signal);
+    fft.forward(transformed.data());
+    assert(max_difference(transformed, expected) < 1e-12, "3D FFT doesn't match the DFT");
+
+    fft.inverse(transformed.data());
+    for (std::complex<double>& value : transformed) {
+        value /= double(fft.size());
+    }
+    assert(max_difference(transformed, signal) < 1e-13, "Inverse 3D FFT doesn't undo the forward one");
+}
+
+int main() {
+    test_powers_of_two();
+    test_fft_1d();
+    test_fft_3d();
+}
@@ -4,6 +4,9 @@
 #include <functional>
 #include <iostream>
 #include <sstream>
+#include <random>
+#include <stdexcept>
+#include <vector>
 
 using namespace dav;
 
@@ -55,6 +58,76 @@ void test_blake() {
     assert(all(wrongness < 1e-5), "Failed comparison with Andrej");
 }
 
+void test_blake_batch() {
+    std::mt19937 engine(1234);
+    std::uniform_real_distribution<double> horizontal(-20, 20);
+    std::uniform_real_distribution<double> height(0.5, 30);
+    std::uniform_real_distribution<double> force(-1, 1);
+
+    const size_t n = 50;
+    const double shear_viscosity = 0.7;
+
+    std::vector<double> x(n), y(n), z(n), fx(n), fy(n), fz(n);
+    std::vector<MathArray<double, 3>> positions(n), forces(n);
+
+    for (size_t i = 0; i < n; ++i) {
+        positions[i] = MathArray<double, 3>{horizontal(engine), horizontal(engine), height(engine)};
+        forces[i] = MathArray<double, 3>{force(engine), force(engine), force(engine)};
+
+        x[i] = positions[i][0];
+        y[i] = positions[i][1];
+        z[i] = positions[i][2];
+        fx[i] = forces[i][0];
+        fy[i] = forces[i][1];
+        fz[i] = forces[i][2];
+    }
+
+    // Particles acting on each other.
+    {
+        std::vector<double> ux(n), uy(n), uz(n);
+        blake_flow_batch(x.data(), y.data(), z.data(), fx.data(), fy.data(), fz.data(), n, shear_viscosity, ux.data(), uy.data(), uz.data());
+
+        for (size_t i = 0; i < n; ++i) {
+            MathArray<double, 3> expected{};
+            for (size_t j = 0; j < n; ++j) {
+                if (i != j) {
+                    expected += blake_flow_at(positions[i], positions[j], forces[j], shear_viscosity);
+                }
+            }
+
+            assert_all_approx_eq(MathArray<double, 3>{ux[i], uy[i], uz[i]}, expected, 1e-12, "Failed batched blake flow");
+        }
+    }
+
+    // Separate field points, including some on the wall.
+    {
+        const size_t m = 20;
+        std::vector<double> tx(m), ty(m), tz(m), ux(m), uy(m), uz(m);
+        for (size_t i = 0; i < m; ++i) {
+            tx[i] = horizontal(engine);
+            ty[i] = horizontal(engine);
+            tz[i] = i % 4 == 0 ? 0 : height(engine);
+        }
+
+        blake_flow_batch(tx.data(), ty.data(), tz.data(), m, x.data(), y.data(), z.data(), fx.data(), fy.data(), fz.data(), n, shear_viscosity, ux.data(), uy.data(), uz.data());
+
+        for (size_t i = 0; i < m; ++i) {
+            const MathArray<double, 3> target{tx[i], ty[i], tz[i]};
+
+            MathArray<double, 3> expected{};
+            for (size_t j = 0; j < n; ++j) {
+                expected += blake_flow_at(target, positions[j], forces[j], shear_viscosity);
+            }
+
+            assert_all_approx_eq(MathArray<double, 3>{ux[i], uy[i], uz[i]}, expected, 1e-12, "Failed batched blake flow at field points");
+
+            if (tz[i] == 0) {
+                assert(all(abs(MathArray<double, 3>{ux[i], uy[i], uz[i]}) < 1e-12), "Failed batched blake boundary condition");
+            }
+        }
+    }
+}
+
 void test_translation() {
     const double z = 10;
     const MathArray<double, 3> sphere_position{0, 0, z};
@@ -116,6 +189,80 @@ void test_translation() {
     }
 }
 
+// shear_flow_at and translating_flow_at as they were before being written
+// out in closed form, to check the new ones against.
+MathArray<double, 3> legacy_translating_flow_at(const MathArray<double, 3>& position,
+                                                const MathArray<double, 3>& sphere_position,
+                                                const MathArray<double, 3>& translation_velocity,
+                                                const double sphere_radius) {
+
+    const MathArray<double, 3> new_coords = position - sphere_position;
+    const double distance = magnitude(new_coords);
+
+    MathArray<double, 3> flow_speed{};
+
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            flow_speed[i] -= 0.75 * sphere_radius * translation_velocity[j] * delta(i, j) / distance;
+            flow_speed[i] -= 0.75 * sphere_radius * translation_velocity[j] * new_coords[i] * new_coords[j] / std::pow(distance, 3);
+
+            flow_speed[i] -= 0.75 * std::pow(sphere_radius, 3) * translation_velocity[j] * delta(i, j) / (3.0 * std::pow(distance, 3));
+            flow_speed[i] += 0.75 * std::pow(sphere_radius, 3) * translation_velocity[j] * new_coords[i] * new_coords[j] / std::pow(distance, 5);
+        }
+    }
+
+    return flow_speed + translation_velocity;
+}
+
+MathArray<double, 3> legacy_shear_flow_at(const MathArray<double, 3>& position,
+                                          const MathArray<double, 3>& sphere_position,
+                                          const double sphere_radius,
+                                          const double shear_rate) {
+
+    const MathArray<double, 3> x = position - sphere_position;
+    const double r = magnitude(x);
+    const double a = sphere_radius;
+
+    if (r < a) {
+        return MathArray<double, 3>{0, 0, 0};
+    }
+
+    const auto strain = [shear_rate](const int i, const int j) {
+        return ((i == 0 && j == 2) || (i == 2 && j == 0)) ? shear_rate * 0.5 : 0.0;
+    };
+
+    MathArray<double, 3> flow_speed{0, 0, 0};
+
+    for (int i = 0; i < 3; ++i) {
+        double term_1 = 0;
+        double term_2 = 0;
+        double term_3 = 0;
+
+        for (int j = 0; j < 3; ++j) {
+            for (int k = 0; k < 3; ++k) {
+                const double strain_tensor_value = strain(j, k);
+
+                if (strain_tensor_value != 0) {
+                    term_1 -= 2.5 * std::pow(a, 3) / std::pow(r, 5) * x[i] * x[j] * x[k] * strain_tensor_value;
+
+                    const double factor = 0.5 * std::pow(a / r, 5) * strain_tensor_value;
+                    term_2 -= factor * (delta(i, j) * x[k] + delta(i, k) * x[j]);
+                    term_3 += factor * 5 * x[i] * x[j] * x[k] / std::pow(r, 2);
+                }
+            }
+        }
+
+        flow_speed[i] += term_1 + term_2 + term_3;
+    }
+
+    const MathArray<double, 3> rotation_vector{0, 0.5 * shear_rate, 0};
+    flow_speed -= rotation_vector.cross(x) * std::pow(a / r, 3);
+
+    flow_speed += legacy_translating_flow_at(position, sphere_position, MathArray<double, 3>{shear_rate * position[2]}, a);
+
+    return flow_speed;
+}
+
 void test_shear() {
     const MathArray<double, 3> sphere_position{0, 0, 10};
     const double shear_rate = 1;
@@ -155,9 +302,428 @@ void test_shear() {
     // }
 }
 
+void test_translation_batch() {
+    std::mt19937 engine(20);
+    std::uniform_real_distribution<double> coordinate(-6, 6);
+
+    const MathArray<double, 3> sphere_position{1, -0.5, 8};
+    const MathArray<double, 3> velocity{0.3, -1.1, 2};
+    const double radius = 0.8;
+
+    VectorField positions;
+    for (size_t i = 0; i < 20000; ++i) {
+        positions.push_back(sphere_position + MathArray<double, 3>{coordinate(engine), coordinate(engine), coordinate(engine)});
+    }
+
+    std::vector<MathArray<double, 3>> expected(positions.size());
+    for (size_t i = 0; i < positions.size(); ++i) {
+        expected[i] = legacy_translating_flow_at(positions[i].get(), sphere_position, velocity, radius);
+
+        const MathArray<double, 3> flow = translating_flow_at(positions[i].get(), sphere_position, velocity, radius);
+        assert(magnitude(flow - expected[i]) < 1e-12 * std::max(1.0, magnitude(expected[i])), "translating_flow_at doesn't match the original loops");
+    }
+
+    for (const size_t n_threads : {1, 3, 8}) {
+        VectorField velocities;
+        translating_flow_batch(positions, sphere_position, velocity, radius, velocities, n_threads);
+
+        assert(velocities.size() == positions.size(), "translating_flow_batch gave the wrong number of velocities");
+
+        for (size_t i = 0; i < positions.size(); ++i) {
+            assert_all_eq(velocities[i].get(), translating_flow_at(positions[i].get(), sphere_position, velocity, radius),
+                          "translating_flow_batch doesn't match translating_flow_at");
+        }
+    }
+}
+
+void test_shear_closed_form() {
+    std::mt19937 engine(17);
+    std::uniform_real_distribution<double> coordinate(-4, 4);
+
+    const MathArray<double, 3> sphere_position{0.3, -0.2, 5};
+    const double radius = 1.2;
+    const double shear_rate = 0.7;
+
+    VectorField positions;
+    for (size_t i = 0; i < 2000; ++i) {
+        positions.push_back(sphere_position + MathArray<double, 3>{coordinate(engine), coordinate(engine), coordinate(engine)});
+    }
+
+    VectorField batch;
+    shear_flow_batch(positions, sphere_position, radius, shear_rate, batch);
+
+    for (size_t i = 0; i < positions.size(); ++i) {
+        const MathArray<double, 3> expected = legacy_shear_flow_at(positions[i].get(), sphere_position, radius, shear_rate);
+        const MathArray<double, 3> flow = shear_flow_at(positions[i].get(), sphere_position, radius, shear_rate);
+        const double scale = std::max(1.0, magnitude(expected));
+
+        assert(magnitude(flow - expected) < 1e-12 * scale, "Closed form shear flow doesn't match the original");
+        assert_all_eq(batch[i].get(), flow, "Batched shear flow doesn't match shear_flow_at");
+    }
+
+    // Inside the sphere, including right at its centre.
+    assert_all_eq(shear_flow_at(sphere_position, sphere_position, radius, shear_rate), MathArray<double, 3>{}, "Shear flow inside the sphere isn't zero");
+}
+
+// The original shear_flow_at loops with the strain tensor and rotation
+// vector passed in instead of hardcoded.
+MathArray<double, 3> loop_linear_flow_at(const MathArray<double, 3>& position,
+                                         const MathArray<double, 3>& sphere_position,
+                                         const double a,
+                                         const Tensor<double, 3, 3>& strain,
+                                         const MathArray<double, 3>& rotation) {
+
+    const MathArray<double, 3> x = position - sphere_position;
+    const double r = magnitude(x);
+
+    if (r < a) {
+        return MathArray<double, 3>{0, 0, 0};
+    }
+
+    MathArray<double, 3> flow_speed{0, 0, 0};
+
+    for (size_t i = 0; i < 3; ++i) {
+        for (size_t j = 0; j < 3; ++j) {
+            for (size_t k = 0; k < 3; ++k) {
+                const double e = strain[{j, k}];
+
+                flow_speed[i] -= 2.5 * std::pow(a, 3) / std::pow(r, 5) * x[i] * x[j] * x[k] * e;
+                flow_speed[i] -= 0.5 * std::pow(a / r, 5) * e * (delta(i, j) * x[k] + delta(i, k) * x[j]);
+                flow_speed[i] += 2.5 * std::pow(a / r, 5) * x[i] * x[j] * x[k] * e / std::pow(r, 2);
+            }
+        }
+    }
+
+    flow_speed -= rotation.cross(x) * std::pow(a / r, 3);
+
+    MathArray<double, 3> ambient = rotation.cross(position);
+    for (size_t i = 0; i < 3; ++i) {
+        for (size_t j = 0; j < 3; ++j) {
+            ambient[i] += strain[{i, j}] * position[j];
+        }
+    }
+
+    return flow_speed + legacy_translating_flow_at(position, sphere_position, ambient, a);
+}
+
+template <class Flow>
+void check_linear_flow(const Flow& flow, const VectorField& positions, const MathArray<double, 3>& sphere_position, const double radius) {
+    const Tensor<double, 3, 3> strain = flow.strain_tensor();
+    const MathArray<double, 3> rotation = flow.rotation_vector();
+
+    VectorField batch;
+    linear_flow_batch(flow, positions, sphere_position, radius, batch);
+
+    for (size_t i = 0; i < positions.size(); ++i) {
+        const MathArray<double, 3> position = positions[i].get();
+        const MathArray<double, 3> expected = loop_linear_flow_at(position, sphere_position, radius, strain, rotation);
+        const MathArray<double, 3> specialised = linear_flow_at(position, sphere_position, radius, flow);
+        const MathArray<double, 3> general = linear_flow_at(position, sphere_position, radius, strain, rotation);
+        const double scale = std::max(1.0, magnitude(expected));
+
+        assert(magnitude(specialised - expected) < 1e-12 * scale, "Specialised linear flow doesn't match the loops");
+        assert(magnitude(general - expected) < 1e-12 * scale, "General linear flow doesn't match the loops");
+        assert_all_eq(batch[i].get(), specialised, "Batched linear flow doesn't match linear_flow_at");
+    }
+
+    // Far from the sphere the ambient flow is all that's left.
+    const MathArray<double, 3> far = sphere_position + MathArray<double, 3>{3e4, -2e4, 1e4};
+    MathArray<double, 3> ambient = rotation.cross(far);
+    for (size_t i = 0; i < 3; ++i) {
+        for (size_t j = 0; j < 3; ++j) {
+            ambient[i] += strain[{i, j}] * far[j];
+        }
+    }
+
+    const MathArray<double, 3> far_flow = linear_flow_at(far, sphere_position, radius, flow);
+    assert(magnitude(far_flow - ambient) < 1e-3 * magnitude(ambient), "Linear flow doesn't approach the ambient flow far away");
+}
+
+void test_linear_flow() {
+    std::mt19937 engine(19);
+    std::uniform_real_distribution<double> coordinate(-4, 4);
+
+    const MathArray<double, 3> sphere_position{0.3, -0.2, 5};
+    const double radius = 1.2;
+
+    VectorField positions;
+    for (size_t i = 0; i < 1000; ++i) {
+        positions.push_back(sphere_position + MathArray<double, 3>{coordinate(engine), coordinate(engine), coordinate(engine)});
+    }
+
+    check_linear_flow(ShearFlow{0.7}, positions, sphere_position, radius);
+    check_linear_flow(PlanarExtension{1.3}, positions, sphere_position, radius);
+    check_linear_flow(UniaxialExtension{-0.4}, positions, sphere_position, radius);
+
+    Tensor<double, 3, 3> strain{};
+    strain[{0, 0}] = 0.2;
+    strain[{1, 1}] = 0.5;
+    strain[{2, 2}] = -0.7;
+    strain[{0, 1}] = strain[{1, 0}] = 0.3;
+    strain[{1, 2}] = strain[{2, 1}] = -0.1;
+    check_linear_flow(GeneralLinearFlow{strain, MathArray<double, 3>{0.4, -0.6, 0.25}}, positions, sphere_position, radius);
+
+    // Each special case has the ambient flow its comment says.
+    const MathArray<double, 3> point{0.5, -1.5, 2};
+    double ux, uy, uz, wx, wy, wz;
+
+    ShearFlow{2}.strain_dot(point[0], point[1], point[2], ux, uy, uz);
+    ShearFlow{2}.rotation_cross(point[0], point[1], point[2], wx, wy, wz);
+    assert_all_eq(MathArray<double, 3>{ux + wx, uy + wy, uz + wz}, MathArray<double, 3>{4, 0, 0}, "Wrong ambient shear flow");
+
+    PlanarExtension{2}.strain_dot(point[0], point[1], point[2], ux, uy, uz);
+    assert_all_eq(MathArray<double, 3>{ux, uy, uz}, MathArray<double, 3>{1, 3, 0}, "Wrong ambient planar extension");
+
+    UniaxialExtension{2}.strain_dot(point[0], point[1], point[2], ux, uy, uz);
+    assert_all_eq(MathArray<double, 3>{ux, uy, uz}, MathArray<double, 3>{-0.5, 1.5, 4}, "Wrong ambient uniaxial extension");
+}
+
+double max_tensor_difference(const Tensor<double, 3, 3>& t1, const Tensor<double, 3, 3>& t2) {
+    double difference = 0;
+
+    for (size_t k = 0; k < 9; ++k) {
+        difference = std::max(difference, std::abs(t1.data[k] - t2.data[k]));
+    }
+
+    return difference;
+}
+
+void test_rpy() {
+    const double a = 1.5;
+    const double eta = 0.7;
+    const double self_mobility = 1 / (6 * M_PI * eta * a);
+
+    // Self mobility.
+    const MathArray<double, 3> origin{0.5, -1, 2};
+    const Tensor<double, 3, 3> self = rpy_tensor_at(origin, origin, a, eta);
+    for (size_t i = 0; i < 3; ++i) {
+        for (size_t j = 0; j < 3; ++j) {
+            assert(std::abs(self[{i, j}] - self_mobility * delta(i, j)) < 1e-15, "Failed RPY self mobility");
+        }
+    }
+
+    // Far field along x, by hand.
+    const double r = 5;
+    const Tensor<double, 3, 3> far = rpy_tensor_at(origin + MathArray<double, 3>{r, 0, 0}, origin, a, eta);
+    const double prefactor = 1 / (8 * M_PI * eta * r);
+    const double ratio_sq = a * a / (r * r);
+    assert(std::abs(far[{0, 0}] - prefactor * (2 - 4.0 / 3.0 * ratio_sq)) < 1e-15, "Failed RPY far field xx");
+    assert(std::abs(far[{1, 1}] - prefactor * (1 + 2.0 / 3.0 * ratio_sq)) < 1e-15, "Failed RPY far field yy");
+    assert(std::abs(far[{0, 1}]) < 1e-15 && std::abs(far[{1, 2}]) < 1e-15, "Failed RPY far field off diagonal");
+
+    // Continuous where the overlapping form takes over, in every direction.
+    const MathArray<double, 3> direction = MathArray<double, 3>{1, -2, 0.5} / std::sqrt(5.25);
+    const Tensor<double, 3, 3> outside = rpy_tensor_at(origin + direction * (2 * a * (1 + 1e-12)), origin, a, eta);
+    const Tensor<double, 3, 3> inside = rpy_tensor_at(origin + direction * (2 * a * (1 - 1e-12)), origin, a, eta);
+    assert(max_tensor_difference(outside, inside) < 1e-12, "RPY is discontinuous at contact");
+
+    // Tends to the self mobility as the spheres merge.
+    const Tensor<double, 3, 3> merged = rpy_tensor_at(origin + direction * 1e-9, origin, a, eta);
+    assert(max_tensor_difference(merged, self) < 1e-9, "RPY doesn't tend to self mobility");
+}
+
+void test_rpy_wall() {
+    const double eta = 1.3;
+    const MathArray<double, 3> p{1.3, -0.7, 4.1};
+    const MathArray<double, 3> q{-0.4, 0.9, 2.2};
+
+    // Small spheres see the wall exactly as point forces do, with the
+    // difference going as a^2.
+    double previous_error = 0;
+    for (const double a : {0.1, 0.01}) {
+        const double error = max_tensor_difference(rpy_wall_tensor_at(p, q, a, eta), blake_tensor_at(p, q, eta));
+
+        assert(error < a * a, "Wall corrected RPY doesn't tend to Blake");
+        if (previous_error > 0) {
+            assert(std::abs(previous_error / error - 100) < 1, "Wall corrected RPY converges to Blake at the wrong rate");
+        }
+
+        previous_error = error;
+    }
+
+    // Swapping the spheres transposes the block.
+    const double a = 0.8;
+    const Tensor<double, 3, 3> pq = rpy_wall_tensor_at(p, q, a, eta);
+    const Tensor<double, 3, 3> qp = rpy_wall_tensor_at(q, p, a, eta);
+    for (size_t i = 0; i < 3; ++i) {
+        for (size_t j = 0; j < 3; ++j) {
+            assert(std::abs(pq[{i, j}] - qp[{j, i}]) < 1e-15, "Wall corrected RPY isn't symmetric");
+        }
+    }
+
+    // Self mobility against the usual series in a / h.
+    const double h = 3;
+    const double self_mobility = 1 / (6 * M_PI * eta * a);
+    const Tensor<double, 3, 3> self = rpy_wall_tensor_at(MathArray<double, 3>{2, 1, h}, MathArray<double, 3>{2, 1, h}, a, eta);
+    const double x = a / h;
+    assert(std::abs(self[{0, 0}] - self_mobility * (1 - 9.0 / 16.0 * x + 1.0 / 8.0 * std::pow(x, 3) - 1.0 / 16.0 * std::pow(x, 5))) < 1e-15, "Failed wall parallel self mobility");
+    assert(std::abs(self[{1, 1}] - self[{0, 0}]) < 1e-15, "Wall self mobility isn't isotropic in the plane");
+    assert(std::abs(self[{2, 2}] - self_mobility * (1 - 9.0 / 8.0 * x + 1.0 / 2.0 * std::pow(x, 3) - 1.0 / 8.0 * std::pow(x, 5))) < 1e-15, "Failed wall perpendicular self mobility");
+
+    // Far from the wall the correction dies away.
+    const MathArray<double, 3> lift{0, 0, 1e6};
+    assert(max_tensor_difference(rpy_wall_correction_at(p + lift, q + lift, a, eta), Tensor<double, 3, 3>{}) < 1e-7, "Wall correction doesn't decay");
+}
+
+// Plain Cholesky, to check positive definiteness.
+bool is_positive_definite(std::vector<double> matrix, const size_t size) {
+    for (size_t j = 0; j < size; ++j) {
+        double diagonal = matrix[j * size + j];
+        for (size_t k = 0; k < j; ++k) {
+            diagonal -= matrix[j * size + k] * matrix[j * size + k];
+        }
+
+        if (!(diagonal > 0)) {
+            return false;
+        }
+
+        matrix[j * size + j] = std::sqrt(diagonal);
+
+        for (size_t i = j + 1; i < size; ++i) {
+            double value = matrix[i * size + j];
+            for (size_t k = 0; k < j; ++k) {
+                value -= matrix[i * size + k] * matrix[j * size + k];
+            }
+
+            matrix[i * size + j] = value / matrix[j * size + j];
+        }
+    }
+
+    return true;
+}
+
+template <size_t tile_size>
+void check_mobility_assembly(const VectorField& positions, const double a, const double eta) {
+    const size_t n = positions.size();
+    const std::vector<double> matrix = assemble_mobility_matrix<RPYMobility, tile_size>(RPYMobility{a, eta}, positions);
+    const std::vector<double> wall_matrix = assemble_mobility_matrix<RPYWallMobility, tile_size>(RPYWallMobility{a, eta}, positions);
+
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < n; ++j) {
+            const Tensor<double, 3, 3> block = rpy_tensor_at(positions[i].get(), positions[j].get(), a, eta);
+            const Tensor<double, 3, 3> wall_block = rpy_wall_tensor_at(positions[i].get(), positions[j].get(), a, eta);
+
+            for (size_t k = 0; k < 3; ++k) {
+                for (size_t l = 0; l < 3; ++l) {
+                    assert(std::abs(matrix[(3 * i + k) * 3 * n + 3 * j + l] - block[{k, l}]) < 1e-15, "Assembled RPY matrix has wrong block");
+                    assert(std::abs(wall_matrix[(3 * i + k) * 3 * n + 3 * j + l] - wall_block[{k, l}]) < 1e-15, "Assembled wall RPY matrix has wrong block");
+                }
+            }
+        }
+    }
+}
+
+void test_mobility_assembly() {
+    std::mt19937 engine(11);
+    std::uniform_real_distribution<double> coordinate(1, 6);
+
+    const size_t n = 37;
+    const double a = 0.9;
+    VectorField positions(n);
+    for (size_t i = 0; i < n; ++i) {
+        positions[i] = MathArray<double, 3>{coordinate(engine), coordinate(engine), coordinate(engine)};
+    }
+
+    // Tiles smaller than, not dividing, and bigger than the number of particles.
+    check_mobility_assembly<1>(positions, a, 1.1);
+    check_mobility_assembly<5>(positions, a, 1.1);
+    check_mobility_assembly<16>(positions, a, 1.1);
+    check_mobility_assembly<100>(positions, a, 1.1);
+
+    // Lots of these spheres overlap, and RPY should still be positive definite.
+    assert(is_positive_definite(assemble_mobility_matrix(RPYMobility{a, 1.1}, positions), 3 * n), "RPY mobility isn't positive definite");
+}
+
+template <class Kernel>
+void check_mobility_operator(const Kernel& kernel, const VectorField& positions, const VectorField& forces, const double tolerance) {
+    const size_t n = positions.size();
+    const std::vector<double> matrix = assemble_mobility_matrix(kernel, positions);
+
+    std::vector<double> force(3 * n);
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t k = 0; k < 3; ++k) {
+            force[3 * i + k] = forces[i][k];
+        }
+    }
+
+    std::vector<double> expected(3 * n, 0);
+    for (size_t row = 0; row < 3 * n; ++row) {
+        for (size_t column = 0; column < 3 * n; ++column) {
+            expected[row] += matrix[row * 3 * n + column] * force[column];
+        }
+    }
+
+    for (const size_t n_threads : {1, 3, 8}) {
+        const MobilityOperator<Kernel> mobility(kernel, positions, n_threads);
+        assert(mobility.dimension() == 3 * n, "Mobility operator has the wrong dimension");
+
+        VectorField velocities;
+        mobility.apply(forces, velocities);
+        const std::vector<double> velocity = mobility(force);
+
+        for (size_t i = 0; i < n; ++i) {
+            for (size_t k = 0; k < 3; ++k) {
+                assert(std::abs(velocities[i][k] - expected[3 * i + k]) < tolerance, "Matrix-free mobility doesn't match the dense matrix");
+                assert(std::abs(velocity[3 * i + k] - expected[3 * i + k]) < tolerance, "Flat matrix-free mobility doesn't match the dense matrix");
+            }
+        }
+    }
+}
+
+void test_mobility_operator() {
+    std::mt19937 engine(23);
+    std::uniform_real_distribution<double> coordinate(1, 6);
+    std::normal_distribution<double> component(0, 1);
+
+    // More particles than a source tile, so tiles get split around i.
+    const size_t n = 300;
+    VectorField positions(n);
+    VectorField forces(n);
+    for (size_t i = 0; i < n; ++i) {
+        positions[i] = MathArray<double, 3>{coordinate(engine), coordinate(engine), coordinate(engine)};
+        forces[i] = MathArray<double, 3>{component(engine), component(engine), component(engine)};
+    }
+
+    check_mobility_operator(RPYMobility{0.3, 1.1}, positions, forces, 1e-12);
+    check_mobility_operator(RPYWallMobility{0.3, 1.1}, positions, forces, 1e-12);
+    check_mobility_operator(BlakeMobility{0.3, 1.1}, positions, forces, 1e-10);
+
+    // Without the self term, the Blake operator is blake_flow_batch.
+    const BlakeMobility blake{0.3, 1.1};
+    const MobilityOperator<BlakeMobility> mobility(blake, positions);
+    VectorField velocities;
+    mobility.apply(forces, velocities);
+
+    VectorField batch(n);
+    blake_flow_batch(positions.x().data(), positions.y().data(), positions.z().data(),
+                     forces.x().data(), forces.y().data(), forces.z().data(),
+                     n, 1.1, batch.x().data(), batch.y().data(), batch.z().data());
+
+    for (size_t i = 0; i < n; ++i) {
+        const MathArray<double, 3> self = forces[i].get() / (6 * M_PI * 1.1 * 0.3);
+        assert_all_approx_eq(velocities[i].get(), batch[i].get() + self, 1e-12, "Blake operator doesn't match blake_flow_batch");
+    }
+
+    bool caught = false;
+    try {
+        mobility.apply(VectorField(n + 1), velocities);
+    } catch (const std::invalid_argument&) {
+        caught = true;
+    }
+    assert(caught, "Mobility operator accepted the wrong number of forces");
+}
+
 int main() {
     test_stokes_drag();
     test_blake();
+    test_blake_batch();
     test_translation();
+    test_translation_batch();
     test_shear();
+    test_shear_closed_form();
+    test_linear_flow();
+    test_rpy();
+    test_rpy_wall();
+    test_mobility_assembly();
+    test_mobility_operator();
 }
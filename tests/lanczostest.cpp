@@ -0,0 +1,181 @@
+#include "lanczos.hpp"
+#include "fluidutils.hpp"
+#include "testutils.hpp"
+
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using namespace dav;
+
+// Dense row-major n x n matrix as a product callback.
+struct DenseOperator {
+    const std::vector<double>& matrix;
+    size_t n;
+
+    void operator()(const double* in, double* out) const {
+        for (size_t row = 0; row < this->n; ++row) {
+            double sum = 0;
+            for (size_t column = 0; column < this->n; ++column) {
+                sum += this->matrix[row * this->n + column] * in[column];
+            }
+            out[row] = sum;
+        }
+    }
+};
+
+double relative_difference(const std::vector<double>& a, const std::vector<double>& b) {
+    double difference = 0;
+    double size = 0;
+
+    for (size_t i = 0; i < a.size(); ++i) {
+        difference += (a[i] - b[i]) * (a[i] - b[i]);
+        size += b[i] * b[i];
+    }
+
+    return std::sqrt(difference / size);
+}
+
+std::vector<double> random_vector(const size_t n, std::mt19937& engine) {
+    std::normal_distribution<double> component(0, 1);
+
+    std::vector<double> output(n);
+    for (double& value : output) {
+        value = component(engine);
+    }
+
+    return output;
+}
+
+void test_dense() {
+    std::mt19937 engine(21);
+    const size_t n = 60;
+
+    // B B^T + I is comfortably positive definite.
+    const std::vector<double> b = random_vector(n * n, engine);
+    std::vector<double> matrix(n * n);
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < n; ++j) {
+            double sum = (i == j) ? 1.0 : 0.0;
+            for (size_t k = 0; k < n; ++k) {
+                sum += b[i * n + k] * b[j * n + k] / n;
+            }
+            matrix[i * n + j] = sum;
+        }
+    }
+
+    const DenseOperator multiply{matrix, n};
+    LanczosSqrt lanczos(n, n, 1e-12);
+
+    const std::vector<double> w = random_vector(n, engine);
+    std::vector<double> root, root_root, expected(n);
+
+    lanczos.apply(multiply, w, root);
+    lanczos.apply(multiply, root, root_root);
+    multiply(w.data(), expected.data());
+
+    assert(relative_difference(root_root, expected) < 1e-10, "sqrt(M) sqrt(M) w isn't M w");
+    assert(lanczos.converged(), "Lanczos didn't converge on a small dense matrix");
+
+    // Looser tolerances should take fewer iterations.
+    lanczos.set_tolerance(1e-12);
+    const size_t tight = lanczos.apply(multiply, w, root);
+    lanczos.set_tolerance(1e-3);
+    const size_t loose = lanczos.apply(multiply, w, root);
+
+    assert(loose < tight, "Iteration count doesn't adapt to the tolerance");
+    assert(lanczos.iterations() == loose, "iterations() doesn't report the last apply");
+
+    // Out of iterations: still an answer, just flagged.
+    LanczosSqrt capped(n, 2, 1e-12);
+    capped.apply(multiply, w, root);
+    assert(capped.iterations() == 2 && !capped.converged(), "Iteration cap not respected");
+}
+
+void test_exact_cases() {
+    const size_t n = 10;
+    std::vector<double> w(n), out;
+    for (size_t i = 0; i < n; ++i) {
+        w[i] = double(i) - 3;
+    }
+
+    // A multiple of the identity is done in one step.
+    LanczosSqrt lanczos(n);
+    const auto scaled = [n](const double* in, double* out) {
+        for (size_t i = 0; i < n; ++i) {
+            out[i] = 4 * in[i];
+        }
+    };
+
+    assert(lanczos.apply(scaled, w, out) == 1, "Multiple of the identity took more than one step");
+    for (size_t i = 0; i < n; ++i) {
+        assert(std::abs(out[i] - 2 * w[i]) < 1e-12, "Wrong square root of 4 I");
+    }
+
+    // The zero vector doesn't need any products.
+    std::vector<double> zero(n, 0.0);
+    assert(lanczos.apply(scaled, zero, out) == 0, "Zero vector needed products");
+    assert_all_eq(out, zero, "sqrt(M) 0 isn't 0");
+
+    // A diagonal operator with a negative entry has no real square root.
+    const auto indefinite = [n](const double* in, double* out) {
+        for (size_t i = 0; i < n; ++i) {
+            out[i] = (i == 2 ? -1.0 : 1.0 + i) * in[i];
+        }
+    };
+
+    bool thrown = false;
+    try {
+        LanczosSqrt(n, n, 1e-12).apply(indefinite, w, out);
+    } catch (const std::domain_error&) {
+        thrown = true;
+    }
+    assert(thrown, "Indefinite operator should throw");
+
+    thrown = false;
+    try {
+        lanczos.apply(scaled, std::vector<double>(n + 1), out);
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    assert(thrown, "Wrong length vector should throw");
+}
+
+void test_mobility() {
+    std::mt19937 engine(2021);
+    std::uniform_real_distribution<double> coordinate(0, 30);
+
+    // RPY is positive definite for any configuration.
+    const size_t particles = 200;
+    VectorField positions(particles);
+    for (size_t i = 0; i < particles; ++i) {
+        positions[i] = MathArray<double, 3>{coordinate(engine), coordinate(engine), coordinate(engine)};
+    }
+
+    const MobilityOperator<RPYMobility> mobility(RPYMobility{1.0, 1.0}, positions, 1);
+    const auto multiply = [&mobility](const double* in, double* out) {
+        mobility.apply(in, out);
+    };
+
+    const size_t n = mobility.dimension();
+    LanczosSqrt lanczos(n, 100, 1e-8);
+
+    std::vector<double> w(n), root(n), root_root(n), expected(n);
+    const size_t iterations = lanczos.sample(multiply, engine, w.data());
+    assert(lanczos.converged() && iterations < 60, "Lanczos took too long on an RPY mobility");
+
+    // sample used the workspace's own noise, so redo it from a known w.
+    w = random_vector(n, engine);
+    lanczos.apply(multiply, w.data(), root.data());
+    lanczos.apply(multiply, root.data(), root_root.data());
+    mobility.apply(w.data(), expected.data());
+
+    assert(relative_difference(root_root, expected) < 1e-6, "sqrt(M) sqrt(M) w isn't M w for RPY");
+}
+
+int main() {
+    test_dense();
+    test_exact_cases();
+    test_mobility();
+}
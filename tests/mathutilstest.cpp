@@ -1,6 +1,7 @@
 #include "mathutils.hpp"
 #include "testutils.hpp"
 #include<iostream>
+#include <vector>
 
 using namespace dav;
 
@@ -91,6 +92,69 @@ void test_convert() {
     assert(convert<std::string>("blork") == "blork" , "Failed string conversion");
 }
 
+void test_convert_edge_cases() {
+    assert(convert<int>("  -42 ") == -42, "Failed int conversion with whitespace");
+    assert(convert<int>("+7") == 7, "Failed int conversion with plus sign");
+    assert(convert<long>("-9000000000") == -9000000000L, "Failed negative long conversion");
+    assert(convert<double>("1e-3") == 1e-3, "Failed exponent double conversion");
+    assert(convert<double>("\t-2.5\n") == -2.5, "Failed double conversion with whitespace");
+    assert(convert<float>("0.5") == 0.5f, "Failed float conversion");
+    assert(convert<unsigned>("4000000000") == 4000000000u, "Failed unsigned conversion");
+    assert(convert<double>(std::string_view("1.25xyz", 4)) == 1.25, "Failed string_view conversion");
+
+    const std::vector<std::string> bad_ints{"", "   ", "12abc", "1.5", "+-3", "--3", "99999999999", "- 3"};
+    for (const std::string& s : bad_ints) {
+        try {
+            convert<int>(s);
+            assert(false, "Failed to reject bad int '" + s + "'");
+        } catch (number_format_exception&) {}
+    }
+
+    const std::vector<std::string> bad_doubles{"", "1.5.2", "3e", "1e400", "abc", "1,5"};
+    for (const std::string& s : bad_doubles) {
+        try {
+            convert<double>(s);
+            assert(false, "Failed to reject bad double '" + s + "'");
+        } catch (number_format_exception&) {}
+    }
+
+    try {
+        convert<unsigned>("-1");
+        assert(false, "Failed to reject negative unsigned");
+    } catch (number_format_exception&) {}
+}
+
+
+void test_integrators() {
+    const std::vector<double> x{1, -2, 3.5, 0, 7};
+    const std::vector<double> x_prev{0.5, -1, 3, 0.1, 6};
+    const std::vector<double> u{0.1, 0.2, -0.3, 4, -5};
+    const std::vector<double> u_prev{0, 0.25, -0.5, 3, -4};
+    const std::vector<double> w{0.01, -0.02, 0.03, -0.04, 0.05};
+    const std::vector<double> w_prev{-0.01, 0.02, 0, 0.04, 0.1};
+    const double delta = 0.01;
+    const size_t n = x.size();
+
+    std::vector<double> adams_bashforth(n), midpoint(n), euler(n), euler_scheme(n);
+    adams_bashforth_milstein_batch(adams_bashforth.data(), x.data(), x_prev.data(), u.data(), u_prev.data(), w.data(), w_prev.data(), delta, n);
+    midpoint_rule_milstein_batch(midpoint.data(), x.data(), x_prev.data(), u.data(), u_prev.data(), w.data(), w_prev.data(), delta, n);
+    milstein_batch<EulerMaruyamaScheme>(euler_scheme.data(), x.data(), static_cast<const double*>(nullptr), u.data(), static_cast<const double*>(nullptr), w.data(), static_cast<const double*>(nullptr), delta, n);
+
+    euler = x;
+    euler_maruyama_batch(euler.data(), u.data(), w.data(), delta, n);
+
+    for (size_t i = 0; i < n; ++i) {
+        assert(std::abs(adams_bashforth[i] - adams_bashforth_milstein(x[i], x_prev[i], u[i], u_prev[i], w[i], w_prev[i], delta)) < 1e-14, "Failed batched Adams-Bashforth Milstein");
+        assert(std::abs(midpoint[i] - midpoint_rule_milstein(x[i], x_prev[i], u[i], u_prev[i], w[i], w_prev[i], delta)) < 1e-14, "Failed batched midpoint Milstein");
+        assert(std::abs(euler[i] - euler_maruyama(x[i], u[i], w[i], delta)) < 1e-14, "Failed batched Euler-Maruyama");
+        assert(std::abs(euler_scheme[i] - euler_maruyama(x[i], u[i], w[i], delta)) < 1e-14, "Failed Euler-Maruyama Milstein scheme");
+    }
+
+    // Writing over the previous-step buffer is allowed.
+    std::vector<double> rotated(x_prev);
+    adams_bashforth_milstein_batch(rotated.data(), x.data(), rotated.data(), u.data(), u_prev.data(), w.data(), w_prev.data(), delta, n);
+    assert_all_eq(rotated, adams_bashforth, "Failed in-place Adams-Bashforth Milstein");
+}
 
 int main() {
     test_delta();
@@ -98,4 +162,6 @@ int main() {
     test_flatten();
     test_pow();
     test_convert();
+    test_convert_edge_cases();
+    test_integrators();
 }
@@ -0,0 +1,122 @@
+#include "particleset.hpp"
+#include "fluidutils.hpp"
+#include "testutils.hpp"
+
+#include <cstdint>
+#include <vector>
+
+using namespace dav;
+
+void test_capacity() {
+    ParticleSet particles;
+    assert(particles.empty(), "New particle set wasn't empty");
+
+    particles.reserve(100);
+    assert(particles.capacity() >= 100, "Failed reserve");
+    assert(particles.size() == 0, "Reserve changed the size");
+
+    particles.push_back(MathArray<double, 3>{1, 2, 3});
+    particles.push_back(MathArray<double, 3>{4, 5, 6}, MathArray<double, 3>{-1, 0, 1});
+    assert(particles.size() == 2, "Failed push_back");
+    assert(particles.positions().size() == 2 && particles.velocities().size() == 2 && particles.forces().size() == 2, "Fields got out of step");
+
+    particles.resize(10);
+    assert(particles.size() == 10, "Failed resize");
+    assert_all_eq(particles.position(9).get(), MathArray<double, 3>{0, 0, 0}, "Resize didn't zero new particles");
+
+    particles.clear();
+    assert(particles.empty(), "Failed clear");
+}
+
+void test_alignment() {
+    ParticleSet particles(37);
+
+    for (size_t c = 0; c < 3; ++c) {
+        assert(reinterpret_cast<std::uintptr_t>(particles.positions().component(c).data()) % 64 == 0, "Position component not aligned");
+        assert(reinterpret_cast<std::uintptr_t>(particles.velocities().component(c).data()) % 64 == 0, "Velocity component not aligned");
+        assert(reinterpret_cast<std::uintptr_t>(particles.forces().component(c).data()) % 64 == 0, "Force component not aligned");
+    }
+}
+
+void test_proxies() {
+    const std::vector<MathArray<double, 3>> positions{{1, 2, 3}, {4, 5, 6}, {7, 8, 9}};
+    ParticleSet particles(positions);
+
+    // Reading
+    assert_all_eq(particles.position(1).get(), positions[1], "Failed proxy read");
+    const MathArray<double, 3> converted = particles.position(2);
+    assert_all_eq(converted, positions[2], "Failed proxy conversion");
+    assert(particles.position(0)[2] == 3, "Failed proxy indexing");
+    assert(magnitude(particles.position(0).get()) == magnitude(positions[0]), "Failed magnitude through proxy");
+
+    // Writing goes through to the component buffers.
+    particles.position(0) = MathArray<double, 3>{-1, -2, -3};
+    assert(particles.positions().x()[0] == -1 && particles.positions().y()[0] == -2 && particles.positions().z()[0] == -3, "Failed proxy write");
+
+    particles.position(1) += MathArray<double, 3>{1, 1, 1};
+    assert_all_eq(particles.position(1).get(), MathArray<double, 3>{5, 6, 7}, "Failed proxy +=");
+
+    particles.position(1) -= MathArray<double, 3>{2, 2, 2};
+    assert_all_eq(particles.position(1).get(), MathArray<double, 3>{3, 4, 5}, "Failed proxy -=");
+
+    particles.position(1) *= 2.0;
+    assert_all_eq(particles.position(1).get(), MathArray<double, 3>{6, 8, 10}, "Failed proxy *=");
+
+    particles.position(1)[0] = 100;
+    assert(particles.positions().x()[1] == 100, "Failed proxy element write");
+
+    // Proxy-to-proxy assignment copies values.
+    particles.velocity(2) = particles.position(2);
+    assert_all_eq(particles.velocity(2).get(), positions[2], "Failed proxy-to-proxy assignment");
+
+    // Const access
+    const ParticleSet& const_particles = particles;
+    assert_all_eq(const_particles.position(2).get(), positions[2], "Failed const proxy read");
+
+    try {
+        particles.positions().at(3);
+        assert(false, "Failed bounds check");
+    } catch (std::range_error&) {}
+
+    // Round trip back to array-of-structures.
+    const std::vector<MathArray<double, 3>> round_trip = particles.velocities().to_vector();
+    assert_all_eq(round_trip[2], positions[2], "Failed to_vector");
+}
+
+void test_bulk_kernels() {
+    const size_t n = 50;
+    ParticleSet particles(n);
+
+    for (size_t i = 0; i < n; ++i) {
+        particles.velocity(i) = MathArray<double, 3>{double(i), -2.0 * i, 0.5 * i};
+    }
+
+    for (size_t c = 0; c < 3; ++c) {
+        stokes_drag(particles.velocities().component(c).data(), particles.forces().component(c).data(), n, 0.3, 2.0);
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        const MathArray<double, 3> expected = stokes_drag(particles.velocity(i).get(), 0.3, 2.0);
+        assert_all_approx_eq(particles.force(i).get(), expected, 1e-12, "Failed bulk stokes drag");
+    }
+
+    // Euler-Maruyama step done one component span at a time.
+    const double dt = 0.01;
+    for (size_t c = 0; c < 3; ++c) {
+        Span<double> x = particles.positions().component(c);
+        Span<const double> u = static_cast<const ParticleSet&>(particles).velocities().component(c);
+
+        for (size_t i = 0; i < x.size(); ++i) {
+            x[i] = euler_maruyama(x[i], u[i], 0, dt);
+        }
+    }
+
+    assert_all_approx_eq(particles.position(10).get(), MathArray<double, 3>{0.1, -0.2, 0.05}, 1e-12, "Failed span integration");
+}
+
+int main() {
+    test_capacity();
+    test_alignment();
+    test_proxies();
+    test_bulk_kernels();
+}
@@ -1,5 +1,10 @@
 #include "testutils.hpp"
 #include "randomutils.hpp"
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <string>
 #include <vector>
 
 using namespace dav;
@@ -11,6 +16,355 @@ void test_cumsum() {
     assert_all_eq(cumsum(v), v_cumsum, "Failed cumsum");
 }
 
+template <class Sampler, class Engine>
+std::vector<double> sample_frequencies(const Sampler& sampler, const size_t bins, const size_t draws, Engine& engine) {
+    std::vector<double> frequencies(bins, 0);
+
+    for (size_t i = 0; i < draws; ++i) {
+        const size_t index = sampler(engine);
+        assert(index < bins, "Sampled index out of range");
+        frequencies[index] += 1.0 / draws;
+    }
+
+    return frequencies;
+}
+
+void test_weighted_index() {
+    std::mt19937 engine(1);
+    const std::vector<double> weights{1, 2, 0, 5};
+    const size_t draws = 1'000'000;
+
+    const std::vector<double> frequencies = sample_frequencies([&](std::mt19937& e) { return weighted_index(weights, e); }, weights.size(), draws, engine);
+    const std::vector<double> expected{1.0 / 8, 2.0 / 8, 0, 5.0 / 8};
+
+    assert(frequencies[2] == 0, "Drew a zero weight with weighted_index");
+    assert_all_approx_eq(frequencies, expected, 5e-3, "Failed weighted_index frequencies");
+}
+
+void test_alias_sampler() {
+    std::mt19937 engine(2);
+    const size_t draws = 1'000'000;
+
+    const std::vector<double> weights{0, 3, 1, 0, 4, 0.5, 0, 1.5};
+    const AliasSampler<double> sampler(weights);
+    assert(sampler.size() == weights.size(), "Failed alias sampler size");
+
+    const std::vector<double> frequencies = sample_frequencies(sampler, weights.size(), draws, engine);
+    std::vector<double> expected(weights);
+    for (double& e : expected) {
+        e /= 10.0;
+    }
+
+    assert(frequencies[0] == 0 && frequencies[3] == 0 && frequencies[6] == 0, "Alias sampler drew a zero weight");
+    assert_all_approx_eq(frequencies, expected, 5e-3, "Failed alias sampler frequencies");
+
+    // Fixed size weights, one of them dominant.
+    const MathArray<double, 4> array_weights{1e-6, 1, 1e6, 1};
+    const AliasSampler<double> array_sampler(array_weights);
+    const std::vector<double> array_frequencies = sample_frequencies(array_sampler, 4, draws, engine);
+    assert(std::abs(array_frequencies[2] - 1) < 1e-4, "Failed alias sampler with MathArray weights");
+
+    const AliasSampler<double> single(std::vector<double>{2.5});
+    for (size_t i = 0; i < 100; ++i) {
+        assert(single(engine) == 0, "Failed alias sampler with one weight");
+    }
+
+    const std::vector<std::vector<double>> bad_weights{{}, {0, 0}, {1, -1}, {1, NAN}};
+    for (const std::vector<double>& bad : bad_weights) {
+        try {
+            AliasSampler<double> bad_sampler(bad);
+            assert(false, "Failed to reject bad alias sampler weights");
+        } catch (std::invalid_argument&) {}
+    }
+}
+
+void test_sorted_search() {
+    // Zero first bin, a tie in the middle and a zero final bin.
+    const std::vector<double> cdf{0, 1, 1, 1, 2.5, 4, 4};
+
+    assert(find_first_element_greater_than_sorted(cdf, 0.0) == 1, "Picked zero first bin");
+    assert(find_first_element_greater_than_sorted(cdf, 0.5) == 1, "Failed search inside first bin");
+    assert(find_first_element_greater_than_sorted(cdf, 1.0) == 4, "Picked zero bin on a tie");
+    assert(find_first_element_greater_than_sorted(cdf, 3.0) == 5, "Failed search inside bin");
+    assert(find_first_element_greater_than_sorted(cdf, 4.0) == 5, "Picked zero final bin");
+    assert(find_first_element_greater_than_sorted(cdf, std::nextafter(4.0, 0.0)) == 5, "Failed search just below the end");
+
+    for (double u = 0; u <= 4; u += 1.0 / 64) {
+        const size_t sorted = find_first_element_greater_than_sorted(cdf, u);
+        const size_t linear = find_first_element_greater_than(cdf, u);
+
+        assert(sorted == linear || (u == 4 && sorted == 5), "Sorted and linear searches disagree");
+    }
+
+    const MathArray<double, 4> array_cdf{0, 0, 3, 3};
+    assert(find_first_element_greater_than_sorted(array_cdf, 0.0) == 2, "Failed MathArray sorted search");
+    assert(find_first_element_greater_than_sorted(array_cdf, 3.0) == 2, "Failed MathArray sorted search at end");
+}
+
+void test_weighted_index_cdf() {
+    std::mt19937 engine(3);
+    const size_t draws = 1'000'000;
+
+    const std::vector<double> weights{0, 2, 0, 1, 1, 0};
+    const std::vector<double> expected{0, 0.5, 0, 0.25, 0.25, 0};
+    const std::vector<double> cdf = cumsum(weights);
+
+    const std::vector<double> frequencies = sample_frequencies([&](std::mt19937& e) { return weighted_index_cdf(cdf, e); }, weights.size(), draws, engine);
+    assert_all_approx_eq(frequencies, expected, 5e-3, "Failed weighted_index_cdf frequencies");
+
+    const MathArray<double, 3> array_cdf{1, 1, 2};
+    for (size_t i = 0; i < 1000; ++i) {
+        assert(weighted_index_cdf(array_cdf, engine) != 1, "Picked zero bin from MathArray cdf");
+    }
+}
+
+void test_guide_table_sampler() {
+    std::mt19937 engine(4);
+    const size_t draws = 1'000'000;
+
+    const std::vector<double> weights{0, 2, 0, 0, 1, 1, 0.5, 0, 0.5, 0};
+    const std::vector<double> cdf = cumsum(weights);
+    std::vector<double> expected(weights);
+    for (double& e : expected) {
+        e /= 5.0;
+    }
+
+    // Every bucket count should agree with the binary search for every u.
+    for (const size_t buckets : {0, 1, 3, 10, 37, 1000}) {
+        const GuideTableSampler<double> sampler(weights, buckets);
+        assert(sampler.size() == weights.size(), "Failed guide table size");
+
+        for (double u = 0; u <= 5; u += 1.0 / 128) {
+            assert(sampler.index_of(u) == find_first_element_greater_than_sorted(cdf, u), "Guide table disagrees with binary search");
+        }
+
+        assert(sampler.index_of(5) == 8, "Guide table picked zero final bin");
+        assert(sampler.index_of(std::nextafter(5.0, 0.0)) == 8, "Guide table failed just below the end");
+    }
+
+    const GuideTableSampler<double> sampler(weights);
+    const std::vector<double> frequencies = sample_frequencies(sampler, weights.size(), draws, engine);
+    assert_all_approx_eq(frequencies, expected, 5e-3, "Failed guide table frequencies");
+
+    // Many bins with a spread of sizes, checked against the binary search.
+    std::uniform_real_distribution<double> weight(0, 1);
+    std::vector<double> many(20'000);
+    for (size_t i = 0; i < many.size(); ++i) {
+        many[i] = i % 7 == 0 ? 0 : weight(engine) * (i % 13);
+    }
+
+    const GuideTableSampler<double> many_sampler(many);
+    std::uniform_real_distribution<double> u(0, many_sampler.get_cdf().back());
+    for (size_t i = 0; i < 100'000; ++i) {
+        const double value = u(engine);
+        assert(many_sampler.index_of(value) == find_first_element_greater_than_sorted(many_sampler.get_cdf(), value), "Guide table disagrees on many bins");
+    }
+
+    const GuideTableSampler<double> array_sampler(MathArray<double, 3>{0, 1, 0});
+    for (size_t i = 0; i < 100; ++i) {
+        assert(array_sampler(engine) == 1, "Failed guide table with MathArray weights");
+    }
+
+    try {
+        GuideTableSampler<double> bad(std::vector<double>{0, 0});
+        assert(false, "Failed to reject all zero weights");
+    } catch (std::invalid_argument&) {}
+}
+
+void test_philox_known_answers() {
+    // Known answer tests from the Random123 distribution.
+    const Philox4x32::Block zeros = Philox4x32::generate({0, 0, 0, 0}, {0, 0});
+    assert_all_eq(std::vector<uint32_t>(zeros.begin(), zeros.end()), {0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8}, "Failed Philox zero known answer");
+
+    const Philox4x32::Block ones = Philox4x32::generate({0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}, {0xffffffff, 0xffffffff});
+    assert_all_eq(std::vector<uint32_t>(ones.begin(), ones.end()), {0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd}, "Failed Philox ones known answer");
+
+    const Philox4x32::Block pi = Philox4x32::generate({0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}, {0xa4093822, 0x299f31d0});
+    assert_all_eq(std::vector<uint32_t>(pi.begin(), pi.end()), {0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}, "Failed Philox pi known answer");
+
+    // The engine walks the counter from zero.
+    Philox4x32 engine(0, 0);
+    for (const uint32_t expected : zeros) {
+        assert(engine() == expected, "Failed Philox engine first block");
+    }
+
+    const Philox4x32::Block second = Philox4x32::generate({1, 0, 0, 0}, {0, 0});
+    for (const uint32_t expected : second) {
+        assert(engine() == expected, "Failed Philox engine second block");
+    }
+}
+
+void test_philox_streams() {
+    const uint64_t seed = 0x123456789abcdefULL;
+    const size_t particles = 64;
+    const size_t draws = 10;
+
+    // Drawing each particle's numbers from its own stream gives the same
+    // answer whatever order (i.e. thread) the particles are visited in.
+    std::vector<std::vector<double>> forwards(particles), backwards(particles);
+    for (size_t i = 0; i < particles; ++i) {
+        Philox4x32 engine(seed, i);
+        std::normal_distribution<double> normal(0, 1);
+
+        for (size_t d = 0; d < draws; ++d) {
+            forwards[i].push_back(normal(engine));
+        }
+    }
+
+    for (size_t i = particles; i-- > 0;) {
+        Philox4x32 engine = Philox4x32(seed).split(i);
+        std::normal_distribution<double> normal(0, 1);
+
+        for (size_t d = 0; d < draws; ++d) {
+            backwards[i].push_back(normal(engine));
+        }
+    }
+
+    for (size_t i = 0; i < particles; ++i) {
+        assert_all_eq(forwards[i], backwards[i], "Philox streams depend on visiting order");
+        assert(forwards[i] != forwards[(i + 1) % particles], "Philox streams are not distinct");
+    }
+
+    assert(Philox4x32(seed, 5).get_stream() == 5 && Philox4x32(seed, 5).get_seed() == seed, "Failed Philox seed and stream getters");
+    assert(Philox4x32(1)() != Philox4x32(2)(), "Philox seeds are not distinct");
+
+    // Jumping ahead matches stepping, from any offset.
+    for (const unsigned long long skip : {0ull, 1ull, 3ull, 4ull, 5ull, 17ull, 1000ull}) {
+        for (size_t offset = 0; offset < 4; ++offset) {
+            Philox4x32 stepped(seed, 9), jumped(seed, 9);
+
+            for (size_t k = 0; k < offset; ++k) {
+                stepped();
+                jumped();
+            }
+
+            for (unsigned long long k = 0; k < skip; ++k) {
+                stepped();
+            }
+            jumped.discard(skip);
+
+            assert(stepped == jumped, "Philox discard disagrees with stepping");
+            assert(stepped() == jumped(), "Philox discard gives different output");
+        }
+    }
+}
+
+void test_philox_engine() {
+    Philox4x32 engine(42);
+
+    // Works with the standard distributions and everything that took an mt19937.
+    double mean = 0;
+    const size_t n = 1'000'000;
+    std::uniform_real_distribution<double> uniform(0, 1);
+    for (size_t i = 0; i < n; ++i) {
+        mean += uniform(engine) / n;
+    }
+    assert(std::abs(mean - 0.5) < 2e-3, "Philox uniform mean is off");
+
+    const std::vector<double> weights{1, 0, 3};
+    const std::vector<double> frequencies = sample_frequencies([&](Philox4x32& e) { return weighted_index(weights, e); }, weights.size(), 100'000, engine);
+    assert_all_approx_eq(frequencies, {0.25, 0, 0.75}, 1e-2, "Failed weighted_index with Philox");
+
+    const std::vector<int> options{3, 5, 7};
+    const int picked = choice(options, engine);
+    assert(picked == 3 || picked == 5 || picked == 7, "Failed choice with Philox");
+    assert(AliasSampler<double>(weights)(engine) != 1, "Failed AliasSampler with Philox");
+}
+
+void check_normal_moments(const std::vector<double>& samples, const double sigma, const std::string& name) {
+    const size_t n = samples.size();
+    double mean = 0, variance = 0, fourth = 0, beyond_two = 0;
+
+    for (const double x : samples) {
+        assert(std::isfinite(x), "Non-finite normal sample from " + name);
+
+        mean += x / n;
+        variance += x * x / n;
+        fourth += x * x * x * x / n;
+        beyond_two += std::abs(x) > 2 * sigma ? 1.0 / n : 0;
+    }
+
+    const double sigma_sq = sigma * sigma;
+
+    assert(std::abs(mean) < 5e-3 * sigma, "Failed normal mean with " + name);
+    assert(std::abs(variance / sigma_sq - 1) < 5e-3, "Failed normal variance with " + name);
+    assert(std::abs(fourth / (sigma_sq * sigma_sq) - 3) < 3e-2, "Failed normal kurtosis with " + name);
+    assert(std::abs(beyond_two - 0.0455) < 1e-3, "Failed normal tail with " + name);
+}
+
+void test_normal_kernels() {
+    for (int i = 1; i <= 100'000; ++i) {
+        const double t = double(i) / 100'000;
+        const double u = i % 2 ? t : t * 1e-12;
+
+        const double expected_log = std::log(u);
+        assert(std::abs(log_unit_interval(u) - expected_log) < 1e-15 * std::max(1.0, std::abs(expected_log)), "Failed log_unit_interval");
+
+        double sin_angle, cos_angle;
+        sincos_turns(t, sin_angle, cos_angle);
+        assert(std::abs(sin_angle - std::sin(2 * M_PI * t)) < 2e-15, "Failed sincos_turns sin");
+        assert(std::abs(cos_angle - std::cos(2 * M_PI * t)) < 2e-15, "Failed sincos_turns cos");
+    }
+
+    assert(log_unit_interval(1) == 0, "Failed log_unit_interval at 1");
+    assert(std::abs(log_unit_interval(std::ldexp(1.0, -53)) + 53 * M_LN2) < 1e-13, "Failed log_unit_interval at smallest uniform");
+
+    double sin_angle, cos_angle;
+    sincos_turns(0, sin_angle, cos_angle);
+    assert(sin_angle == 0 && cos_angle == 1, "Failed sincos_turns at 0");
+}
+
+void test_fill_normal() {
+    const size_t n = 2'000'001; // Odd, and not a multiple of the chunk size.
+    const double sigma = 0.3;
+
+    std::mt19937 mersenne(5);
+    std::vector<double> samples(n, NAN);
+    fill_normal(samples, sigma, mersenne);
+    check_normal_moments(samples, sigma, "mt19937");
+
+    Philox4x32 philox(5);
+    fill_normal(samples.data(), n, sigma, philox);
+    check_normal_moments(samples, sigma, "Philox4x32");
+
+    std::mt19937_64 mersenne_64(5);
+    fill_normal(samples, sigma, mersenne_64);
+    check_normal_moments(samples, sigma, "mt19937_64");
+
+    // Small sizes write exactly n values.
+    for (size_t small = 0; small < 6; ++small) {
+        std::vector<float> buffer(small + 1, 1e9f);
+        fill_normal(buffer.data(), small, 1.0f, philox);
+
+        assert(buffer[small] == 1e9f, "fill_normal wrote past the end");
+        for (size_t i = 0; i < small; ++i) {
+            assert(std::abs(buffer[i]) < 10, "fill_normal left a value unfilled");
+        }
+    }
+
+    // Same engine state gives the same samples.
+    Philox4x32 a(9, 1), b(9, 1);
+    std::vector<double> first(1001), second(1001);
+    fill_normal(first, 1.0, a);
+    fill_normal(second, 1.0, b);
+    assert_all_eq(first, second, "fill_normal is not reproducible");
+
+    for (size_t i = 0; i < 1000; ++i) {
+        const double u = random_unit_interval(philox);
+        assert(u > 0 && u <= 1, "random_unit_interval out of range");
+    }
+}
+
 int main() {
     test_cumsum();
+    test_weighted_index();
+    test_alias_sampler();
+    test_sorted_search();
+    test_weighted_index_cdf();
+    test_guide_table_sampler();
+    test_philox_known_answers();
+    test_philox_streams();
+    test_philox_engine();
+    test_normal_kernels();
+    test_fill_normal();
 }
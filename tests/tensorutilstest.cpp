@@ -2,6 +2,12 @@
 #include "testutils.hpp"
 #include "arrayutils.hpp"
 
+#include <cmath>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
 using namespace dav;
 
 void test_access() {
@@ -200,6 +206,387 @@ void test_multiplication() {
     }
 }
 
+// The plain triple loop, to check the unrolled and blocked kernels against.
+template <class T, size_t I, size_t J, size_t K>
+Tensor<T, I, J> reference_product(const Tensor<T, I, K>& t1, const Tensor<T, K, J>& t2) {
+    Tensor<T, I, J> output{};
+
+    for (size_t i = 0; i < I; ++i) {
+        for (size_t j = 0; j < J; ++j) {
+            for (size_t k = 0; k < K; ++k) {
+                output[{i, j}] += t1[{i, k}] * t2[{k, j}];
+            }
+        }
+    }
+
+    return output;
+}
+
+// Small integer entries in a fixed pattern, for products done at compile time.
+template <size_t N, size_t M>
+constexpr Tensor<int, N, M> pattern_tensor(const size_t seed) {
+    Tensor<int, N, M> output{};
+    for (size_t i = 0; i < N * M; ++i) {
+        output.data[i] = int((7 * i + seed) % 11) - 5;
+    }
+
+    return output;
+}
+
+template <size_t I, size_t J, size_t K>
+constexpr bool matches_reference_product(const Tensor<int, I, K>& t1, const Tensor<int, K, J>& t2, const Tensor<int, I, J>& product) {
+    for (size_t i = 0; i < I; ++i) {
+        for (size_t j = 0; j < J; ++j) {
+            int sum = 0;
+            for (size_t k = 0; k < K; ++k) {
+                sum += t1.data[i * K + k] * t2.data[k * J + j];
+            }
+
+            if (sum != product.data[i * J + j]) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+template <size_t I, size_t J, size_t K>
+void check_product(std::mt19937& engine) {
+    std::uniform_real_distribution<double> element(-1, 1);
+
+    // Big enough that they shouldn't go on the stack.
+    const auto t1 = std::make_unique<Tensor<double, I, K>>();
+    const auto t2 = std::make_unique<Tensor<double, K, J>>();
+
+    for (double& x : t1->data) {
+        x = element(engine);
+    }
+    for (double& x : t2->data) {
+        x = element(engine);
+    }
+
+    const auto product = std::make_unique<Tensor<double, I, J>>(*t1 * *t2);
+    const auto expected = std::make_unique<Tensor<double, I, J>>(reference_product(*t1, *t2));
+
+    // Same order of additions, so it should be exact.
+    for (size_t i = 0; i < I * J; ++i) {
+        assert(product->data[i] == expected->data[i], "Tensor product doesn't match the triple loop");
+    }
+}
+
+void test_multiplication_kernels() {
+    std::mt19937 engine(22);
+
+    // Unrolled.
+    check_product<3, 3, 3>(engine);
+    check_product<4, 4, 4>(engine);
+    check_product<2, 5, 3>(engine);
+    check_product<1, 1, 1>(engine);
+
+    // Simple loop, up to 16^3 multiply-adds.
+    check_product<5, 5, 5>(engine);
+    check_product<7, 9, 5>(engine);
+    check_product<16, 16, 16>(engine);
+
+    // Blocked, with leftover rows and columns and partial tiles in k and j.
+    check_product<17, 17, 17>(engine);
+    check_product<30, 30, 30>(engine);
+    check_product<37, 300, 70>(engine);
+    check_product<12, 260, 130>(engine);
+
+    // Still usable in constant expressions.
+    constexpr Tensor<int, 2, 2> a{1, 2, 3, 4};
+    constexpr Tensor<int, 2, 2> b{5, 6, 7, 8};
+    constexpr Tensor<int, 2, 2> small = a * b;
+    static_assert(small.data[0] == 19 && small.data[1] == 22 && small.data[2] == 43 && small.data[3] == 50, "Failed constexpr multiplication");
+
+    constexpr Tensor<int, 5, 5> identity{1, 0, 0, 0, 0,
+                                         0, 1, 0, 0, 0,
+                                         0, 0, 1, 0, 0,
+                                         0, 0, 0, 1, 0,
+                                         0, 0, 0, 0, 1};
+    constexpr Tensor<int, 5, 5> medium = identity * identity;
+    static_assert(medium.data[0] == 1 && medium.data[1] == 0 && medium.data[24] == 1, "Failed constexpr simple multiplication");
+
+    // 17^3 is past the simple loop's limit, with a leftover row and column.
+    constexpr Tensor<int, 17, 17> left = pattern_tensor<17, 17>(1);
+    constexpr Tensor<int, 17, 17> right = pattern_tensor<17, 17>(4);
+    constexpr Tensor<int, 17, 17> big = left * right;
+    static_assert(matches_reference_product(left, right, big), "Failed constexpr blocked multiplication");
+}
+
+template <size_t N>
+Tensor<double, N, N> random_tensor(std::mt19937& engine) {
+    std::uniform_real_distribution<double> element(-1, 1);
+
+    Tensor<double, N, N> output{};
+    for (double& x : output.data) {
+        x = element(engine);
+    }
+
+    return output;
+}
+
+template <size_t N>
+double max_difference_from_identity(const Tensor<double, N, N>& t) {
+    double output = 0;
+
+    for (size_t i = 0; i < N; ++i) {
+        for (size_t j = 0; j < N; ++j) {
+            output = std::max(output, std::abs(t[{i, j}] - (i == j ? 1.0 : 0.0)));
+        }
+    }
+
+    return output;
+}
+
+template <size_t N>
+void check_inverse_and_solve(std::mt19937& engine) {
+    for (size_t trial = 0; trial < 100; ++trial) {
+        const Tensor<double, N, N> t = random_tensor<N>(engine);
+        const Tensor<double, N, N> t_inverse = inverse(t);
+
+        // Scaled by the condition number, more or less.
+        const double tol = 1e-13 * (1 + std::abs(1 / determinant(t)));
+
+        assert(max_difference_from_identity(t * t_inverse) < tol, "T T^-1 isn't the identity");
+        assert(max_difference_from_identity(t_inverse * t) < tol, "T^-1 T isn't the identity");
+
+        MathArray<double, N> b{};
+        for (size_t i = 0; i < N; ++i) {
+            b[i] = double(i) - 1.5;
+        }
+
+        const MathArray<double, N> x = solve(t, b);
+        assert_all_approx_eq(t * x, b, tol, "T x isn't b");
+    }
+}
+
+void test_linear_algebra() {
+    std::mt19937 engine(23);
+
+    // Closed form and LU agree on the determinant.
+    for (size_t trial = 0; trial < 100; ++trial) {
+        const Tensor<double, 3, 3> t = random_tensor<3>(engine);
+        assert(std::abs(determinant(t) - lu_decompose(t).determinant()) < 1e-14, "3x3 determinant doesn't match LU");
+    }
+
+    const Tensor<double, 4, 4> permuted{0, 2, 0, 0,
+                                        1, 0, 0, 0,
+                                        0, 0, 0, 3,
+                                        0, 0, 4, 0};
+    assert(determinant(permuted) == 24, "Wrong determinant with row swaps");
+
+    check_inverse_and_solve<2>(engine);
+    check_inverse_and_solve<3>(engine);
+    check_inverse_and_solve<5>(engine);
+    check_inverse_and_solve<9>(engine);
+
+    // Singular tensors: zero determinant, and inverse and solve throw.
+    const Tensor<double, 3, 3> singular{1, 2, 3,
+                                        2, 4, 6,
+                                        0, 1, 1};
+    Tensor<double, 4, 4> singular_4{};
+    singular_4[{0, 0}] = 1;
+    singular_4[{1, 2}] = 1;
+    singular_4[{2, 1}] = 1;
+
+    assert(determinant(singular) == 0 && determinant(singular_4) == 0, "Singular tensor has non-zero determinant");
+
+    size_t thrown = 0;
+    try { inverse(singular); } catch (const std::domain_error&) { ++thrown; }
+    try { inverse(singular_4); } catch (const std::domain_error&) { ++thrown; }
+    try { solve(singular_4, MathArray<double, 4>{1, 1, 1, 1}); } catch (const std::domain_error&) { ++thrown; }
+    assert(thrown == 3, "Singular inverse or solve should throw");
+
+    // Usable at compile time.
+    constexpr Tensor<double, 3, 3> diagonal{2, 0, 0,
+                                            0, 4, 0,
+                                            0, 0, 8};
+    static_assert(determinant(diagonal) == 64, "Failed constexpr determinant");
+    static_assert(inverse(diagonal).data[8] == 0.125, "Failed constexpr inverse");
+    static_assert(determinant(Tensor<double, 2, 2>{0, 1, 1, 0}) == -1, "Failed constexpr LU determinant");
+}
+
+template <size_t N>
+void check_symmetric_eigen(const Tensor<double, N, N>& t) {
+    MathArray<double, N> values{};
+    Tensor<double, N, N> vectors{};
+    symmetric_eigen(t, values, vectors);
+
+    for (size_t i = 0; i + 1 < N; ++i) {
+        assert(values[i] <= values[i + 1], "Eigenvalues aren't sorted");
+    }
+
+    // Orthonormal, and T v = lambda v for each column.
+    Tensor<double, N, N> gram{};
+    for (size_t i = 0; i < N; ++i) {
+        for (size_t j = 0; j < N; ++j) {
+            for (size_t k = 0; k < N; ++k) {
+                gram[{i, j}] += vectors[{k, i}] * vectors[{k, j}];
+            }
+        }
+    }
+    assert(max_difference_from_identity(gram) < 1e-13, "Eigenvectors aren't orthonormal");
+
+    const Tensor<double, N, N> tv = t * vectors;
+    for (size_t i = 0; i < N; ++i) {
+        for (size_t j = 0; j < N; ++j) {
+            assert(std::abs(tv[{i, j}] - values[j] * vectors[{i, j}]) < 1e-13, "T v isn't lambda v");
+        }
+    }
+}
+
+void test_symmetric_eigen() {
+    std::mt19937 engine(230);
+
+    for (size_t trial = 0; trial < 100; ++trial) {
+        Tensor<double, 3, 3> t = random_tensor<3>(engine);
+        Tensor<double, 6, 6> t_6 = random_tensor<6>(engine);
+
+        for (size_t i = 0; i < 3; ++i) {
+            for (size_t j = 0; j < i; ++j) {
+                t[{i, j}] = t[{j, i}];
+            }
+        }
+        for (size_t i = 0; i < 6; ++i) {
+            for (size_t j = 0; j < i; ++j) {
+                t_6[{i, j}] = t_6[{j, i}];
+            }
+        }
+
+        check_symmetric_eigen(t);
+        check_symmetric_eigen(t_6);
+    }
+
+    // Repeated eigenvalues and an already diagonal tensor.
+    check_symmetric_eigen(Tensor<double, 3, 3>{2, 1, 1,
+                                               1, 2, 1,
+                                               1, 1, 2});
+
+    MathArray<double, 3> values{};
+    Tensor<double, 3, 3> vectors{};
+    symmetric_eigen(Tensor<double, 3, 3>{3, 0, 0, 0, -1, 0, 0, 0, 2}, values, vectors);
+    assert_all_eq(values, MathArray<double, 3>{-1, 2, 3}, "Wrong eigenvalues of a diagonal tensor");
+}
+
+void test_linear_algebra_batch() {
+    std::mt19937 engine(2300);
+    constexpr size_t n = 50;
+
+    std::vector<Tensor<double, 3, 3>> tensors(n);
+    std::vector<MathArray<double, 3>> rhs(n);
+    for (size_t i = 0; i < n; ++i) {
+        tensors[i] = random_tensor<3>(engine);
+        rhs[i] = MathArray<double, 3>{double(i), 1, -2};
+    }
+
+    std::vector<double> determinants(n);
+    std::vector<Tensor<double, 3, 3>> inverses(n);
+    std::vector<MathArray<double, 3>> solutions(n);
+    std::vector<MathArray<double, 3>> values(n);
+    std::vector<Tensor<double, 3, 3>> vectors(n);
+
+    determinant_batch(tensors.data(), determinants.data(), n);
+    inverse_batch(tensors.data(), inverses.data(), n);
+    solve_batch(tensors.data(), rhs.data(), solutions.data(), n);
+    symmetric_eigen_batch(tensors.data(), values.data(), vectors.data(), n);
+
+    for (size_t i = 0; i < n; ++i) {
+        MathArray<double, 3> value{};
+        Tensor<double, 3, 3> vector{};
+        symmetric_eigen(tensors[i], value, vector);
+
+        assert(determinants[i] == determinant(tensors[i]), "Batched determinant doesn't match");
+        const Tensor<double, 3, 3> expected_inverse = inverse(tensors[i]);
+        assert(std::equal(std::begin(inverses[i].data), std::end(inverses[i].data), std::begin(expected_inverse.data)), "Batched inverse doesn't match");
+        assert_all_eq(solutions[i], solve(tensors[i], rhs[i]), "Batched solve doesn't match");
+        assert_all_eq(values[i], value, "Batched eigenvalues don't match");
+    }
+}
+
+template <size_t N>
+void check_symmetric_tensor(std::mt19937& engine) {
+    std::uniform_real_distribution<double> element(-1, 1);
+
+    Tensor<double, N, N> dense{};
+    for (size_t i = 0; i < N; ++i) {
+        for (size_t j = i; j < N; ++j) {
+            dense[{i, j}] = dense[{j, i}] = element(engine);
+        }
+    }
+
+    const SymmetricTensor<double, N> packed = SymmetricTensor<double, N>::from_tensor(dense);
+    static_assert(sizeof(packed.data) == N * (N + 1) / 2 * sizeof(double), "SymmetricTensor stores more than it needs to");
+
+    for (size_t i = 0; i < N; ++i) {
+        for (size_t j = 0; j < N; ++j) {
+            assert(packed[{i, j}] == dense[{i, j}], "SymmetricTensor element doesn't match");
+            assert(packed.at(i, j) == dense[{i, j}], "SymmetricTensor at() doesn't match");
+        }
+    }
+
+    const Tensor<double, N, N> round_trip = packed.to_tensor();
+    assert(std::equal(std::begin(round_trip.data), std::end(round_trip.data), std::begin(dense.data)), "SymmetricTensor round trip changed the tensor");
+
+    MathArray<double, N> v{};
+    for (double& x : v) {
+        x = element(engine);
+    }
+
+    const Tensor<double, N, N> other = random_tensor<N>(engine);
+    double contraction = 0;
+    double trace = 0;
+    for (size_t i = 0; i < N; ++i) {
+        trace += dense[{i, i}];
+        for (size_t j = 0; j < N; ++j) {
+            contraction += dense[{i, j}] * other[{i, j}];
+        }
+    }
+
+    assert_all_approx_eq(packed * v, dense * v, 1e-14, "SymmetricTensor times vector doesn't match");
+    assert(std::abs(quadratic_form(packed, v) - v.dot(dense * v)) < 1e-14, "Wrong quadratic form");
+    assert(std::abs(double_contraction(packed, other) - contraction) < 1e-14, "Wrong contraction with a Tensor");
+    assert(std::abs(double_contraction(packed, packed) - double_contraction(packed, dense)) < 1e-14, "Wrong contraction of symmetric tensors");
+    assert(std::abs(packed.trace() - trace) < 1e-14, "Wrong trace");
+
+    const SymmetricTensor<double, N> doubled = packed + packed;
+    const SymmetricTensor<double, N> scaled = 2.0 * packed;
+    assert(std::equal(std::begin(doubled.data), std::end(doubled.data), std::begin(scaled.data)), "Sum and scaling disagree");
+}
+
+void test_symmetric_tensor() {
+    std::mt19937 engine(24);
+
+    check_symmetric_tensor<1>(engine);
+    check_symmetric_tensor<3>(engine);
+    check_symmetric_tensor<4>(engine);
+    check_symmetric_tensor<6>(engine);
+
+    // from_tensor keeps the symmetric part of a tensor that isn't.
+    const Tensor<double, 2, 2> skewed{1, 2,
+                                      4, 3};
+    const SymmetricTensor<double, 2> symmetric = SymmetricTensor<double, 2>::from_tensor(skewed);
+    assert(symmetric[{0, 1}] == 3 && symmetric[{1, 0}] == 3, "Wrong symmetric part");
+
+    // Writing either way round changes the same element.
+    SymmetricTensor<int, 3> t{};
+    t[{2, 0}] = 7;
+    assert(t[{0, 2}] == 7 && t.data[2] == 7, "Lower and upper triangle don't share storage");
+
+    bool thrown = false;
+    try {
+        t.at(3, 0);
+    } catch (const std::range_error&) {
+        thrown = true;
+    }
+    assert(thrown, "Out of bounds at() should throw");
+
+    constexpr SymmetricTensor<int, 3> strain{0, 0, 1, 0, 0, 0};
+    static_assert(quadratic_form(strain, MathArray<int, 3>{2, 5, 3}) == 12, "Failed constexpr quadratic form");
+}
+
 void test_astype() {
     const Tensor<float, 3, 2> t1{1.5,  2,
                                  19, 3.9,
@@ -226,6 +613,11 @@ int main() {
     test_to_array();
     test_addition();
     test_multiplication();
+    test_multiplication_kernels();
+    test_linear_algebra();
+    test_symmetric_eigen();
+    test_linear_algebra_batch();
+    test_symmetric_tensor();
 
 
     const Tensor<int, 3, 2> t{1, 2, 3, 4, 5, 6};
@@ -0,0 +1,74 @@
+#include "threadutils.hpp"
+#include "testutils.hpp"
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+using namespace dav;
+
+void test_parallel_for_covers_range() {
+    for (const size_t n_threads : {1, 2, 3, 7, 64}) {
+        std::vector<int> visits(100, 0);
+
+        parallel_for(5, 95, [&](const size_t begin, const size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                ++visits[i];
+            }
+        }, n_threads);
+
+        for (size_t i = 0; i < visits.size(); ++i) {
+            assert(visits[i] == (i >= 5 && i < 95 ? 1 : 0), "parallel_for didn't visit every index exactly once");
+        }
+    }
+}
+
+void test_parallel_for_chunks() {
+    std::atomic<size_t> calls(0);
+    std::atomic<size_t> total(0);
+
+    parallel_for(0, 10, [&](const size_t begin, const size_t end) {
+        assert(end > begin && end - begin <= 4 && end - begin >= 3, "parallel_for chunks aren't balanced");
+        ++calls;
+        total += end - begin;
+    }, 3);
+
+    assert(calls == 3, "parallel_for used the wrong number of chunks");
+    assert(total == 10, "parallel_for chunks don't add up to the range");
+
+    // More threads than work: one element each, no empty chunks.
+    calls = 0;
+    parallel_for(0, 2, [&](const size_t begin, const size_t end) {
+        assert(end == begin + 1, "parallel_for made an empty chunk");
+        ++calls;
+    }, 8);
+    assert(calls == 2, "parallel_for ran more chunks than elements");
+
+    calls = 0;
+    parallel_for(4, 4, [&](const size_t, const size_t) {
+        ++calls;
+    });
+    assert(calls == 0, "parallel_for ran on an empty range");
+}
+
+void test_parallel_for_exceptions() {
+    bool caught = false;
+
+    try {
+        parallel_for(0, 100, [&](const size_t begin, const size_t) {
+            if (begin == 0) {
+                throw std::runtime_error("first chunk");
+            }
+        }, 4);
+    } catch (const std::runtime_error&) {
+        caught = true;
+    }
+
+    assert(caught, "parallel_for swallowed an exception from a worker");
+}
+
+int main() {
+    test_parallel_for_covers_range();
+    test_parallel_for_chunks();
+    test_parallel_for_exceptions();
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace dav {
+    /**
+      * Number of threads to use when the caller doesn't say: one per hardware
+      * thread, or 1 if the standard library can't tell.
+      */
+    inline size_t default_thread_count() noexcept {
+        return std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+
+    /**
+      * Split [begin, end) into at most n_threads contiguous chunks of nearly
+      * equal size and call f(chunk_begin, chunk_end) for each one on its own
+      * thread. The calling thread does the last chunk itself. n_threads = 0
+      * means default_thread_count().
+      *
+      * The chunks never overlap, so f can write to anything indexed by the
+      * range without locking. If any call throws, the first exception is
+      * rethrown here once every thread has finished.
+      */
+    template <class F>
+    inline void parallel_for(const size_t begin, const size_t end, F&& f, size_t n_threads = 0) {
+        if (end <= begin) {
+            return;
+        }
+
+        const size_t count = end - begin;
+
+        if (n_threads == 0) {
+            n_threads = default_thread_count();
+        }
+        n_threads = std::min(n_threads, count);
+
+        if (n_threads == 1) {
+            f(begin, end);
+            return;
+        }
+
+        std::vector<std::exception_ptr> errors(n_threads);
+        std::vector<std::thread> threads;
+        threads.reserve(n_threads - 1);
+
+        // The first count % n_threads chunks get one extra element.
+        const size_t chunk = count / n_threads;
+        const size_t remainder = count % n_threads;
+
+        const auto chunk_begin = [&](const size_t t) {
+            return begin + t * chunk + std::min(t, remainder);
+        };
+
+        const auto run = [&](const size_t t) {
+            try {
+                f(chunk_begin(t), chunk_begin(t + 1));
+            } catch (...) {
+                errors[t] = std::current_exception();
+            }
+        };
+
+        for (size_t t = 0; t + 1 < n_threads; ++t) {
+            threads.emplace_back(run, t);
+        }
+
+        run(n_threads - 1);
+
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+
+        for (const std::exception_ptr& error : errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+    }
+}